@@ -36,6 +36,7 @@
 #define _FILTER_TDF2_H_
 
 #include "arm_math.h"
+#include "utility_denormal.h"
 
 template <int N>
 class AudioFilterTDF2
@@ -64,9 +65,9 @@ public:
 		b[0] = 1;
 	}
 
-	void process(float32_t *src, float32_t *dst, uint32_t blockSize)
+	void process(const float32_t *src, float32_t *dst, uint32_t blockSize)
 	{
-		for (uint16_t i = 0; i<blockSize; i++)
+		for (uint32_t i = 0; i<blockSize; i++)
 		{
 			float32_t in = *src++;
 			float32_t y = h[0] + b[0] * in;
@@ -77,6 +78,75 @@ public:
 			h[N - 1] = b[N] * in - a[N] * y;
 			*dst++ = y;
 		}
+		denormal_snap(h, N + 1);	// decayed states, see utility_denormal.h
+	}
+};
+
+/**
+ * @brief N-th order TDF2 filter bank, LANES independent filters stored
+ * 		in structure of arrays layout: coefficient/state index first, lane second.
+ * 		All lanes are processed in one pass per sample, the inner lane loops
+ * 		have no dependencies between iterations and map directly to SIMD
+ * 		units or fill the FPU pipeline on cores without vector units.
+ */
+template <int N, int LANES>
+class AudioFilterTDF2Multi
+{
+public:
+	float32_t a[N + 1][LANES];
+	float32_t b[N + 1][LANES];
+	float32_t h[N + 1][LANES];
+
+	void reset()
+	{
+		for (int i = 0; i <= N; ++i)
+			for (int l = 0; l < LANES; l++)
+				h[i][l] = 0; // zero state
+	}
+
+	void reset(int lane)
+	{
+		for (int i = 0; i <= N; ++i)
+			h[i][lane] = 0;
+	}
+
+	void init()
+	{
+		reset();
+		clear();
+	}
+
+	void clear()
+	{
+		for (int i = 0; i <= N; i++)
+			for (int l = 0; l < LANES; l++)
+				a[i][l] = b[i][l] = 0;
+		for (int l = 0; l < LANES; l++)
+			b[0][l] = 1;
+	}
+
+	void process(const float32_t *const *src, float32_t *const *dst, uint32_t blockSize)
+	{
+		float32_t in[LANES], y[LANES];
+		for (uint32_t i = 0; i < blockSize; i++)
+		{
+			for (int l = 0; l < LANES; l++)
+			{
+				in[l] = src[l][i];
+				y[l] = h[0][l] + b[0][l] * in[l];
+			}
+			for (uint16_t j = 1; j < N; ++j)
+			{
+				for (int l = 0; l < LANES; l++)
+					h[j - 1][l] = h[j][l] + b[j][l] * in[l] - a[j][l] * y[l];
+			}
+			for (int l = 0; l < LANES; l++)
+			{
+				h[N - 1][l] = b[N][l] * in[l] - a[N][l] * y[l];
+				dst[l][i] = y[l];
+			}
+		}
+		denormal_snap(&h[0][0], (N + 1) * LANES);	// decayed states, see utility_denormal.h
 	}
 };
 
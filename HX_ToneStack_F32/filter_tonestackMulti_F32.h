@@ -0,0 +1,339 @@
+/*
+	ToneStackMulti.h
+	
+	Copyright 2006-7
+		David Yeh <dtyeh@ccrma.stanford.edu> 
+	2006-14
+		Tim Goetze <tim@quitte.de> (cosmetics)
+	
+	Multi voice (hexaphonic) Tone Stack emulation for Teensy 4.x
+	Each lane is an independent mono tone stack with its own model and
+	control settings, all lanes are processed in a single pass.
+	
+	Ported for 32bit float version for OpenAudio_ArduinoLibrary:
+	https://github.com/chipaudette/OpenAudio_ArduinoLibrary
+
+	12.2023 Piotr Zapart www.hexefx.com
+*/
+/*
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 3
+	of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+	02111-1307, USA or point your web browser to http://www.gnu.org.
+*/
+
+#ifndef _FILTER_TONESTACK_MULTI_F32_H_
+#define _FILTER_TONESTACK_MULTI_F32_H_
+
+#include <Arduino.h>
+#include "AudioStream_F32.h"
+#include "filter_tdf2.h"
+#include "filter_tonestackStereo_F32.h"
+#include "arm_math.h"
+#include "utility_params.h"
+#include "utility_profile.h"
+
+/**
+ * @brief N lane tone stack, ie. AudioFilterToneStackMulti_F32<6> for a hexaphonic pickup
+ * 		Input n is processed and sent to output n.
+ * 
+ * @tparam LANES number of mono lanes
+ */
+template <int LANES>
+class AudioFilterToneStackMulti_F32 : public AudioStream_F32
+{
+public:
+	AudioFilterToneStackMulti_F32() : AudioStream_F32(LANES, inputQueueArray_f32)
+	{
+		params_t &p = params.edit();
+		filter.init();
+		for (int l = 0; l < LANES; l++)
+		{
+			currentModel[l] = TONESTACK_OFF;
+			bass[l] = mid[l] = treble[l] = 0.5f;
+			gain[l] = 1.0f;
+			p.b[0][l] = 1.0f;		// same as filter.init()
+			resetSeq[l] = 0;
+		}
+		p.allOff = true;
+		params.publish();
+		params.fetch(prm);
+		memset(zeroBuf, 0, sizeof(zeroBuf));
+#if defined(AUDIO_PROFILE)
+		static const char *const profNames[] = {"coef", "filter"};
+		AUDIO_PROFILE_INIT(profile, profNames, PROF_NUM);
+#endif
+	}
+	~AudioFilterToneStackMulti_F32(){};
+	virtual void update(void);
+	/**
+	 * @brief Processing core called by update(), can be used without the
+	 * 		audio library for any block length
+	 * 
+	 * @param in 	LANES inputs, NULL = silence
+	 * @param out 	LANES outputs, NULL = not used, can be the same buffers as in
+	 * @param n 	number of samples
+	 */
+	void process(const float32_t *const *in, float32_t *const *out, uint32_t n);
+	enum {PROC_IN = LANES, PROC_OUT = LANES};	// audio channels of process(), a chain stage needs LANES <= 2
+
+	/**
+	 * @brief Sample accurate automation: the next setter call takes effect
+	 * 		at sample t of time(), see utility_params.h
+	 */
+	bool at(uint32_t t) { return params.at(t);}
+	uint32_t time(void) { return params.time();}
+	void advance(uint32_t n) { params.advance(n);}	// clock of a bypassed chain stage
+
+	enum {PROF_COEF, PROF_FILTER, PROF_NUM};	// update() stages
+#if defined(AUDIO_PROFILE)
+	AudioProfile profile;		// cycles per update() stage, see utility_profile.h
+#endif
+
+	/**
+	 * @brief Set the EQ model for one lane, TONESTACK_OFF passes the signal unchanged
+	 * 
+	 * @param lane lane number 0 to LANES-1
+	 * @param m model defined in toneStack_presets_e
+	 */
+	void setModel(uint8_t lane, toneStack_presets_e m)
+	{
+		if (lane >= LANES || m >= TONE_STACK_MAX_MODELS) return;
+		loadModel(lane, m);
+		publishLanes();
+	}
+	/**
+	 * @brief Set the same EQ model for all lanes, published as one change
+	 */
+	void setModel(toneStack_presets_e m)
+	{
+		if (m >= TONE_STACK_MAX_MODELS) return;
+		for (int l = 0; l < LANES; l++) loadModel(l, m);
+		publishLanes();
+	}
+
+	/**
+	 * @brief return the name of the model used in the lane
+	 */
+	const char *getName(uint8_t lane)
+	{
+		if (lane >= LANES || currentModel[lane] == TONESTACK_OFF) return "Off";
+		return AudioFilterToneStackStereo_F32::presets[currentModel[lane] - 1].name;
+	}
+	/**
+	 * @brief set all 3 parameters for one lane
+	 * 
+	 * @param lane lane number 0 to LANES-1
+	 * @param b bass setting
+	 * @param m middle setting
+	 * @param t treble setting
+	 */
+	void setTone(uint8_t lane, float32_t b, float32_t m, float32_t t)
+	{
+		if (lane >= LANES) return;
+		loadTone(lane, b, m, t);
+		publishLanes();
+	}
+	/**
+	 * @brief set all 3 parameters for all lanes, published as one change
+	 */
+	void setTone(float32_t b, float32_t m, float32_t t)
+	{
+		for (int l = 0; l < LANES; l++) loadTone(l, b, m, t);
+		publishLanes();
+	}
+	void setBass(uint8_t lane, float32_t b) { if (lane < LANES) setTone(lane, b, mid[lane], treble[lane]);}
+	void setMid(uint8_t lane, float32_t m) { if (lane < LANES) setTone(lane, bass[lane], m, treble[lane]);}
+	void setTreble(uint8_t lane, float32_t t) { if (lane < LANES) setTone(lane, bass[lane], mid[lane], t);}
+	/**
+	 * @brief lane output volume, folded into the filter coefficients
+	 * 
+	 * @param lane lane number 0 to LANES-1
+	 * @param g gain value
+	 */
+	void setGain(uint8_t lane, float32_t g)
+	{
+		if (lane >= LANES) return;
+		gain[lane] = g;
+		calcLane(lane);
+		publishLanes();
+	}
+
+private:
+	static const uint8_t order = 3;
+	const float32_t c = 2.0f * AUDIO_SAMPLE_RATE;
+	AudioFilterTDF2Multi<order, LANES> filter;
+	audio_block_f32_t *inputQueueArray_f32[LANES];
+	AudioFilterToneStackStereo_F32::toneStackCoefs_t k[LANES];
+	uint8_t currentModel[LANES];
+	float32_t bass[LANES], mid[LANES], treble[LANES], gain[LANES];
+	typedef struct
+	{
+		float32_t a[order + 1][LANES];		// coefficients loaded into the filter by update()
+		float32_t b[order + 1][LANES];
+		uint32_t resetSeq[LANES];			// incremented by setModel(), clears the lane state
+		bool allOff;
+	} params_t;
+	AudioParams<params_t> params;			// written by the setters
+	params_t prm;							// in use by update(), see utility_params.h
+	uint32_t resetSeq[LANES];				// last resetSeq applied to the filter
+	float32_t zeroBuf[AUDIO_BLOCK_SAMPLES];		// input for not connected lanes
+	float32_t dumpBuf[AUDIO_BLOCK_SAMPLES];		// output for not connected lanes
+
+	void loadModel(uint8_t lane, toneStack_presets_e m)
+	{
+		currentModel[lane] = m;
+		if (m != TONESTACK_OFF)
+			k[lane] = AudioFilterToneStackStereo_F32::presetCoefs(m - 1);
+		params.edit().resetSeq[lane]++;
+		calcLane(lane);
+	}
+	void loadTone(uint8_t lane, float32_t b, float32_t m, float32_t t)
+	{
+		bass[lane] = constrain(b, 0.0f, 1.0f);
+		mid[lane] = constrain(m, 0.0f, 1.0f);
+		treble[lane] = constrain(t, 0.0f, 1.0f);
+		calcLane(lane);
+	}
+	// coefficients of one lane into the edited set, the setters publish all changed lanes at once
+	void calcLane(uint8_t lane)
+	{
+		float32_t acoef[6];
+		float32_t dcoef_a[order + 1];
+		float32_t dcoef_b[order + 1];
+		float32_t m;
+
+		if (currentModel[lane] == TONESTACK_OFF)
+		{
+			for (int i = 0; i <= order; i++) dcoef_a[i] = dcoef_b[i] = 0.0f;
+			dcoef_a[0] = dcoef_b[0] = 1.0f;
+		}
+		else
+		{
+			m = pow10f((mid[lane] - 1.0f) * 3.5f);
+			AudioFilterToneStackStereo_F32::analogCoefs(k[lane], bass[lane], m, treble[lane], acoef);
+			AudioFilterToneStackStereo_F32::bilinear(acoef, 1.0f, c, dcoef_a, dcoef_b);
+			for (int i = 0; i <= order; i++)
+				dcoef_b[i] *= gain[lane];
+		}
+		params_t &p = params.edit();
+		for (int i = 1; i <= order; ++i)
+			p.a[i][lane] = dcoef_a[i] / dcoef_a[0];
+		for (int i = 0; i <= order; ++i)
+			p.b[i][lane] = dcoef_b[i] / dcoef_a[0];
+	}
+	void publishLanes()
+	{
+		bool off = true;
+		for (int l = 0; l < LANES; l++)
+			if (currentModel[l] != TONESTACK_OFF) off = false;
+		params.edit().allOff = off;
+		params.publish();
+	}
+	// audio side: loads the coefficients for the next samples into the filter,
+	// returns the samples up to the next scheduled change
+	uint32_t applyParams(uint32_t n)
+	{
+		bool fresh;
+		n = params.fetch(prm, n, &fresh);
+		if (!fresh) return n;
+		memcpy(filter.a, prm.a, sizeof(filter.a));
+		memcpy(filter.b, prm.b, sizeof(filter.b));
+		for (int l = 0; l < LANES; l++)
+		{
+			if (prm.resetSeq[l] == resetSeq[l]) continue;
+			filter.reset(l);
+			resetSeq[l] = prm.resetSeq[l];
+		}
+		return n;
+	}
+};
+
+template <int LANES>
+void AudioFilterToneStackMulti_F32<LANES>::update(void)
+{
+#if defined(__ARM_ARCH_7EM__) || defined(HX_HOST_BUILD)
+	audio_block_f32_t *block[LANES];
+	const float32_t *src[LANES];
+	float32_t *dst[LANES];
+	uint32_t n = 0;
+
+	for (int l = 0; l < LANES; l++)
+	{
+		block[l] = AudioStream_F32::receiveWritable_f32(l);
+		src[l] = dst[l] = block[l] ? block[l]->data : NULL;
+		if (block[l] && (!n || (uint32_t)block[l]->length < n)) n = block[l]->length;
+	}
+	if (!n) return;
+	process(src, dst, n);
+	for (int l = 0; l < LANES; l++)
+	{
+		if (!block[l]) continue;
+		AudioStream_F32::transmit(block[l], l);
+		AudioStream_F32::release(block[l]);
+	}
+#endif
+}
+
+template <int LANES>
+void AudioFilterToneStackMulti_F32<LANES>::process(const float32_t *const *in, float32_t *const *out, uint32_t n)
+{
+#if defined(__ARM_ARCH_7EM__) || defined(HX_HOST_BUILD)
+	const float32_t *src[LANES];
+	float32_t *dst[LANES];
+	uint32_t pos, len, seg, end;
+
+	seg = applyParams(n);		// samples up to the next scheduled change
+	if (prm.allOff && seg == n)
+	{
+		for (int l = 0; l < LANES; l++)
+		{
+			if (!out[l] || out[l] == in[l]) continue;
+			if (in[l]) memcpy(out[l], in[l], n * sizeof(float32_t));
+			else memset(out[l], 0, n * sizeof(float32_t));
+		}
+		return;
+	}
+	AUDIO_PROFILE_START(profile);
+	for (pos = 0; pos < n; pos = end)
+	{
+		if (pos) seg = applyParams(n - pos);
+		end = pos + seg;
+		AUDIO_PROFILE_LAP(profile, PROF_COEF);
+		if (prm.allOff)
+		{
+			for (int l = 0; l < LANES; l++)
+			{
+				if (!out[l] || out[l] == in[l]) continue;
+				if (in[l]) memcpy(out[l] + pos, in[l] + pos, seg * sizeof(float32_t));
+				else memset(out[l] + pos, 0, seg * sizeof(float32_t));
+			}
+			continue;
+		}
+		for (; pos < end; pos += len)		// zeroBuf and dumpBuf are one block long
+		{
+			len = min(end - pos, (uint32_t)AUDIO_BLOCK_SAMPLES);
+			for (int l = 0; l < LANES; l++)
+			{
+				src[l] = in[l] ? in[l] + pos : zeroBuf;
+				dst[l] = out[l] ? out[l] + pos : dumpBuf;
+			}
+			filter.process(src, dst, len);
+		}
+		AUDIO_PROFILE_LAP(profile, PROF_FILTER);
+	}
+	AUDIO_PROFILE_COMMIT(profile);
+#endif
+}
+
+#endif // _FILTER_TONESTACK_MULTI_F32_H_
@@ -31,10 +31,15 @@
 */
 #include "filter_tonestackStereo_F32.h"
 
+#if defined(AUDIO_PROFILE)
+static const char *const profNames[] = {"coef", "filter", "gain"};
+#endif
+
 /**
- * @brief EQ models based on various guitar amplifiers
+ * @brief Component values of the EQ models based on various guitar amplifiers,
+ * 		all of them the treble-mid-bass network solved by solveTMB()
  */
-AudioFilterToneStackStereo_F32::toneStackParams_t AudioFilterToneStackStereo_F32::presets[] = {
+constexpr AudioFilterToneStackStereo_F32::toneStackParams_t AudioFilterToneStackStereo_F32::presets[] = {
 /* for convenience, */
 #define k *1e3
 #define M *1e6
@@ -61,98 +66,343 @@ AudioFilterToneStackStereo_F32::toneStackParams_t AudioFilterToneStackStereo_F32
 #undef pF
 };
 
-AudioFilterToneStackStereo_F32 :: AudioFilterToneStackStereo_F32() : AudioStream_F32(2, inputQueueArray_f32)
+#define TONE_STACK_PRESETS	(sizeof(AudioFilterToneStackStereo_F32::presets) / sizeof(AudioFilterToneStackStereo_F32::presets[0]))
+
+/**
+ * @brief Model terms of the presets solved by the compiler,
+ * 		solveTMBPresets() runs the closed form solveTMB() over presets[]
+ */
+typedef struct
+{
+	AudioFilterToneStackStereo_F32::toneStackCoefs_t k[TONE_STACK_PRESETS];
+} toneStackTable_t;
+
+static constexpr toneStackTable_t solveTMBPresets()
+{
+	toneStackTable_t t = {};
+	for (uint32_t i = 0; i < TONE_STACK_PRESETS; i++)
+		t.k[i] = AudioFilterToneStackStereo_F32::solveTMB(AudioFilterToneStackStereo_F32::presets[i]);
+	return t;
+}
+static constexpr toneStackTable_t modelTable = solveTMBPresets();
+static_assert(TONE_STACK_PRESETS == TONE_STACK_MAX_MODELS - 1, "presets do not match the toneStack_presets_e models");
+
+const AudioFilterToneStackStereo_F32::toneStackCoefs_t &AudioFilterToneStackStereo_F32::presetCoefs(uint8_t idx)
+{
+	if (idx >= TONE_STACK_PRESETS) idx = 0;
+	return modelTable.k[idx];
+}
+
+/**
+ * @brief mid control taper 10^((m-1)*3.5) sampled in 64 steps,
+ * 			used for the audio rate modulation of the mid control
+ */
+#define TONE_STACK_MID_LUT_STEPS	(64)
+static const float32_t midTaperLUT[TONE_STACK_MID_LUT_STEPS + 1] = 
+{
+	3.162277660e-04f, 3.586637624e-04f, 4.067944321e-04f, 4.613839683e-04f, 5.232991147e-04f,
+	5.935229272e-04f, 6.731703824e-04f, 7.635060803e-04f, 8.659643234e-04f, 9.821718892e-04f,
+	1.113973860e-03f, 1.263462918e-03f, 1.433012570e-03f, 1.625314837e-03f, 1.843422992e-03f,
+	2.090800041e-03f, 2.371373706e-03f, 2.689598786e-03f, 3.050527890e-03f, 3.459891661e-03f,
+	3.924189758e-03f, 4.450794062e-03f, 5.048065717e-03f, 5.725487884e-03f, 6.493816316e-03f,
+	7.365250123e-03f, 8.353625470e-03f, 9.474635257e-03f, 1.074607828e-02f, 1.218814185e-02f,
+	1.382372227e-02f, 1.567878844e-02f, 1.778279410e-02f, 2.016914555e-02f, 2.287573200e-02f,
+	2.594552721e-02f, 2.942727176e-02f, 3.337624694e-02f, 3.785515249e-02f, 4.293510210e-02f,
+	4.869675252e-02f, 5.523158417e-02f, 6.264335367e-02f, 7.104974114e-02f, 8.058421878e-02f,
+	9.139816995e-02f, 1.036632928e-01f, 1.175743266e-01f, 1.333521432e-01f, 1.512472545e-01f,
+	1.715437896e-01f, 1.945640062e-01f, 2.206734069e-01f, 2.502865431e-01f, 2.838735965e-01f,
+	3.219678444e-01f, 3.651741273e-01f, 4.141784514e-01f, 4.697588817e-01f, 5.327978946e-01f,
+	6.042963902e-01f, 6.853895839e-01f, 7.773650302e-01f, 8.816830668e-01f, 1.000000000e+00f
+};
+
+AudioFilterToneStackStereo_F32 :: AudioFilterToneStackStereo_F32() : AudioStream_F32(3, inputQueueArray_f32)
 {
-	gain = 1.0f;
+	params_t &p = params.edit();
+	p.gain = 1.0f;
+	p.bass = p.mid = p.treble = 0.5f;
+	p.modTarget = TONESTACK_MOD_OFF;
+	p.modDepth = 0.0f;
 	setModel(TONESTACK_OFF);
+	params.fetch(prm);
+	loadParams();
+	AUDIO_PROFILE_INIT(profile, profNames, PROF_NUM);
 }
 
 void AudioFilterToneStackStereo_F32::setModel(toneStack_presets_e m)
 {
 	if (m >= TONE_STACK_MAX_MODELS) return;
+	params_t &p = params.edit();
+	p.resetSeq++;
 	if (m == TONESTACK_OFF)
 	{
-		bp = true;
-		filterL.reset();
-		filterR.reset();
+		p.bp = true;
+		params.publish();
 		return;
 	}
-	bp = false;
+	p.bp = false;
 	currentModel = m - 1; 
 
-	float32_t 	R1 = presets[currentModel].R1, \
-				R2 = presets[currentModel].R2, \
-				R3 = presets[currentModel].R3, \
-				R4 = presets[currentModel].R4;
-	float32_t 	C1 = presets[currentModel].C1, \
-				C2 = presets[currentModel].C2, \
-				C3 = presets[currentModel].C3;
-
-	b1t = C1 * R1;
-	b1m = C3 * R3;
-	b1l = C1 * R2 + C2 * R2;
-	b1d = C1 * R3 + C2 * R3;
-	b2t = C1 * C2 * R1 * R4 + C1 * C3 * R1 * R4;
-	b2m2 = -(C1 * C3 * R3 * R3 + C2 * C3 * R3 * R3);
-	b2m = C1 * C3 * R1 * R3 + C1 * C3 * R3 * R3 + C2 * C3 * R3 * R3;
-	b2l = C1 * C2 * R1 * R2 + C1 * C2 * R2 * R4 + C1 * C3 * R2 * R4;
-	b2lm = C1 * C3 * R2 * R3 + C2 * C3 * R2 * R3;
-	b2d = C1 * C2 * R1 * R3 + C1 * C2 * R3 * R4 + C1 * C3 * R3 * R4;
-	b3lm = C1 * C2 * C3 * R1 * R2 * R3 + C1 * C2 * C3 * R2 * R3 * R4;
-	b3m2 = -(C1 * C2 * C3 * R1 * R3 * R3 + C1 * C2 * C3 * R3 * R3 * R4);
-	b3m = C1 * C2 * C3 * R1 * R3 * R3 + C1 * C2 * C3 * R3 * R3 * R4;
-	b3t = C1 * C2 * C3 * R1 * R3 * R4;
-	b3tm = -b3t;
-	b3tl = C1 * C2 * C3 * R1 * R2 * R4;
-	a0 = 1.0f;
-	a1d = C1 * R1 + C1 * R3 + C2 * R3 + C2 * R4 + C3 * R4;
-	a1m = C3 * R3;
-	a1l = C1 * R2 + C2 * R2;
-	a2m = C1 * C3 * R1 * R3 - C2 * C3 * R3 * R4 + C1 * C3 * R3 * R3 + C2 * C3 * R3 * R3;
-	a2lm = C1 * C3 * R2 * R3 + C2 * C3 * R2 * R3;
-	a2m2 = -(C1 * C3 * R3 * R3 + C2 * C3 * R3 * R3);
-	a2l = C1 * C2 * R2 * R4 + C1 * C2 * R1 * R2 + C1 * C3 * R2 * R4 + C2 * C3 * R2 * R4;
-	a2d = C1 * C2 * R1 * R4 + C1 * C3 * R1 * R4 + C1 * C2 * R3 * R4 + C1 * C2 * R1 * R3 + C1 * C3 * R3 * R4 + C2 * C3 * R3 * R4;
-	a3lm = C1 * C2 * C3 * R1 * R2 * R3 + C1 * C2 * C3 * R2 * R3 * R4;
-	a3m2 = -(C1 * C2 * C3 * R1 * R3 * R3 + C1 * C2 * C3 * R3 * R3 * R4);
-	a3m = C1 * C2 * C3 * R3 * R3 * R4 + C1 * C2 * C3 * R1 * R3 * R3 - C1 * C2 * C3 * R1 * R3 * R4;
-	a3l = C1 * C2 * C3 * R1 * R2 * R4;
-	a3d = C1 * C2 * C3 * R1 * R3 * R4;
-
-	filterL.reset();
-	filterR.reset();
+	k = presetCoefs(currentModel);
+
+	setTone(p.bass, p.mid, p.treble);		// refresh the coefficients for the new model
+}
+
+void AudioFilterToneStackStereo_F32::analogCoefs(const toneStackCoefs_t &k, float32_t b, float32_t m, float32_t t, float32_t *an)
+{
+	an[0] = k.a1d + m * k.a1m + b * k.a1l;
+	an[1] = m * k.a2m + b * m * k.a2lm + m * m * k.a2m2 + b * k.a2l + k.a2d;
+	an[2] = b * m * k.a3lm + m * m * k.a3m2 + m * k.a3m + b * k.a3l + k.a3d;
+	an[3] = t * k.b1t + m * k.b1m + b * k.b1l + k.b1d;
+	an[4] = t * k.b2t + m * m * k.b2m2 + m * k.b2m + b * k.b2l + b * m * k.b2lm + k.b2d;
+	an[5] = b * m * k.b3lm + m * m * k.b3m2 + m * k.b3m + t * k.b3t + t * m * k.b3tm + t * b * k.b3tl;
+}
+
+void AudioFilterToneStackStereo_F32::bilinear(const float32_t *an, float32_t a0, float32_t c, float32_t *da, float32_t *db)
+{
+	const float32_t c2 = c * c;
+	const float32_t c3 = c2 * c;
+	da[0] = -a0 - an[0] * c - an[1] * c2 - an[2] * c3; // sets scale
+	da[1] = -3.0f * a0 - an[0] * c + an[1] * c2 + 3.0f * an[2] * c3;
+	da[2] = -3.0f * a0 + an[0] * c + an[1] * c2 - 3.0f * an[2] * c3;
+	da[3] = -a0 + an[0] * c - an[1] * c2 + an[2] * c3;
+	db[0] = -an[3] * c - an[4] * c2 - an[5] * c3;
+	db[1] = -an[3] * c + an[4] * c2 + 3.0f * an[5] * c3;
+	db[2] = an[3] * c + an[4] * c2 - 3.0f * an[5] * c3;
+	db[3] = an[3] * c - an[4] * c2 + an[5] * c3;
+}
+
+/**
+ * @brief Split the analog coefficients into polynomials of the modulated control
+ * 		with the other two controls fixed. Bilinear transform is linear, so the
+ * 		digital coefficients are polynomials of the same order:
+ * 		bass and treble - 1st order, mid (after the taper) - 2nd order.
+ */
+void AudioFilterToneStackStereo_F32::calcModPoly(float32_t pa[3][order + 1], float32_t pb[3][order + 1])
+{
+	const params_t &p = params.get();
+	float32_t b = p.bass, t = p.treble;
+	float32_t m = pow10f((p.mid - 1.0f) * 3.5f);
+	float32_t an[3][6];		// analog a1, a2, a3, b1, b2, b3 split into p^0, p^1, p^2 terms
+	memset(an, 0, sizeof(an));
+
+	switch (p.modTarget)
+	{
+		case TONESTACK_MOD_BASS:
+			an[0][0] = k.a1d + m * k.a1m;		an[1][0] = k.a1l;
+			an[0][1] = m * k.a2m + m * m * k.a2m2 + k.a2d;		an[1][1] = m * k.a2lm + k.a2l;
+			an[0][2] = m * m * k.a3m2 + m * k.a3m + k.a3d;		an[1][2] = m * k.a3lm + k.a3l;
+			an[0][3] = t * k.b1t + m * k.b1m + k.b1d;		an[1][3] = k.b1l;
+			an[0][4] = t * k.b2t + m * m * k.b2m2 + m * k.b2m + k.b2d;		an[1][4] = k.b2l + m * k.b2lm;
+			an[0][5] = m * m * k.b3m2 + m * k.b3m + t * k.b3t + t * m * k.b3tm;		an[1][5] = m * k.b3lm + t * k.b3tl;
+			break;
+		case TONESTACK_MOD_MID:
+			an[0][0] = k.a1d + b * k.a1l;		an[1][0] = k.a1m;
+			an[0][1] = b * k.a2l + k.a2d;		an[1][1] = k.a2m + b * k.a2lm;		an[2][1] = k.a2m2;
+			an[0][2] = b * k.a3l + k.a3d;		an[1][2] = b * k.a3lm + k.a3m;		an[2][2] = k.a3m2;
+			an[0][3] = t * k.b1t + b * k.b1l + k.b1d;		an[1][3] = k.b1m;
+			an[0][4] = t * k.b2t + b * k.b2l + k.b2d;		an[1][4] = k.b2m + b * k.b2lm;		an[2][4] = k.b2m2;
+			an[0][5] = t * k.b3t + t * b * k.b3tl;		an[1][5] = b * k.b3lm + k.b3m + t * k.b3tm;		an[2][5] = k.b3m2;
+			break;
+		case TONESTACK_MOD_TREBLE:
+			an[0][0] = k.a1d + m * k.a1m + b * k.a1l;
+			an[0][1] = m * k.a2m + b * m * k.a2lm + m * m * k.a2m2 + b * k.a2l + k.a2d;
+			an[0][2] = b * m * k.a3lm + m * m * k.a3m2 + m * k.a3m + b * k.a3l + k.a3d;
+			an[0][3] = m * k.b1m + b * k.b1l + k.b1d;		an[1][3] = k.b1t;
+			an[0][4] = m * m * k.b2m2 + m * k.b2m + b * k.b2l + b * m * k.b2lm + k.b2d;		an[1][4] = k.b2t;
+			an[0][5] = b * m * k.b3lm + m * m * k.b3m2 + m * k.b3m;		an[1][5] = k.b3t + m * k.b3tm + b * k.b3tl;
+			break;
+		default:
+			break;
+	}
+	for (int i = 0; i < 3; i++)
+		bilinear(an[i], i ? 0.0f : 1.0f, c, pa[i], pb[i]);
+}
+
+/**
+ * @brief Set the filter coefficients for the current control signal value
+ * 		Cost: 16 multiply-adds for the polynomials + 1 division
+ * 
+ * @param ctrl modulation signal sample
+ */
+void AudioFilterToneStackStereo_F32::applyMod(float32_t ctrl)
+{
+	float32_t p, da[order + 1], db[order + 1];
+	switch (prm.modTarget)
+	{
+		case TONESTACK_MOD_BASS:	p = prm.bass;	break;
+		case TONESTACK_MOD_MID:		p = prm.mid;	break;
+		default:					p = prm.treble;	break;
+	}
+	p = constrain(p + prm.modDepth * ctrl, 0.0f, 1.0f);
+	if (prm.modTarget == TONESTACK_MOD_MID)
+	{
+		p *= (float32_t)TONE_STACK_MID_LUT_STEPS;
+		uint32_t idx = p;
+		if (idx > TONE_STACK_MID_LUT_STEPS - 1) idx = TONE_STACK_MID_LUT_STEPS - 1;
+		float32_t fract = p - (float32_t)idx;
+		p = midTaperLUT[idx] + fract * (midTaperLUT[idx + 1] - midTaperLUT[idx]);
+	}
+	for (int i = 0; i <= order; i++)
+	{
+		da[i] = (prm.modPoly_a[2][i] * p + prm.modPoly_a[1][i]) * p + prm.modPoly_a[0][i];
+		db[i] = (prm.modPoly_b[2][i] * p + prm.modPoly_b[1][i]) * p + prm.modPoly_b[0][i];
+	}
+	float32_t norm = 1.0f / da[0];
+	for (int i = 1; i <= order; i++)
+	{
+		filterL.a[i] = da[i] * norm;
+		filterR.a[i] = filterL.a[i];
+	}
+	for (int i = 0; i <= order; i++)
+	{
+		filterL.b[i] = db[i] * norm;
+		filterR.b[i] = filterL.b[i];
+	}
+	modApplied = true;
+}
+
+/**
+ * @brief Audio side: picks up the parameter set for the next samples
+ * 
+ * @param n samples left in the block
+ * @return samples up to the next scheduled change, n at most
+ */
+uint32_t AudioFilterToneStackStereo_F32::applyParams(uint32_t n)
+{
+	bool fresh;
+	n = params.fetch(prm, n, &fresh);
+	if (fresh) loadParams();
+	return n;
+}
+
+/**
+ * @brief Loads the static coefficients of prm and clears the filters
+ * 		after a model change
+ */
+void AudioFilterToneStackStereo_F32::loadParams()
+{
+	if (prm.resetSeq != resetSeq)
+	{
+		filterL.reset();
+		filterR.reset();
+		resetSeq = prm.resetSeq;
+	}
+	for (int i = 1; i <= order; i++)
+		filterL.a[i] = filterR.a[i] = prm.static_a[i];
+	for (int i = 0; i <= order; i++)
+		filterL.b[i] = filterR.b[i] = prm.static_b[i];
+	modApplied = false;
 }
 
 void AudioFilterToneStackStereo_F32::update()
 {
-#if defined(__ARM_ARCH_7EM__)
-	audio_block_f32_t *blockL, *blockR; 
+#if defined(__ARM_ARCH_7EM__) || defined(HX_HOST_BUILD)
+	audio_block_f32_t *blockL, *blockR, *blockMod; 
     blockL = AudioStream_F32::receiveWritable_f32(0);       // audio data
     blockR = AudioStream_F32::receiveWritable_f32(1);       // audio data
+	blockMod = AudioStream_F32::receiveReadOnly_f32(2);		// control signal
     if (!blockL || !blockR)
     {
 		if (blockL) release((audio_block_f32_t *)blockL);
-        if (blockR) release((audio_block_f32_t *)blockR);		
+        if (blockR) release((audio_block_f32_t *)blockR);
+		if (blockMod) release(blockMod);
         return;
     }
-	if (bp) // bypass mode
-	{
-        AudioStream_F32::transmit((audio_block_f32_t *)blockL,0);
-        AudioStream_F32::transmit((audio_block_f32_t *)blockR,1);
-        AudioStream_F32::release((audio_block_f32_t *)blockL);
-        AudioStream_F32::release((audio_block_f32_t *)blockR);
-		return;		
-	}
-	filterL.process(blockL->data, blockL->data, blockL->length);
-	filterR.process(blockR->data, blockR->data, blockR->length);
-	if (gain != 1.0f)
-	{
-		arm_scale_f32(blockL->data, gain, blockL->data, blockL->length);
-		arm_scale_f32(blockR->data, gain, blockR->data, blockR->length);
-	}
+	const float32_t *in[3] = {blockL->data, blockR->data, blockMod ? blockMod->data : NULL};
+	float32_t *out[2] = {blockL->data, blockR->data};
+	process(in, out, min(blockL->length, blockR->length));	// bypass mode: the input blocks are sent unchanged
+	if (blockMod) AudioStream_F32::release(blockMod);
     AudioStream_F32::transmit(blockL, 0);
     AudioStream_F32::transmit(blockR, 1);
 	AudioStream_F32::release(blockL);
     AudioStream_F32::release(blockR);	
 #endif
 }
+
+void AudioFilterToneStackStereo_F32::process(const float32_t *const *in, float32_t *const *out, uint32_t n)
+{
+#if defined(__ARM_ARCH_7EM__) || defined(HX_HOST_BUILD)
+	const float32_t *src[3] = {in[0], in[1], in[2]};
+	float32_t *dst[2] = {out[0], out[1]};
+	uint32_t seg;
+
+	seg = applyParams(n);	// samples up to the next scheduled change
+	if (prm.bp && seg == n)
+	{
+		if (out[0] != in[0]) memcpy(out[0], in[0], n * sizeof(float32_t));
+		if (out[1] != in[1]) memcpy(out[1], in[1], n * sizeof(float32_t));
+		return;
+	}
+	AUDIO_PROFILE_START(profile);
+	while (n)
+	{
+		if (prm.bp)
+		{
+			if (dst[0] != src[0]) memcpy(dst[0], src[0], seg * sizeof(float32_t));
+			if (dst[1] != src[1]) memcpy(dst[1], src[1], seg * sizeof(float32_t));
+		}
+		else processSegment(src, dst, seg);
+		src[0] += seg;
+		src[1] += seg;
+		if (src[2]) src[2] += seg;
+		dst[0] += seg;
+		dst[1] += seg;
+		n -= seg;
+		if (n) seg = applyParams(n);
+	}
+	AUDIO_PROFILE_COMMIT(profile);
+#endif
+}
+
+// one parameter set for all n samples
+void AudioFilterToneStackStereo_F32::processSegment(const float32_t *const *in, float32_t *const *out, uint32_t n)
+{
+	if (in[2] && prm.modTarget != TONESTACK_MOD_OFF)
+	{
+		for (uint32_t i = 0; i < n; i += TONE_STACK_MOD_SUBBLOCK)
+		{
+			uint32_t len = min((uint32_t)TONE_STACK_MOD_SUBBLOCK, n - i);
+			applyMod(in[2][i]);
+			AUDIO_PROFILE_LAP(profile, PROF_COEF);
+			filterL.process(in[0] + i, out[0] + i, len);
+			filterR.process(in[1] + i, out[1] + i, len);
+			AUDIO_PROFILE_LAP(profile, PROF_FILTER);
+		}
+	}
+	else
+	{
+		if (modApplied) // modulation stopped, restore the static coefficients
+		{
+			for (int i = 1; i <= order; i++)
+				filterL.a[i] = filterR.a[i] = prm.static_a[i];
+			for (int i = 0; i <= order; i++)
+				filterL.b[i] = filterR.b[i] = prm.static_b[i];
+			modApplied = false;
+		}
+		AUDIO_PROFILE_LAP(profile, PROF_COEF);
+		filterL.process(in[0], out[0], n);
+		filterR.process(in[1], out[1], n);
+		AUDIO_PROFILE_LAP(profile, PROF_FILTER);
+	}
+	for (uint32_t i = 0, len; i < n; i += len)
+	{
+		len = gainRamp.span(prm.gain, n - i);	// parameter ramp, see utility_ramp.h
+		if (gainRamp.begin(prm.gain, len))
+		{
+			float32_t g = gainRamp.value;
+			for (uint32_t j = i; j < i + len; j++)
+			{
+				out[0][j] *= g;
+				out[1][j] *= g;
+				g += gainRamp.step;
+			}
+		}
+		else if (prm.gain != 1.0f)
+		{
+			arm_scale_f32(out[0] + i, prm.gain, out[0] + i, len);
+			arm_scale_f32(out[1] + i, prm.gain, out[1] + i, len);
+		}
+		gainRamp.end();
+	}
+	AUDIO_PROFILE_LAP(profile, PROF_GAIN);
+}
@@ -38,8 +38,12 @@
 #include "AudioStream_F32.h"
 #include "filter_tdf2.h"
 #include "arm_math.h"
+#include "utility_profile.h"
+#include "utility_params.h"
+#include "utility_ramp.h"
 
 #define TONE_STACK_MAX_MODELS (10)
+#define TONE_STACK_MOD_SUBBLOCK (8)		// coefficient update rate for the modulation input
 
 typedef enum
 {
@@ -55,12 +59,30 @@ typedef enum
 	TONESTACK_PIGNOSE
 }toneStack_presets_e;
 
+typedef enum
+{
+	TONESTACK_MOD_OFF,
+	TONESTACK_MOD_BASS,
+	TONESTACK_MOD_MID,
+	TONESTACK_MOD_TREBLE
+}toneStack_mod_e;
+
 class AudioFilterToneStackStereo_F32 : public AudioStream_F32
 {
 public:
 	AudioFilterToneStackStereo_F32();
 	~AudioFilterToneStackStereo_F32(){};
 	virtual void update(void);
+	/**
+	 * @brief Processing core called by update(), can be used without the
+	 * 		audio library for any block length
+	 * 
+	 * @param in 	in[0], in[1] audio L/R, in[2] modulation (NULL = not used)
+	 * @param out 	out[0], out[1] audio L/R, can be the same buffers as in[0], in[1]
+	 * @param n 	number of samples
+	 */
+	void process(const float32_t *const *in, float32_t *const *out, uint32_t n);
+	enum {PROC_IN = 2, PROC_OUT = 2};	// audio channels of process(), see effect_chain_F32.h
 
 	typedef struct
 	{
@@ -69,9 +91,107 @@ public:
 		const char *name;
 	} toneStackParams_t;
 	/**
-	 * @brief preset table
+	 * @brief model dependent terms of the analog transfer function
+	 */
+	typedef struct
+	{
+		float32_t b1t, b1m, b1l, b1d,
+			b2t, b2m2, b2m, b2l, b2lm, b2d,
+			b3lm, b3m2, b3m, b3t, b3tm, b3tl,
+			a0, a1d, a1m, a1l, a2m, a2lm, a2m2, a2l, a2d,
+			a3lm, a3m2, a3m, a3l, a3d;
+	} toneStackCoefs_t;
+	/**
+	 * @brief Solve the Fender/Marshall/Vox treble-mid-bass network for the model terms.
+	 * 		R1 = treble pot, R2 = bass pot, R3 = mid pot, R4 = slope resistor,
+	 * 		C1 = treble cap, C2 = bass cap, C3 = mid cap
+	 * 		Declared constexpr: for component values known at compile time the
+	 * 		compiler evaluates the terms and only the result is stored in flash.
+	 * 		New circuits using the same topology need only a new presets[] entry.
+	 * 		Only this topology is covered: the term layout, analogCoefs() and the
+	 * 		modulation polynomials are specific to it (3rd order, DC blocking
+	 * 		numerator, denominator independent of the treble pot).
+	 * 
+	 * @param p component values
+	 * @return model terms
+	 */
+	static constexpr toneStackCoefs_t solveTMB(const toneStackParams_t &p)
+	{
+		const float32_t R1 = p.R1, R2 = p.R2, R3 = p.R3, R4 = p.R4;
+		const float32_t C1 = p.C1, C2 = p.C2, C3 = p.C3;
+		toneStackCoefs_t k = {};
+
+		k.b1t = C1 * R1;
+		k.b1m = C3 * R3;
+		k.b1l = C1 * R2 + C2 * R2;
+		k.b1d = C1 * R3 + C2 * R3;
+		k.b2t = C1 * C2 * R1 * R4 + C1 * C3 * R1 * R4;
+		k.b2m2 = -(C1 * C3 * R3 * R3 + C2 * C3 * R3 * R3);
+		k.b2m = C1 * C3 * R1 * R3 + C1 * C3 * R3 * R3 + C2 * C3 * R3 * R3;
+		k.b2l = C1 * C2 * R1 * R2 + C1 * C2 * R2 * R4 + C1 * C3 * R2 * R4;
+		k.b2lm = C1 * C3 * R2 * R3 + C2 * C3 * R2 * R3;
+		k.b2d = C1 * C2 * R1 * R3 + C1 * C2 * R3 * R4 + C1 * C3 * R3 * R4;
+		k.b3lm = C1 * C2 * C3 * R1 * R2 * R3 + C1 * C2 * C3 * R2 * R3 * R4;
+		k.b3m2 = -(C1 * C2 * C3 * R1 * R3 * R3 + C1 * C2 * C3 * R3 * R3 * R4);
+		k.b3m = C1 * C2 * C3 * R1 * R3 * R3 + C1 * C2 * C3 * R3 * R3 * R4;
+		k.b3t = C1 * C2 * C3 * R1 * R3 * R4;
+		k.b3tm = -k.b3t;
+		k.b3tl = C1 * C2 * C3 * R1 * R2 * R4;
+		k.a0 = 1.0f;
+		k.a1d = C1 * R1 + C1 * R3 + C2 * R3 + C2 * R4 + C3 * R4;
+		k.a1m = C3 * R3;
+		k.a1l = C1 * R2 + C2 * R2;
+		k.a2m = C1 * C3 * R1 * R3 - C2 * C3 * R3 * R4 + C1 * C3 * R3 * R3 + C2 * C3 * R3 * R3;
+		k.a2lm = C1 * C3 * R2 * R3 + C2 * C3 * R2 * R3;
+		k.a2m2 = -(C1 * C3 * R3 * R3 + C2 * C3 * R3 * R3);
+		k.a2l = C1 * C2 * R2 * R4 + C1 * C2 * R1 * R2 + C1 * C3 * R2 * R4 + C2 * C3 * R2 * R4;
+		k.a2d = C1 * C2 * R1 * R4 + C1 * C3 * R1 * R4 + C1 * C2 * R3 * R4 + C1 * C2 * R1 * R3 + C1 * C3 * R3 * R4 + C2 * C3 * R3 * R4;
+		k.a3lm = C1 * C2 * C3 * R1 * R2 * R3 + C1 * C2 * C3 * R2 * R3 * R4;
+		k.a3m2 = -(C1 * C2 * C3 * R1 * R3 * R3 + C1 * C2 * C3 * R3 * R3 * R4);
+		k.a3m = C1 * C2 * C3 * R3 * R3 * R4 + C1 * C2 * C3 * R1 * R3 * R3 - C1 * C2 * C3 * R1 * R3 * R4;
+		k.a3l = C1 * C2 * C3 * R1 * R2 * R4;
+		k.a3d = C1 * C2 * C3 * R1 * R3 * R4;
+		return k;
+	}
+	/**
+	 * @brief calculate the model dependent terms from the component values at runtime
+	 * 
+	 * @param p component values
+	 * @param k output terms
+	 */
+	static void modelCoefs(const toneStackParams_t &p, toneStackCoefs_t &k) { k = solveTMB(p);}
+	/**
+	 * @brief model terms of the built in presets, solved at compile time
+	 * 
+	 * @param idx preset index, 0 = Bassman
+	 * @return model terms
+	 */
+	static const toneStackCoefs_t &presetCoefs(uint8_t idx);
+	/**
+	 * @brief analog transfer function coefficients for the given control settings
+	 * 
+	 * @param k model terms
+	 * @param b bass setting
+	 * @param m mid setting after the log taper
+	 * @param t treble setting
+	 * @param an output: a1, a2, a3, b1, b2, b3
+	 */
+	static void analogCoefs(const toneStackCoefs_t &k, float32_t b, float32_t m, float32_t t, float32_t *an);
+	/**
+	 * @brief bilinear transform of the 3rd order analog prototype
+	 * 
+	 * @param an analog coefficients a1, a2, a3, b1, b2, b3
+	 * @param a0 analog a0 coefficient, 0 is used for the polynomial terms
+	 * @param c bilinear transform constant 2*fs
+	 * @param da digital denominator, not normalized
+	 * @param db digital numerator, not normalized
+	 */
+	static void bilinear(const float32_t *an, float32_t a0, float32_t c, float32_t *da, float32_t *db);
+	/**
+	 * @brief component values of the models, index = toneStack_presets_e - 1,
+	 * 		solved into the flash table of presetCoefs() at compile time
 	 */
-	static toneStackParams_t presets[];
+	static const toneStackParams_t presets[];
 	/**
 	 * @brief Set the EQ type from the available pool of models
 	 * 			Use TONESTACK_OFF to bypass the module
@@ -96,14 +216,11 @@ public:
 	 */
 	void setTone(float32_t b, float32_t m, float32_t t)
 	{
-		b = constrain(b, 0.0f, 1.0f); bass = b;
-		m = constrain(m, 0.0f, 1.0f); mid = m;
-		t = constrain(t, 0.0f, 1.0f); treble = t;
-		struct
-		{
-			float32_t a1, a2, a3;
-			float32_t b1, b2, b3;
-		} acoef; // analog coefficients
+		params_t &p = params.edit();
+		b = constrain(b, 0.0f, 1.0f); p.bass = b;
+		m = constrain(m, 0.0f, 1.0f); p.mid = m;
+		t = constrain(t, 0.0f, 1.0f); p.treble = t;
+		float32_t acoef[6]; // analog coefficients a1, a2, a3, b1, b2, b3
 
 		// digital coefficients
 		float32_t dcoef_a[order + 1];
@@ -111,77 +228,110 @@ public:
 
 		m = (m - 1.0f) * 3.5f;
 		m = pow10f(m);
-		acoef.a1 = a1d + m * a1m + b * a1l;
-		acoef.a2 = m * a2m + b * m * a2lm + m * m * a2m2 + b * a2l + a2d;
-		acoef.a3 = b * m * a3lm + m * m * a3m2 + m * a3m + b * a3l + a3d;
-		dcoef_a[0] = -1.0f - acoef.a1 * c - acoef.a2 * c * c - acoef.a3 * c * c * c; // sets scale
-		dcoef_a[1] = -3.0f - acoef.a1 * c + acoef.a2 * c * c + 3.0f * acoef.a3 * c * c * c;
-		dcoef_a[2] = -3.0f + acoef.a1 * c + acoef.a2 * c * c - 3.0f * acoef.a3 * c * c * c;
-		dcoef_a[3] = -1.0f + acoef.a1 * c - acoef.a2 * c * c + acoef.a3 * c * c * c;
-
-		acoef.b1 = t * b1t + m * b1m + b * b1l + b1d;
-		acoef.b2 = t * b2t + m * m * b2m2 + m * b2m + b * b2l + b * m * b2lm + b2d;
-		acoef.b3 = b * m * b3lm + m * m * b3m2 + m * b3m + t * b3t + t * m * b3tm + t * b * b3tl;
-		dcoef_b[0] = -acoef.b1 * c - acoef.b2 * c * c - acoef.b3 * c * c * c;
-		dcoef_b[1] = -acoef.b1 * c + acoef.b2 * c * c + 3.0f * acoef.b3 * c * c * c;
-		dcoef_b[2] = acoef.b1 * c + acoef.b2 * c * c - 3.0f * acoef.b3 * c * c * c;
-		dcoef_b[3] = acoef.b1 * c - acoef.b2 * c * c + acoef.b3 * c * c * c;
-
-		__disable_irq();
+		analogCoefs(k, b, m, t, acoef);
+		bilinear(acoef, 1.0f, c, dcoef_a, dcoef_b);
+
+		// modulation polynomials
+		calcModPoly(p.modPoly_a, p.modPoly_b);
+
 		for (int i = 1; i <= order; ++i)
-		{
-			filterL.a[i] = dcoef_a[i] / dcoef_a[0];
-			filterR.a[i] = filterL.a[i];
-		}
+			p.static_a[i] = dcoef_a[i] / dcoef_a[0];
 		for (int i = 0; i <= order; ++i)
-		{
-			filterL.b[i] = dcoef_b[i] / dcoef_a[0];
-			filterR.b[i] = filterL.b[i]; 
-		}
-		 __enable_irq();
+			p.static_b[i] = dcoef_b[i] / dcoef_a[0];
+		params.publish();		// update() loads the new coefficients into the filters
 	}
 	/**
 	 * @brief set the bass range EQ
 	 * 
 	 * @param b bass setting
 	 */
-	void setBass(float32_t b) { setTone(b, mid, treble);}
+	void setBass(float32_t b) { setTone(b, params.get().mid, params.get().treble);}
 
 	/**
 	 * @brief set the mid range EQ
 	 * 
 	 * @param m middle setting
 	 */
-	void setMid(float32_t m) { setTone(bass, m, treble);}
+	void setMid(float32_t m) { setTone(params.get().bass, m, params.get().treble);}
 
 	/**
 	 * @brief set the treble range EQ
 	 * 
 	 * @param t treble setting
 	 */
-	void setTreble(float32_t t) {setTone(bass, mid, t);}
+	void setTreble(float32_t t) {setTone(params.get().bass, params.get().mid, t);}
 
 	/**
 	 * @brief Master volume setting
 	 * 
 	 * @param g gain value
 	 */
-	void setGain(float32_t g) {	gain = g;}
+	void setGain(float32_t g) {	params.edit().gain = g; params.publish();}
+
+	/**
+	 * @brief Route the 3rd input (control signal) to one of the EQ controls.
+	 * 		The control value is added to the knob setting: knob + depth * ctrl,
+	 * 		the result is clipped to 0.0 - 1.0 range, which keeps the modelled
+	 * 		passive network, and therefore the filter, stable.
+	 * 		Coefficients are updated every TONE_STACK_MOD_SUBBLOCK samples.
+	 * 
+	 * @param target TONESTACK_MOD_OFF, TONESTACK_MOD_BASS, _MID or _TREBLE
+	 * @param depth modulation depth, range -1.0f to 1.0f
+	 */
+	void setModulation(toneStack_mod_e target, float32_t depth)
+	{
+		params_t &p = params.edit();
+		p.modTarget = target;
+		p.modDepth = constrain(depth, -1.0f, 1.0f);
+		setTone(p.bass, p.mid, p.treble);		// publishes the target with the new polynomials
+	}
+
+	/**
+	 * @brief Sample accurate automation: the next setter call takes effect
+	 * 		at sample t of time(), see utility_params.h
+	 */
+	bool at(uint32_t t) { return params.at(t);}
+	uint32_t time(void) { return params.time();}
+	void advance(uint32_t n) { params.advance(n);}	// clock of a bypassed chain stage
+
+	enum {PROF_COEF, PROF_FILTER, PROF_GAIN, PROF_NUM};	// update() stages
+#if defined(AUDIO_PROFILE)
+	AudioProfile profile;		// cycles per update() stage, see utility_profile.h
+#endif
 
 private:
 	static const uint8_t order = 3;
 	AudioFilterTDF2<order> filterL;
 	AudioFilterTDF2<order> filterR;
-	audio_block_f32_t *inputQueueArray_f32[2];
-	bool bp = false;		// bypass
+	audio_block_f32_t *inputQueueArray_f32[3];
+	typedef struct
+	{
+		bool bp;			// bypass
+		float32_t bass, mid, treble, gain;
+		float32_t static_a[order + 1], static_b[order + 1];	// coeffs set by setTone()
+		// modulation: each unnormalized digital coefficient is a 2nd order polynomial
+		// of the modulated control, coefficients stored as [power][coeff index]
+		toneStack_mod_e modTarget;
+		float32_t modDepth;
+		float32_t modPoly_a[3][order + 1];
+		float32_t modPoly_b[3][order + 1];
+		uint32_t resetSeq;	// incremented by setModel(), update() clears the filter states
+	} params_t;
+	AudioParams<params_t> params;	// written by the setters
+	params_t prm;					// in use by update(), see utility_params.h
+	uint32_t resetSeq = 0;			// last resetSeq applied to the filters
+	AudioRamp gainRamp;				// output gain in use, see utility_ramp.h
 	uint8_t currentModel;
 	float32_t c = 2.0f * AUDIO_SAMPLE_RATE;
-	float32_t b1t, b1m, b1l, b1d,
-		b2t, b2m2, b2m, b2l, b2lm, b2d,
-		b3lm, b3m2, b3m, b3t, b3tm, b3tl,
-		a0, a1d, a1m, a1l, a2m, a2lm, a2m2, a2l, a2d,
-		a3lm, a3m2, a3m, a3l, a3d; // intermediate calculations
-	float32_t bass, mid, treble, gain;
+	toneStackCoefs_t k; // intermediate calculations
+
+	bool modApplied = false;	// filter coeffs hold the modulated values
+	void calcModPoly(float32_t pa[3][order + 1], float32_t pb[3][order + 1]);
+	void applyMod(float32_t ctrl);
+	uint32_t applyParams(uint32_t n);
+	void loadParams();
+	void processSegment(const float32_t *const *in, float32_t *const *out, uint32_t n);
+
 };
 
 #endif // _FILTER_TONESTACK_F32_H_
@@ -0,0 +1,210 @@
+/*  Fused effect chain: several F32 effects processed in one update()
+ *
+ *  Author: Piotr Zapart
+ *          www.hexefx.com
+ *
+ * Copyright (c) 2021 by Piotr Zapart
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <Arduino.h>
+#include "effect_chain_F32.h"
+
+AudioEffectChain_F32::AudioEffectChain_F32() : AudioStream_F32(2, inputQueueArray_f32)
+{
+    params_t &p = params.edit();
+    uint8_t i;
+    stageNum = 0;
+    for (i = 0; i < CHAIN_MAX_STAGES; i++) p.mix[i] = 1.0f;
+    params.publish();           // empty active list, wet only stages
+    params.fetch(prm);
+    allocFailCount = 0;
+}
+
+int AudioEffectChain_F32::add(process_f fn, void *fxL, void *fxR, uint8_t chIn, uint8_t chOut, advance_f adv)
+{
+    if (stageNum >= CHAIN_MAX_STAGES || !fn || !fxL) return -1;
+    chain_stage_t *s = &stages[stageNum];
+    s->fn = fn;
+    s->adv = adv;
+    s->fx[0] = fxL;
+    s->fx[1] = fxR;
+    s->chIn = fxR ? 1 : constrain(chIn, 1, 2);
+    s->chOut = fxR ? 2 : constrain(chOut, 1, 2);
+    s->bypass = false;
+    stageNum++;
+    active_update();            // the stage is visible to update() after the publish
+    return stageNum - 1;
+}
+
+void AudioEffectChain_F32::bypass(uint8_t stage, bool state)
+{
+    if (stage >= stageNum) return;
+    stages[stage].bypass = state;
+    active_update();
+}
+
+void AudioEffectChain_F32::mix(uint8_t stage, float32_t ratio)
+{
+    if (stage >= stageNum) return;
+    params.edit().mix[stage] = constrain(ratio, 0.0f, 1.0f);
+    params.publish();
+}
+
+// rebuild the lists of the processed and the bypassed stages, update() only walks these lists
+void AudioEffectChain_F32::active_update()
+{
+    params_t &p = params.edit();
+    uint8_t i, num = 0, skip = 0;
+    for (i = 0; i < stageNum; i++)
+    {
+        if (!stages[i].bypass) p.active[num++] = i;
+        else p.skipped[skip++] = i;
+    }
+    p.activeNum = num;
+    p.skippedNum = skip;
+    params.publish();
+}
+
+void AudioEffectChain_F32::update()
+{
+#if defined(__ARM_ARCH_7EM__) || defined(HX_HOST_BUILD)
+    audio_block_f32_t *blockL, *blockR;
+    uint32_t n;
+    bool stereo;
+
+    blockL = AudioStream_F32::receiveWritable_f32(0);
+    blockR = AudioStream_F32::receiveWritable_f32(1);
+    if (!blockL)
+    {
+        if (blockR) AudioStream_F32::release(blockR);
+        return;
+    }
+    stereo = blockR != NULL;
+    if (!stereo)        // mono input, the R block is needed for the output anyway
+    {
+        blockR = AudioStream_F32::allocate_f32();
+        if (!blockR)
+        {
+            allocFailCount++;
+            AudioStream_F32::release(blockL);
+            return;
+        }
+        n = blockL->length;
+    }
+    else n = min(blockL->length, blockR->length);
+    blockL->length = n;
+    blockR->length = n;
+    const float32_t *in[2] = {blockL->data, stereo ? blockR->data : NULL};
+    float32_t *out[2] = {blockL->data, blockR->data};
+    process(in, out, n);
+    AudioStream_F32::transmit(blockL, 0);
+    AudioStream_F32::transmit(blockR, 1);
+    AudioStream_F32::release(blockL);
+    AudioStream_F32::release(blockR);
+#endif
+}
+
+void AudioEffectChain_F32::process(const float32_t *const *in, float32_t *const *out, uint32_t n)
+{
+    float32_t *const *buf = out;        // working buffer
+    const chain_stage_t *s;
+    uint8_t ch = in[1] ? 2 : 1;
+    uint8_t i, idx;
+
+    params.fetch(prm);
+    if (buf[0] != in[0]) memcpy(buf[0], in[0], n * sizeof(float32_t));
+    if (ch == 2 && buf[1] != in[1]) memcpy(buf[1], in[1], n * sizeof(float32_t));
+    for (i = 0; i < prm.activeNum; i++)
+    {
+        idx = prm.active[i];
+        s = &stages[idx];
+        if (ch < 2 && (s->chIn == 2 || s->fx[1]))   // mono stream feeds both inputs
+        {
+            memcpy(buf[1], buf[0], n * sizeof(float32_t));
+            ch = 2;
+        }
+        // wet only: nothing to mix once the ramp has reached 1.0
+        if (prm.mix[idx] == 1.0f && mixRamp[idx].value == 1.0f)
+        {
+            stage_run(s, buf, 0, n);
+            ch = s->chOut;
+        }
+        else ch = stage_mix(idx, buf, ch, n);
+    }
+    for (i = 0; i < prm.skippedNum; i++)    // bypassed stages stay in step with the stream
+    {
+        s = &stages[prm.skipped[i]];
+        if (!s->adv) continue;
+        s->adv(s->fx[0], n);
+        if (s->fx[1]) s->adv(s->fx[1], n);
+    }
+    if (ch < 2) memcpy(buf[1], buf[0], n * sizeof(float32_t));
+}
+
+// runs the stage on n samples of the working buffer from sample pos
+void AudioEffectChain_F32::stage_run(const chain_stage_t *s, float32_t *const *buf, uint32_t pos, uint32_t n)
+{
+    const float32_t *src[3] = {buf[0] + pos, s->chIn == 2 ? buf[1] + pos : NULL, NULL};  // unused inputs are NULL (modulation)
+    const float32_t *srcR[3] = {buf[1] + pos, NULL, NULL};
+    float32_t *const dst[2] = {buf[0] + pos, buf[1] + pos};
+
+    s->fn(s->fx[0], src, dst, n);
+    if (s->fx[1]) s->fn(s->fx[1], srcR, dst + 1, n);
+}
+
+/**
+ * @brief Runs the stage idx with the dry/wet mix in chunks of up to
+ *          AUDIO_BLOCK_SAMPLES, the dry input is copied before each chunk
+ * 
+ * @param ch    channels of the stream at the stage input
+ * @return      channels of the stream after the stage, the wider of
+ *              the dry and the wet signal
+ */
+uint8_t AudioEffectChain_F32::stage_mix(uint8_t idx, float32_t *const *buf, uint8_t ch, uint32_t n)
+{
+    const chain_stage_t *s = &stages[idx];
+    AudioRamp &ramp = mixRamp[idx];
+    uint8_t chMix = max(ch, s->chOut);
+    uint32_t pos, len, j;
+    uint8_t c;
+
+    for (pos = 0; pos < n; pos += len)
+    {
+        len = ramp.span(prm.mix[idx], min(n - pos, (uint32_t)AUDIO_BLOCK_SAMPLES));
+        for (c = 0; c < ch; c++) memcpy(dry[c], buf[c] + pos, len * sizeof(float32_t));
+        stage_run(s, buf, pos, len);
+        if (s->chOut < chMix) memcpy(buf[1] + pos, buf[0] + pos, len * sizeof(float32_t));  // mono wet, stereo dry
+        ramp.begin(prm.mix[idx], len);
+        for (c = 0; c < chMix; c++)
+        {
+            float32_t *wet = buf[c] + pos;
+            const float32_t *d = dry[c < ch ? c : 0];       // mono dry, stereo wet
+            float32_t m = ramp.value;
+            for (j = 0; j < len; j++)
+            {
+                wet[j] = d[j] * (1.0f - m) + wet[j] * m;
+                m += ramp.step;
+            }
+        }
+        ramp.end();
+    }
+    return chMix;
+}
@@ -0,0 +1,175 @@
+/*  Fused effect chain: several F32 effects processed in one update()
+ *
+ *  Author: Piotr Zapart
+ *          www.hexefx.com
+ *
+ * Copyright (c) 2021 by Piotr Zapart
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _EFFECT_CHAIN_F32_H
+#define _EFFECT_CHAIN_F32_H
+
+#include <Arduino.h>
+#include "AudioStream_F32.h"
+#include "arm_math.h"
+#include "utility_params.h"
+#include "utility_ramp.h"
+
+#define CHAIN_MAX_STAGES    8
+
+/**
+ * @brief Runs the process() functions of several F32 effects back to back
+ *      on one stereo working buffer, in place. The data passes through one
+ *      update() without any pool blocks, transmits or scheduling between
+ *      the stages:
+ * 
+ *      ToneStack -> Phaser -> MonoToStereo -> PlateReverb:
+ *      4 nodes, 6 allocated blocks per cycle -> 1 node, 2 blocks
+ * 
+ *      The stage effects are created as usual, but must NOT be connected 
+ *      to anything, the chain calls their processing cores. Their parameter
+ *      functions work the same way.
+ *      Inputs: 0 = L, 1 = R (unconnected: mono stream), outputs: 0 = L, 1 = R
+ *      Stream width follows the stages: a mono stream feeds both inputs of
+ *      a stereo stage, a mono stage in a stereo stream processes the left
+ *      channel and the stream becomes mono (use a dual mono stage to keep
+ *      it stereo). A mono stream at the end is sent to both outputs.
+ *      Modulation inputs of the stages are not connected (internal LFO or
+ *      the modulation bus). MonoToStereo must be used in the stereo mode.
+ *      Each stage has a dry/wet mix (mix()), ie. for a wet only reverb at 
+ *      the end of the chain. A mixing stage keeps the width of its input:
+ *      the dry stereo signal stays stereo after a mono stage.
+ */
+class AudioEffectChain_F32 : public AudioStream_F32
+{
+public:
+    typedef void (*process_f)(void *fx, const float32_t *const *in, float32_t *const *out, uint32_t n);
+    typedef void (*advance_f)(void *fx, uint32_t n);
+
+    AudioEffectChain_F32();
+    ~AudioEffectChain_F32(){};
+    virtual void update();
+    /**
+     * @brief Processing core called by update(), can be used without the
+     *          audio library for any block length
+     * 
+     * @param in    in[0], in[1] audio L/R, in[1] = NULL for a mono input
+     * @param out   out[0], out[1] audio L/R, can be the same buffers as in[0], in[1]
+     * @param n     number of samples
+     */
+    void process(const float32_t *const *in, float32_t *const *out, uint32_t n);
+    /**
+     * @brief Appends an effect with a process() function as the next stage
+     * 
+     * @param fx    F32 effect, not connected to the audio graph
+     * @return int  stage number, -1 if the chain is full
+     */
+    template<class T>
+    int add(T &fx)
+    {
+        static_assert(T::PROC_IN <= 2 && T::PROC_OUT <= 2, "only mono and stereo stages");
+        return add(stage_call<T>, &fx, NULL, T::PROC_IN, T::PROC_OUT, stage_advance<T>);
+    }
+    /**
+     * @brief Appends a dual mono stage: two instances of a mono effect,
+     *          one per channel. The stream becomes stereo.
+     */
+    template<class T>
+    int add(T &fxL, T &fxR)
+    {
+        static_assert(T::PROC_IN == 1 && T::PROC_OUT == 1, "dual mono needs a mono effect");
+        return add(stage_call<T>, &fxL, &fxR, 1, 1, stage_advance<T>);
+    }
+    /**
+     * @brief Appends any processing function
+     * 
+     * @param fn    called with fxL (and fxR for a dual mono stage)
+     * @param chIn  input channels, 1 or 2, in[chIn] and above are NULL
+     * @param chOut output channels, 1 or 2
+     * @param adv   optional, advances the sample clock of a bypassed stage
+     */
+    int add(process_f fn, void *fxL, void *fxR, uint8_t chIn, uint8_t chOut, advance_f adv = NULL);
+    /**
+     * @brief Skips the stage, a bypassed stage costs nothing.
+     *          The signal passes unchanged, ie. after a bypassed MonoToStereo 
+     *          the mono signal is sent to both outputs. The sample clock of
+     *          the stage keeps running (advance()), changes scheduled with
+     *          at() falling due meanwhile are applied when it is back.
+     * 
+     * @param stage stage number returned by add()
+     * @param state true = bypass on
+     */
+    void bypass(uint8_t stage, bool state);
+    bool bypass_get(uint8_t stage) { return stage < stageNum ? stages[stage].bypass : false;}
+    /**
+     * @brief Dry/wet mix of the stage, ramped (utility_ramp.h). The wet
+     *          only default costs nothing, a mixing stage copies its input
+     *          and processes the block in AUDIO_BLOCK_SAMPLES chunks.
+     * 
+     * @param stage stage number returned by add()
+     * @param ratio 0.0f (dry) to 1.0f (wet, default)
+     */
+    void mix(uint8_t stage, float32_t ratio);
+    float32_t mix_get(uint8_t stage) { return stage < stageNum ? params.get().mix[stage] : 1.0f;}
+    uint8_t stages_get() { return stageNum;}
+    uint32_t allocFailCount;        // update() skipped, no free block for the R channel
+
+private:
+    typedef struct
+    {
+        process_f fn;
+        advance_f adv;
+        void *fx[2];                // fx[1] != NULL: dual mono stage
+        uint8_t chIn, chOut;
+        bool bypass;
+    } chain_stage_t;
+    audio_block_f32_t *inputQueueArray_f32[2];
+    chain_stage_t stages[CHAIN_MAX_STAGES];
+    uint8_t stageNum;
+    typedef struct
+    {
+        uint8_t active[CHAIN_MAX_STAGES];   // stages not bypassed, in order
+        uint8_t activeNum;
+        uint8_t skipped[CHAIN_MAX_STAGES];  // bypassed stages, only the clocks run
+        uint8_t skippedNum;
+        float32_t mix[CHAIN_MAX_STAGES];    // dry/wet ratio of the stage
+    } params_t;
+    AudioParams<params_t> params;   // written by add(), bypass() and mix()
+    params_t prm;                   // in use by update(), see utility_params.h
+    AudioRamp mixRamp[CHAIN_MAX_STAGES];
+    float32_t dry[2][AUDIO_BLOCK_SAMPLES];  // input of a mixing stage
+    void active_update();
+    void stage_run(const chain_stage_t *s, float32_t *const *buf, uint32_t pos, uint32_t n);
+    uint8_t stage_mix(uint8_t idx, float32_t *const *buf, uint8_t ch, uint32_t n);
+
+    template<class T>
+    static void stage_call(void *fx, const float32_t *const *in, float32_t *const *out, uint32_t n)
+    {
+        ((T *)fx)->process(in, out, n);
+    }
+    template<class T>
+    static void stage_advance(void *fx, uint32_t n)
+    {
+        ((T *)fx)->advance(n);
+    }
+};
+
+#endif // _EFFECT_CHAIN_F32_H
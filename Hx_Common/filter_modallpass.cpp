@@ -0,0 +1,58 @@
+/*  Hyper triangle LFO table of the modulated allpass chain (filter_modallpass.h)
+ *
+ *  Author: Piotr Zapart
+ *          www.hexefx.com
+ *
+ * Copyright (c) 2021 by Piotr Zapart
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "filter_modallpass.h"
+
+// parabollic/hypertriangular waveform used for the internal LFO
+const uint16_t AudioWaveformHyperTri[257] =
+{
+     0,    804,   1608,   2412,   3216,   4019,   4821,   5623,   6424,   7223,
+  8022,   8820,   9616,  10411,  11204,  11996,  12785,  13573,  14359,  15142,
+ 15924,  16703,  17479,  18253,  19024,  19792,  20557,  21319,  22078,  22834,
+ 23586,  24334,  25079,  25820,  26557,  27291,  28020,  28745,  29465,  30181,
+ 30893,  31600,  32302,  32999,  33692,  34379,  35061,  35738,  36409,  37075,
+ 37736,  38390,  39039,  39682,  40319,  40950,  41575,  42194,  42806,  43411,
+ 44011,  44603,  45189,  45768,  46340,  46905,  47464,  48014,  48558,  49095,
+ 49624,  50145,  50659,  51166,  51664,  52155,  52638,  53113,  53580,  54039,
+ 54490,  54933,  55367,  55794,  56211,  56620,  57021,  57413,  57797,  58171,
+ 58537,  58895,  59243,  59582,  59913,  60234,  60546,  60850,  61144,  61429,
+ 61704,  61970,  62227,  62475,  62713,  62942,  63161,  63371,  63571,  63762,
+ 63943,  64114,  64276,  64428,  64570,  64703,  64826,  64939,  65042,  65136,
+ 65219,  65293,  65357,  65412,  65456,  65491,  65515,  65530,  65535,  65530,
+ 65515,  65491,  65456,  65412,  65357,  65293,  65219,  65136,  65042,  64939,
+ 64826,  64703,  64570,  64428,  64276,  64114,  63943,  63762,  63571,  63371,
+ 63161,  62942,  62713,  62475,  62227,  61970,  61704,  61429,  61144,  60850,
+ 60546,  60234,  59913,  59582,  59243,  58895,  58537,  58171,  57797,  57413,
+ 57021,  56620,  56211,  55794,  55367,  54933,  54490,  54039,  53580,  53113,
+ 52638,  52155,  51664,  51166,  50659,  50145,  49624,  49095,  48558,  48014,
+ 47464,  46905,  46340,  45768,  45189,  44603,  44011,  43411,  42806,  42194,
+ 41575,  40950,  40319,  39682,  39039,  38390,  37736,  37075,  36409,  35738,
+ 35061,  34379,  33692,  32999,  32302,  31600,  30893,  30181,  29465,  28745,
+ 28020,  27291,  26557,  25820,  25079,  24334,  23586,  22834,  22078,  21319,
+ 20557,  19792,  19024,  18253,  17479,  16703,  15924,  15142,  14359,  13573,
+ 12785,  11996,  11204,  10411,   9616,   8820,   8022,   7223,   6424,   5623,
+  4821,   4019,   3216,   2412,   1608,    804,      0
+ };
@@ -0,0 +1,512 @@
+/*  Modulated 1st order allpass chain shared by the phaser effects
+ *
+ *  Author: Piotr Zapart
+ *          www.hexefx.com
+ *
+ * Copyright (c) 2021 by Piotr Zapart
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef _FILTER_MODALLPASS_H_
+#define _FILTER_MODALLPASS_H_
+
+#include <stdint.h>
+#include <string.h>
+#include "arm_math.h"
+#include "utility_denormal.h"
+
+// ---------------------------- PHASER LFO ---------------------------------------
+#define MODALLP_LFO_LUT_BITS			8
+#define MODALLP_LFO_INT_SHIFT			(32-MODALLP_LFO_LUT_BITS)
+#define MODALLP_LFO_FRACT_MASK			((1<<MODALLP_LFO_INT_SHIFT)-1)
+
+// parabollic/hypertriangular waveform used for the internal LFO, filter_modallpass.cpp
+extern const uint16_t AudioWaveformHyperTri[257];
+
+/**
+ * @brief interpolated hyper triangle LFO
+ *
+ * @param phase 32bit phase accumulator
+ * @return float32_t LFO value in range 0.0f to 1.0f
+ */
+static inline float32_t modallp_lfo_hypertri(uint32_t phase)
+{
+	uint32_t LUTaddr = phase >> MODALLP_LFO_INT_SHIFT;	// 8 bit address
+	uint32_t fract = phase & MODALLP_LFO_FRACT_MASK;	// fractional part
+	uint64_t y = (uint64_t)AudioWaveformHyperTri[LUTaddr] * (MODALLP_LFO_FRACT_MASK - fract);
+	y += (uint64_t)AudioWaveformHyperTri[LUTaddr+1] * fract;
+	return (float32_t)(y >> MODALLP_LFO_INT_SHIFT) / 65535.0f;
+}
+/**
+ * @brief integer version of the hyper triangle LFO for the fixed point kernel
+ *
+ * @param phase 32bit phase accumulator
+ * @return uint32_t LFO value in range 0 to 65535
+ */
+static inline uint32_t modallp_lfo_hypertri_q16(uint32_t phase)
+{
+	uint32_t LUTaddr = phase >> MODALLP_LFO_INT_SHIFT;
+	uint32_t fract = (phase & MODALLP_LFO_FRACT_MASK) >> (MODALLP_LFO_INT_SHIFT - 16);	// 16 bit fraction
+	return (AudioWaveformHyperTri[LUTaddr] * (65536 - fract) + AudioWaveformHyperTri[LUTaddr+1] * fract) >> 16;
+}
+/**
+ * @brief two hyper triangle LFO outputs, the second one shifted by a whole
+ * 		number of LUT steps. The fractional part is shared, the second
+ * 		output costs only two extra table reads.
+ *
+ * @param phase 32bit phase accumulator
+ * @param offset phase offset in LUT steps, 64 = 90deg
+ * @param out LFO values in range 0.0f to 1.0f
+ */
+static inline void modallp_lfo_hypertri2(uint32_t phase, uint32_t offset, float32_t *out)
+{
+	uint32_t LUTaddr = phase >> MODALLP_LFO_INT_SHIFT;
+	uint32_t LUTaddr2 = (LUTaddr + offset) & ((1<<MODALLP_LFO_LUT_BITS)-1);
+	uint64_t fract = phase & MODALLP_LFO_FRACT_MASK;
+	uint64_t fract_n = MODALLP_LFO_FRACT_MASK - fract;
+	uint64_t y = AudioWaveformHyperTri[LUTaddr] * fract_n + AudioWaveformHyperTri[LUTaddr+1] * fract;
+	uint64_t y2 = AudioWaveformHyperTri[LUTaddr2] * fract_n + AudioWaveformHyperTri[LUTaddr2+1] * fract;
+	out[0] = (float32_t)(y >> MODALLP_LFO_INT_SHIFT) / 65535.0f;
+	out[1] = (float32_t)(y2 >> MODALLP_LFO_INT_SHIFT) / 65535.0f;
+}
+static inline void modallp_lfo_hypertri2_q16(uint32_t phase, uint32_t offset, uint32_t *out)
+{
+	uint32_t LUTaddr = phase >> MODALLP_LFO_INT_SHIFT;
+	uint32_t LUTaddr2 = (LUTaddr + offset) & ((1<<MODALLP_LFO_LUT_BITS)-1);
+	uint32_t fract = (phase & MODALLP_LFO_FRACT_MASK) >> (MODALLP_LFO_INT_SHIFT - 16);
+	uint32_t fract_n = 65536 - fract;
+	out[0] = (AudioWaveformHyperTri[LUTaddr] * fract_n + AudioWaveformHyperTri[LUTaddr+1] * fract) >> 16;
+	out[1] = (AudioWaveformHyperTri[LUTaddr2] * fract_n + AudioWaveformHyperTri[LUTaddr2+1] * fract) >> 16;
+}
+// ---------------------------- /PHASER LFO --------------------------------------
+
+// ---------------------------- FIXED POINT HELPERS ------------------------------
+// (a * b[15:0]) >> 16, b is a Q15 coefficient, result is a*b/2
+static inline int32_t modallp_smulwb(int32_t a, int32_t b)
+{
+#if defined(__ARM_ARCH_7EM__)
+	int32_t out;
+	asm ("smulwb %0, %1, %2" : "=r" (out) : "r" (a), "r" (b));
+	return out;
+#else
+	return (int32_t)(((int64_t)a * (int16_t)b) >> 16);
+#endif
+}
+// (a * b) >> 32, b is a Q31 coefficient, result is a*b/2
+static inline int32_t modallp_smmul(int32_t a, int32_t b)
+{
+#if defined(__ARM_ARCH_7EM__)
+	int32_t out;
+	asm ("smmul %0, %1, %2" : "=r" (out) : "r" (a), "r" (b));
+	return out;
+#else
+	return (int32_t)(((int64_t)a * b) >> 32);
+#endif
+}
+// saturate(a + saturate(2*b))
+static inline int32_t modallp_qdadd(int32_t a, int32_t b)
+{
+#if defined(__ARM_ARCH_7EM__)
+	int32_t out;
+	asm ("qdadd %0, %1, %2" : "=r" (out) : "r" (a), "r" (b));
+	return out;
+#else
+	int64_t b2 = 2 * (int64_t)b;
+	if (b2 > INT32_MAX) b2 = INT32_MAX;
+	if (b2 < INT32_MIN) b2 = INT32_MIN;
+	int64_t s = a + b2;
+	if (s > INT32_MAX) s = INT32_MAX;
+	if (s < INT32_MIN) s = INT32_MIN;
+	return (int32_t)s;
+#endif
+}
+// saturate(a + b)
+static inline int32_t modallp_qadd(int32_t a, int32_t b)
+{
+#if defined(__ARM_ARCH_7EM__)
+	int32_t out;
+	asm ("qadd %0, %1, %2" : "=r" (out) : "r" (a), "r" (b));
+	return out;
+#else
+	int64_t s = (int64_t)a + b;
+	if (s > INT32_MAX) s = INT32_MAX;
+	if (s < INT32_MIN) s = INT32_MIN;
+	return (int32_t)s;
+#endif
+}
+// saturate(a >> rshift) to 16 bits
+template <int rshift>
+static inline int16_t modallp_sat16_rshift(int32_t a)
+{
+#if defined(__ARM_ARCH_7EM__)
+	int32_t out;
+	asm ("ssat %0, #16, %1, asr %2" : "=r" (out) : "r" (a), "I" (rshift));
+	return out;
+#else
+	a >>= rshift;
+	if (a > 32767) a = 32767;
+	if (a < -32768) a = -32768;
+	return a;
+#endif
+}
+// ---------------------------- /FIXED POINT HELPERS -----------------------------
+
+// sample format conversions fused into the block processing
+static inline float32_t modallp_to_f32(float32_t x) { return x;}
+static inline float32_t modallp_to_f32(int16_t x) { return (float32_t)x / 32768.0f;}
+static inline void modallp_from_f32(float32_t x, float32_t *dst) { *dst = x;}
+static inline void modallp_from_f32(float32_t x, int16_t *dst)
+{
+	x *= 32767.0f;
+	if (x > 32767.0f) x = 32767.0f;
+	if (x < -32768.0f) x = -32768.0f;
+	*dst = (int16_t)x;
+}
+
+/**
+ * @brief Bank of LANES independent chains of modulated 1st order allpass
+ * 		filters with a feedback path around each chain:
+ * 		H(z) = (k - z^-1) / (1 - k*z^-1), k = modulation signal
+ * 		States are stored stage first, lane second, as in AudioFilterTDF2Multi,
+ * 		the inner lane loop has no dependencies between iterations.
+ * 		Number of active stages can be changed at runtime (<= STAGES).
+ */
+template <int STAGES, int LANES = 1>
+class AudioFilterModAllpass
+{
+public:
+	float32_t x[STAGES][LANES];		// allpass inputs
+	float32_t y[STAGES][LANES];		// allpass outputs
+	float32_t fb[LANES];			// last output of each chain
+
+	void reset()
+	{
+		memset(x, 0, sizeof(x));
+		memset(y, 0, sizeof(y));
+		memset(fb, 0, sizeof(fb));
+	}
+	/**
+	 * @brief clears the decayed states, once per block, see utility_denormal.h
+	 */
+	void snap()
+	{
+		denormal_snap(&x[0][0], STAGES * LANES);
+		denormal_snap(&y[0][0], STAGES * LANES);
+		denormal_snap(fb, LANES);
+	}
+	/**
+	 * @brief process one sample in all lanes
+	 *
+	 * @param in 		input for each lane
+	 * @param k 		allpass coefficient (modulation) for each lane
+	 * @param fdb 		feedback amount
+	 * @param out 		chain output for each lane
+	 * @param stages 	number of active stages
+	 */
+	inline void tick(const float32_t *in, const float32_t *k, float32_t fdb, float32_t *out, uint32_t stages)
+	{
+		float32_t s[LANES];
+		for (int l = 0; l < LANES; l++)
+			s[l] = in[l] + fb[l] * fdb;
+		for (uint32_t j = stages; j > 0; )		// top down, the active stages keep their states
+		{
+			j--;
+			float32_t *px = x[j];
+			float32_t *py = y[j];
+			for (int l = 0; l < LANES; l++)
+			{
+				// k*(y + s) - x regrouped, only one multiply-add depends on the previous stage
+				float32_t o = k[l] * s[l] + (k[l] * py[l] - px[l]);
+				px[l] = s[l];
+				py[l] = o;
+				s[l] = o;
+			}
+		}
+		for (int l = 0; l < LANES; l++)
+		{
+			fb[l] = s[l];
+			out[l] = s[l];
+		}
+	}
+	/**
+	 * @brief complete phaser for all lanes: input attenuation, feedback,
+	 * 		allpass chain and dry/wet mix. The sample format conversion
+	 * 		is done on the fly, src and dst can point to the same buffers.
+	 *
+	 * @param src 		input for each lane, int16_t or float32_t
+	 * @param dst 		output for each lane, int16_t or float32_t
+	 * @param k 		allpass coefficients for each sample and lane
+	 * @param blockSize number of samples
+	 * @param stages 	number of active stages
+	 * @param fdb 		feedback amount, 0.0f to 1.0f
+	 * @param mix 		dry/wet ratio, 0.0f = dry, 1.0f = wet
+	 * @param fdbStep 	per sample ramp of fdb, see utility_ramp.h
+	 * @param mixStep 	per sample ramp of mix
+	 */
+	template <typename T>
+	void process(const T * const *src, T * const *dst, const float32_t (*k)[LANES], uint32_t blockSize, uint32_t stages, float32_t fdb, float32_t mix,
+				 float32_t fdbStep = 0.0f, float32_t mixStep = 0.0f)
+	{
+		float32_t inAttn = 1.0f - fdb*0.25f;	// attenuate the input if using feedback
+		float32_t attnStep = fdbStep * -0.25f;
+		const bool ramp = fdbStep != 0.0f || mixStep != 0.0f;
+		float32_t dry[LANES], wet[LANES];
+		for (uint32_t i = 0; i < blockSize; i++)
+		{
+			for (int l = 0; l < LANES; l++)
+				dry[l] = modallp_to_f32(src[l][i]) * inAttn;
+			tick(dry, k[i], fdb, wet, stages);
+			for (int l = 0; l < LANES; l++)
+				modallp_from_f32(dry[l] * (1.0f - mix) + wet[l] * mix, &dst[l][i]);
+			if (ramp)
+			{
+				fdb += fdbStep;
+				mix += mixStep;
+				inAttn += attnStep;
+			}
+		}
+		snap();
+	}
+	/**
+	 * @brief single lane version of the above
+	 */
+	template <typename T>
+	void process(const T *src, T *dst, const float32_t *k, uint32_t blockSize, uint32_t stages, float32_t fdb, float32_t mix,
+				 float32_t fdbStep = 0.0f, float32_t mixStep = 0.0f)
+	{
+		static_assert(LANES == 1, "use the multi lane process()");
+		process(&src, &dst, (const float32_t (*)[LANES])k, blockSize, stages, fdb, mix, fdbStep, mixStep);
+	}
+};
+
+/**
+ * @brief Bank of LANES chains of modulated 2nd order allpass sections, each
+ * 		section equals two 1st order stages of AudioFilterModAllpass:
+ * 		H(z) = (a2 + a1*z^-1 + z^-2) / (1 + a1*z^-1 + a2*z^-2), a1 = -2k, a2 = k^2
+ * 		The coefficients are computed once per sub-block. Everything except
+ * 		a2*in is taken from the section states, so the serial path through
+ * 		the chain is one multiply-add per section (per two 1st order stages).
+ */
+template <int SECTIONS, int LANES = 1>
+class AudioFilterModAllpass2
+{
+public:
+	float32_t x1[SECTIONS][LANES];	// DF1 states, stable under coefficient modulation
+	float32_t x2[SECTIONS][LANES];
+	float32_t y1[SECTIONS][LANES];
+	float32_t y2[SECTIONS][LANES];
+	float32_t fb[LANES];			// last output of each chain
+
+	void reset()
+	{
+		memset(x1, 0, sizeof(x1));
+		memset(x2, 0, sizeof(x2));
+		memset(y1, 0, sizeof(y1));
+		memset(y2, 0, sizeof(y2));
+		memset(fb, 0, sizeof(fb));
+	}
+	/**
+	 * @brief clears the decayed states, once per block, see utility_denormal.h
+	 */
+	void snap()
+	{
+		denormal_snap(&x1[0][0], SECTIONS * LANES);
+		denormal_snap(&x2[0][0], SECTIONS * LANES);
+		denormal_snap(&y1[0][0], SECTIONS * LANES);
+		denormal_snap(&y2[0][0], SECTIONS * LANES);
+		denormal_snap(fb, LANES);
+	}
+	/**
+	 * @brief complete phaser for all lanes, see AudioFilterModAllpass::process
+	 *
+	 * @param src 		input for each lane, int16_t or float32_t
+	 * @param dst 		output for each lane, int16_t or float32_t
+	 * @param k 		allpass coefficients for each sub-block and lane
+	 * @param blockSize number of samples, the last sub-block may be shorter
+	 * @param subBlock 	coefficient update period in samples
+	 * @param sections 	number of active sections
+	 * @param fdb 		feedback amount, 0.0f to 1.0f
+	 * @param mix 		dry/wet ratio, 0.0f = dry, 1.0f = wet
+	 * @param fdbStep 	per sample ramp of fdb, see utility_ramp.h
+	 * @param mixStep 	per sample ramp of mix
+	 */
+	template <typename T>
+	void process(const T * const *src, T * const *dst, const float32_t (*k)[LANES], uint32_t blockSize, uint32_t subBlock,
+				 uint32_t sections, float32_t fdb, float32_t mix, float32_t fdbStep = 0.0f, float32_t mixStep = 0.0f)
+	{
+		float32_t inAttn = 1.0f - fdb*0.25f;	// attenuate the input if using feedback
+		float32_t attnStep = fdbStep * -0.25f;
+		const bool ramp = fdbStep != 0.0f || mixStep != 0.0f;
+		float32_t a1[LANES], a2[LANES], dry[LANES], s[LANES];
+		for (uint32_t n = 0; n < blockSize; n += subBlock, k++)
+		{
+			for (int l = 0; l < LANES; l++)
+			{
+				a1[l] = -2.0f * (*k)[l];
+				a2[l] = (*k)[l] * (*k)[l];
+			}
+			uint32_t end = min(n + subBlock, blockSize);
+			for (uint32_t i = n; i < end; i++)
+			{
+				for (int l = 0; l < LANES; l++)
+				{
+					dry[l] = modallp_to_f32(src[l][i]) * inAttn;
+					s[l] = dry[l] + fb[l] * fdb;
+				}
+				for (uint32_t j = sections; j > 0; )
+				{
+					j--;
+					for (int l = 0; l < LANES; l++)
+					{
+						float32_t t = a1[l] * (x1[j][l] - y1[j][l]) + x2[j][l] - a2[l] * y2[j][l];
+						float32_t o = a2[l] * s[l] + t;
+						x2[j][l] = x1[j][l];
+						x1[j][l] = s[l];
+						y2[j][l] = y1[j][l];
+						y1[j][l] = o;
+						s[l] = o;
+					}
+				}
+				for (int l = 0; l < LANES; l++)
+				{
+					fb[l] = s[l];
+					modallp_from_f32(dry[l] * (1.0f - mix) + s[l] * mix, &dst[l][i]);
+				}
+				if (ramp)
+				{
+					fdb += fdbStep;
+					mix += mixStep;
+					inAttn += attnStep;
+				}
+			}
+		}
+		snap();
+	}
+	/**
+	 * @brief single lane version of the above
+	 */
+	template <typename T>
+	void process(const T *src, T *dst, const float32_t *k, uint32_t blockSize, uint32_t subBlock,
+				 uint32_t sections, float32_t fdb, float32_t mix, float32_t fdbStep = 0.0f, float32_t mixStep = 0.0f)
+	{
+		static_assert(LANES == 1, "use the multi lane process()");
+		process(&src, &dst, (const float32_t (*)[LANES])k, blockSize, subBlock, sections, fdb, mix, fdbStep, mixStep);
+	}
+};
+
+#define MODALLP_Q31_HEADROOM	4	// int16 full scale = 2^(31-4) in the fixed point states
+
+/**
+ * @brief Fixed point version of the phaser chains: 32bit states, Q31
+ * 		allpass coefficients and saturating multiply-adds (smmul + qdadd).
+ * 		Near k = 1 the pole is sensitive to the coefficient resolution,
+ * 		Q15 coefficients there were 20dB off the float version.
+ * 		The states keep MODALLP_Q31_HEADROOM bits above the int16 full scale
+ * 		for the resonant peaks, the output is saturated to 16 bit.
+ * 		The allpass input state is stored negated, which makes every
+ * 		stage two saturating multiply-adds:
+ * 		v = -x + k*y, out = v + k*in
+ */
+template <int STAGES, int LANES = 1>
+class AudioFilterModAllpassQ31
+{
+public:
+	int32_t xn[STAGES][LANES];		// negated allpass inputs
+	int32_t y[STAGES][LANES];		// allpass outputs
+	int32_t fb[LANES];				// last chain output
+
+	void reset()
+	{
+		memset(xn, 0, sizeof(xn));
+		memset(y, 0, sizeof(y));
+		memset(fb, 0, sizeof(fb));
+	}
+	/**
+	 * @brief phaser for all lanes: input attenuation, feedback, allpass
+	 * 		chain and dry/wet mix, src and dst can point to the same buffers.
+	 *
+	 * @param src 		input for each lane, int16_t
+	 * @param dst 		output for each lane, int16_t
+	 * @param k 		allpass coefficients for each sample and lane, Q31, 0 to 2^31-1
+	 * @param blockSize number of samples
+	 * @param stages 	number of active stages
+	 * @param fdb 		feedback amount, Q15, 0 to 32767
+	 * @param mix 		dry/wet ratio, Q15, 0 = dry, 32767 = wet
+	 * @param fdbStep 	per sample ramp of fdb, Q31, see utility_ramp.h
+	 * @param mixStep 	per sample ramp of mix, Q31
+	 */
+	void process(const int16_t * const *src, int16_t * const *dst, const int32_t (*k)[LANES], uint32_t blockSize, uint32_t stages, int32_t fdb, int32_t mix,
+				 int32_t fdbStep = 0, int32_t mixStep = 0)
+	{
+		int32_t inAttn = 32768 - (fdb >> 2);	// attenuate the input if using feedback
+		int32_t dryGain = 32767 - mix;
+		const bool ramp = fdbStep || mixStep;
+		int32_t fdbAcc = fdb << 16;				// Q31 ramps, a Q15 step would lose up to 1 LSB per sample
+		int32_t mixAcc = mix << 16;
+		int32_t dry[LANES], s[LANES], v;
+		for (uint32_t i = 0; i < blockSize; i++)
+		{
+			const int32_t *kq = k[i];
+			for (int l = 0; l < LANES; l++)
+			{
+				dry[l] = (src[l][i] * inAttn) >> (MODALLP_Q31_HEADROOM - 1);	// Q15 * Q15 -> Q27
+				s[l] = modallp_qdadd(dry[l], modallp_smulwb(fb[l], fdb));
+			}
+			for (uint32_t j = stages; j > 0; )		// top down, as in the float kernel
+			{
+				j--;
+				int32_t *pxn = xn[j];
+				int32_t *py = y[j];
+				for (int l = 0; l < LANES; l++)
+				{
+					v = modallp_qdadd(pxn[l], modallp_smmul(py[l], kq[l]));
+					pxn[l] = ~s[l];						// -s - 1 LSB, no overflow for INT32_MIN
+					s[l] = modallp_qdadd(v, modallp_smmul(s[l], kq[l]));
+					py[l] = s[l];
+				}
+			}
+			for (int l = 0; l < LANES; l++)
+			{
+				fb[l] = s[l];
+				// both products are Q26, the sum can not overflow
+				dst[l][i] = modallp_sat16_rshift<15 - MODALLP_Q31_HEADROOM>(modallp_smulwb(dry[l], dryGain) + modallp_smulwb(s[l], mix));
+			}
+			if (ramp)
+			{
+				fdbAcc = modallp_qadd(fdbAcc, fdbStep);
+				mixAcc = modallp_qadd(mixAcc, mixStep);
+				fdb = max(fdbAcc, 0) >> 16;		// rounding of the steps can end just below 0
+				mix = max(mixAcc, 0) >> 16;
+				inAttn = 32768 - (fdb >> 2);
+				dryGain = 32767 - mix;
+			}
+		}
+	}
+	/**
+	 * @brief single lane version of the above
+	 */
+	void process(const int16_t *src, int16_t *dst, const int32_t *k, uint32_t blockSize, uint32_t stages, int32_t fdb, int32_t mix,
+				 int32_t fdbStep = 0, int32_t mixStep = 0)
+	{
+		static_assert(LANES == 1, "use the multi lane process()");
+		process(&src, &dst, (const int32_t (*)[LANES])k, blockSize, stages, fdb, mix, fdbStep, mixStep);
+	}
+};
+
+#endif // _FILTER_MODALLPASS_H_
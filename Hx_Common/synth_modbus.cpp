@@ -0,0 +1,208 @@
+/*  Modulation bus: block rate LFOs shared by the effects
+ *
+ *  Author: Piotr Zapart
+ *          www.hexefx.com
+ *
+ * Copyright (c) 2021 by Piotr Zapart
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <Arduino.h>
+#include "synth_modbus.h"
+#include "filter_modallpass.h"      // hyper triangle LFO
+
+#define MODBUS_PHASE_SCALE      (4294967296.0f / AUDIO_SAMPLE_RATE_EXACT)   // Hz to phase increment
+#define MODBUS_PHASE_MAX        2147483520.0f   // largest float below 2^31, +FS/2 would overflow the int32_t
+
+/**
+ * @brief Hz to phase increment, saturated just below +-FS/2
+ */
+static inline int32_t phase_add(float32_t f_Hz)
+{
+    return (int32_t)constrain(f_Hz * MODBUS_PHASE_SCALE, -MODBUS_PHASE_MAX, MODBUS_PHASE_MAX);
+}
+
+AudioModulationBus::AudioModulationBus() : AudioStream(0, NULL)
+{
+    params_t &p = params.edit();
+    for (int i = 0; i < MODBUS_CHANNELS; i++)
+    {
+        p.chan[i].wave = MODBUS_WAVE_OFF;
+        p.chan[i].master = i;
+        p.chan[i].beats = 0.0f;
+        p.chan[i].offset = 0;
+        p.chan[i].phaseAdd = 0;
+        p.chan[i].restartSeq = 0;
+        phaseAcc[i] = 0;
+        restartSeq[i] = 0;
+        blockPhase[i] = 0;
+        bufPtr[i] = buf[i];
+    }
+    memset(buf, 0, sizeof(buf));
+    p.bpm = 120.0f;
+    params.publish();
+    params.fetch(prm);
+    active = true;      // no connections, the audio library would skip the update otherwise
+}
+
+void AudioModulationBus::lfo(uint8_t ch, modbus_wave_e wave, float32_t f_Hz)
+{
+    if (ch >= MODBUS_CHANNELS || wave >= MODBUS_WAVE_NUM) return;
+    modbus_ch_t &c = params.edit().chan[ch];
+    c.wave = wave;
+    c.master = ch;
+    c.offset = 0;
+    c.beats = 0.0f;
+    c.phaseAdd = phase_add(f_Hz);
+    params.publish();
+}
+
+void AudioModulationBus::lfo_sync(uint8_t ch, modbus_wave_e wave, float32_t beats)
+{
+    if (ch >= MODBUS_CHANNELS || wave >= MODBUS_WAVE_NUM || beats <= 0.0f) return;
+    params_t &p = params.edit();
+    modbus_ch_t &c = p.chan[ch];
+    c.wave = wave;
+    c.master = ch;
+    c.offset = 0;
+    c.beats = beats;
+    c.phaseAdd = phase_add(p.bpm / 60.0f / beats);
+    params.publish();
+}
+
+void AudioModulationBus::link(uint8_t ch, uint8_t master, float32_t deg, modbus_wave_e wave)
+{
+    if (ch >= MODBUS_CHANNELS || master >= MODBUS_CHANNELS || wave >= MODBUS_WAVE_NUM) return;
+    params_t &p = params.edit();
+    if (ch == master || p.chan[master].master != master) return;     // no chains of links
+    deg = fmodf(deg, 360.0f);
+    if (deg < 0.0f) deg += 360.0f;
+    modbus_ch_t &c = p.chan[ch];
+    c.wave = wave;
+    c.master = master;
+    c.offset = (uint32_t)(deg * (4294967296.0 / 360.0));
+    c.beats = 0.0f;
+    for (int i = 0; i < MODBUS_CHANNELS; i++)   // channels linked to ch move to its master, same offset to ch
+    {
+        if (i == ch || p.chan[i].master != ch) continue;
+        p.chan[i].master = master;
+        p.chan[i].offset += c.offset;
+    }
+    params.publish();
+}
+
+void AudioModulationBus::tempo(float32_t newBpm)
+{
+    params_t &p = params.edit();
+    p.bpm = constrain(newBpm, 1.0f, 1000.0f);
+    for (int i = 0; i < MODBUS_CHANNELS; i++)
+    {
+        if (p.chan[i].beats > 0.0f) p.chan[i].phaseAdd = phase_add(p.bpm / 60.0f / p.chan[i].beats);
+    }
+    params.publish();       // all synced channels change in the same block
+}
+
+void AudioModulationBus::restart(uint8_t ch)
+{
+    if (ch >= MODBUS_CHANNELS) return;
+    params_t &p = params.edit();
+    p.chan[p.chan[ch].master].restartSeq++;
+    params.publish();
+}
+
+void AudioModulationBus::fill(float32_t *dst, modbus_wave_e wave, uint32_t phase, int32_t add)
+{
+    uint32_t i;
+    switch (wave)
+    {
+        case MODBUS_WAVE_SINE:
+        {
+            // start value from the phase, then a rotation by the phase increment per sample
+            float32_t w = (float32_t)phase * (2.0f * PI / 4294967296.0f);
+            float32_t d = (float32_t)add * (2.0f * PI / 4294967296.0f);
+            float32_t s = arm_sin_f32(w), c = arm_cos_f32(w);
+            float32_t sd = arm_sin_f32(d), cd = arm_cos_f32(d);
+            float32_t t;
+            for (i = 0; i < AUDIO_BLOCK_SAMPLES; i++)
+            {
+                dst[i] = 0.5f + 0.5f * s;
+                t = s * cd + c * sd;
+                c = c * cd - s * sd;
+                s = t;
+            }
+            break;
+        }
+        case MODBUS_WAVE_TRIANGLE:
+            for (i = 0; i < AUDIO_BLOCK_SAMPLES; i++)
+            {
+                float32_t t = (float32_t)phase * (1.0f / 2147483648.0f);   // 0.0 to 2.0
+                dst[i] = t < 1.0f ? t : 2.0f - t;
+                phase += add;
+            }
+            break;
+        case MODBUS_WAVE_HYPERTRI:
+            for (i = 0; i < AUDIO_BLOCK_SAMPLES; i++)
+            {
+                dst[i] = modallp_lfo_hypertri(phase);
+                phase += add;
+            }
+            break;
+        case MODBUS_WAVE_RAMP:
+            for (i = 0; i < AUDIO_BLOCK_SAMPLES; i++)
+            {
+                dst[i] = (float32_t)phase * (1.0f / 4294967296.0f);
+                phase += add;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void AudioModulationBus::update()
+{
+    int i;
+    uint8_t m;
+    const modbus_ch_t *chan = prm.chan;
+    if (params.fetch(prm))
+    {
+        for (i = 0; i < MODBUS_CHANNELS; i++)
+        {
+            if (chan[i].restartSeq == restartSeq[i]) continue;
+            phaseAcc[i] = 0;
+            restartSeq[i] = chan[i].restartSeq;
+        }
+    }
+    // phases for this block first, linked channels follow their master
+    for (i = 0; i < MODBUS_CHANNELS; i++)
+    {
+        m = chan[i].master;
+        blockPhase[i] = phaseAcc[m] + chan[i].offset;
+    }
+    for (i = 0; i < MODBUS_CHANNELS; i++)
+    {
+        if (chan[i].wave == MODBUS_WAVE_OFF) continue;
+        fill(buf[i], chan[i].wave, blockPhase[i], chan[chan[i].master].phaseAdd);
+    }
+    for (i = 0; i < MODBUS_CHANNELS; i++)
+    {
+        if (chan[i].master == i) phaseAcc[i] += (uint32_t)chan[i].phaseAdd * AUDIO_BLOCK_SAMPLES;
+    }
+}
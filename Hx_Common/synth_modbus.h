@@ -0,0 +1,150 @@
+/*  Modulation bus: block rate LFOs shared by the effects
+ *
+ *  Author: Piotr Zapart
+ *          www.hexefx.com
+ *
+ * Copyright (c) 2021 by Piotr Zapart
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _SYNTH_MODBUS_H
+#define _SYNTH_MODBUS_H
+
+#include <Arduino.h>
+#include "AudioStream.h"
+#include "arm_math.h"
+#include "utility_params.h"
+
+#define MODBUS_CHANNELS     8           // number of modulation buffers
+
+typedef enum
+{
+    MODBUS_WAVE_OFF,                    // channel not computed
+    MODBUS_WAVE_SINE,
+    MODBUS_WAVE_TRIANGLE,
+    MODBUS_WAVE_HYPERTRI,               // same waveform as the phaser internal LFO
+    MODBUS_WAVE_RAMP,                   // rising sawtooth
+    MODBUS_WAVE_NUM
+}modbus_wave_e;
+
+/**
+ * @brief Modulation bus. The LFOs are computed once per audio cycle into
+ *      the channel buffers, any number of effects can read a buffer by
+ *      reference (see the modulation() functions of the effects).
+ *      All outputs are unipolar, range 0.0f to 1.0f.
+ *      A channel can be linked to the phase of another channel with an
+ *      offset, building quadrature or N-phase sets from one oscillator.
+ *
+ *      Update order: the audio library updates the nodes in the order
+ *      they were created. Declare the bus BEFORE the effects using it,
+ *      otherwise they read the buffers computed in the previous cycle
+ *      (one block of modulation delay).
+ *      The bus has no audio inputs or outputs and does not need any
+ *      AudioConnection.
+ */
+class AudioModulationBus : public AudioStream
+{
+public:
+    AudioModulationBus();
+    ~AudioModulationBus(){};
+    virtual void update();
+    /**
+     * @brief Free running oscillator. The channels linked to ch stay
+     *      linked and follow the new rate.
+     *
+     * @param ch    channel 0..MODBUS_CHANNELS-1
+     * @param wave  waveform
+     * @param f_Hz  frequency, negative values run the phase backwards,
+     *              limited to just below +-FS/2
+     */
+    void lfo(uint8_t ch, modbus_wave_e wave, float32_t f_Hz);
+    /**
+     * @brief Tempo synced oscillator, the linked channels follow as with lfo()
+     *
+     * @param ch    channel 0..MODBUS_CHANNELS-1
+     * @param wave  waveform
+     * @param beats period length in beats, ie. 4.0f = one 4/4 bar, 0.25f = 1/16 note
+     */
+    void lfo_sync(uint8_t ch, modbus_wave_e wave, float32_t beats);
+    /**
+     * @brief Links a channel to the phase of another one
+     *      Quadrature:     link(1, 0, 90.0f)
+     *      6-phase set:    link(1..5, 0, 60.0f * n)
+     *      The channels linked to ch are moved to master, keeping
+     *      their phase offset to ch.
+     *
+     * @param ch        channel to link
+     * @param master    channel providing the phase, must not be linked itself
+     * @param deg       phase offset in degrees
+     * @param wave      waveform of the linked channel
+     */
+    void link(uint8_t ch, uint8_t master, float32_t deg, modbus_wave_e wave);
+    /**
+     * @brief Sets the tempo for the synced oscillators
+     *
+     * @param bpm beats per minute
+     */
+    void tempo(float32_t bpm);
+    /**
+     * @brief Restarts the oscillator of a channel (and the linked ones)
+     *      at phase 0, ie. on a downbeat.
+     */
+    void restart(uint8_t ch);
+    /**
+     * @brief Returns the modulation buffer of a channel,
+     *      AUDIO_BLOCK_SAMPLES long. The pointer stays valid for the
+     *      lifetime of the bus. NULL for an invalid channel.
+     */
+    const float32_t *buffer(uint8_t ch) { return ch < MODBUS_CHANNELS ? bufPtr[ch] : NULL;}
+    /**
+     * @brief Array of buffer pointers starting at channel ch, used by
+     *      the effects taking a set of N-phase channels.
+     */
+    const float32_t * const *buffers(uint8_t ch) { return ch < MODBUS_CHANNELS ? &bufPtr[ch] : NULL;}
+    /**
+     * @brief 32bit phase of the channel at the start of the last computed block
+     */
+    uint32_t phase(uint8_t ch) { return ch < MODBUS_CHANNELS ? blockPhase[ch] : 0;}
+private:
+    struct modbus_ch_t
+    {
+        modbus_wave_e wave;
+        uint8_t master;         // channel providing the phase, itself if not linked
+        float32_t beats;        // sync period, 0 = free running
+        uint32_t offset;        // phase offset for linked channels
+        int32_t phaseAdd;
+        uint32_t restartSeq;    // incremented by restart(), update() clears the phase
+    };
+    typedef struct
+    {
+        modbus_ch_t chan[MODBUS_CHANNELS];
+        float32_t bpm;
+    } params_t;
+    AudioParams<params_t> params;   // written by the setters
+    params_t prm;                   // in use by update(), see utility_params.h
+    uint32_t phaseAcc[MODBUS_CHANNELS];
+    uint32_t restartSeq[MODBUS_CHANNELS];   // last restartSeq applied to phaseAcc
+    uint32_t blockPhase[MODBUS_CHANNELS];
+    float32_t buf[MODBUS_CHANNELS][AUDIO_BLOCK_SAMPLES];
+    const float32_t *bufPtr[MODBUS_CHANNELS];
+    void fill(float32_t *dst, modbus_wave_e wave, uint32_t phase, int32_t add);
+};
+
+#endif // _SYNTH_MODBUS_H
@@ -0,0 +1,123 @@
+/*  Denormal protection of the recursive filter states
+ *
+ *  Author: Piotr Zapart
+ *          www.hexefx.com
+ *
+ * Copyright (c) 2021 by Piotr Zapart
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _UTILITY_DENORMAL_H
+#define _UTILITY_DENORMAL_H
+
+#include <Arduino.h>
+#include "arm_math.h"
+#if defined(HX_HOST_BUILD) && defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+/**
+ * Without an input the recursive states (filters, allpass chains, reverb
+ * tank) decay towards zero and end up as subnormal numbers. On a x86 host
+ * every operation on them costs ~100 cycles, the CPU load jumps exactly
+ * when the audio goes quiet. The effects keep their states normal:
+ *  - small filter states are cleared once per block when decayed below
+ *    DENORMAL_SNAP_LEVEL (denormal_snap()),
+ *  - long delay lines get a noise floor of DENORMAL_NOISE_LEVEL at the
+ *    input (AudioDenormalNoise), too small to change a bit of a signal
+ *    above ~1e-10.
+ * The host tools additionally run with the FPU flushing to zero
+ * (AudioFlushToZero).
+ */
+#define DENORMAL_SNAP_LEVEL     1.0e-15f    // -300dB
+#define DENORMAL_NOISE_LEVEL    1.0e-18f    // -360dB
+
+/**
+ * @brief Clears the states decayed below DENORMAL_SNAP_LEVEL, called after
+ *      the sample loop. A state can not fall from there to 1e-38 within
+ *      one block.
+ *
+ * @param st    state array
+ * @param n     number of states
+ */
+static inline void denormal_snap(float32_t *st, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+        if (fabsf(st[i]) < DENORMAL_SNAP_LEVEL) st[i] = 0.0f;
+}
+
+/**
+ * @brief White noise floor for the input of long recursive delay lines,
+ *      one multiply-add per sample
+ */
+class AudioDenormalNoise
+{
+public:
+    inline float32_t next()
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return (float32_t)(int32_t)seed * (DENORMAL_NOISE_LEVEL / 2147483648.0f);
+    }
+private:
+    uint32_t seed = 22222;
+};
+
+/**
+ * @brief Flush-to-zero for the lifetime of the object, the previous FPU
+ *      mode is restored by the destructor. Scope it around the processing
+ *      (ie. update_all() in a host render loop), not the whole program.
+ *      x86: MXCSR FTZ and DAZ, AArch64: FPCR.FZ, Cortex-M7: FPSCR.FZ.
+ */
+class AudioFlushToZero
+{
+public:
+    AudioFlushToZero(bool on = true) : active(on)
+    {
+        if (!active) return;
+#if defined(HX_HOST_BUILD) && defined(__SSE__)
+        saved = _mm_getcsr();
+        _mm_setcsr(saved | 0x8040);                                 // FTZ | DAZ
+#elif defined(__aarch64__)
+        uint64_t fpcr;
+        asm volatile("mrs %0, fpcr" : "=r"(fpcr));
+        saved = fpcr;
+        asm volatile("msr fpcr, %0" : : "r"(fpcr | (1ull << 24)));  // FZ
+#elif defined(__ARM_ARCH_7EM__)
+        asm volatile("vmrs %0, fpscr" : "=r"(saved));
+        asm volatile("vmsr fpscr, %0" : : "r"(saved | (1u << 24)));  // FZ
+#endif
+    }
+    ~AudioFlushToZero()
+    {
+        if (!active) return;
+#if defined(HX_HOST_BUILD) && defined(__SSE__)
+        _mm_setcsr(saved);
+#elif defined(__aarch64__)
+        asm volatile("msr fpcr, %0" : : "r"((uint64_t)saved));
+#elif defined(__ARM_ARCH_7EM__)
+        asm volatile("vmsr fpscr, %0" : : "r"(saved));
+#endif
+    }
+private:
+    bool active;
+    uint32_t saved = 0;
+};
+
+#endif // _UTILITY_DENORMAL_H
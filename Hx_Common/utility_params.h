@@ -0,0 +1,286 @@
+/*  Lock-free parameter exchange between the setters and update()
+ *
+ *  Author: Piotr Zapart
+ *          www.hexefx.com
+ *
+ * Copyright (c) 2021 by Piotr Zapart
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _UTILITY_PARAMS_H
+#define _UTILITY_PARAMS_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <string.h>
+#include <type_traits>
+
+#define PARAMS_EVENTS   8       // scheduled sets per effect, power of 2
+#define PARAMS_WORD     8       // bytes per tracked word, holds a pointer or double
+
+/**
+ * @brief Triple buffered parameter set of an effect. 
+ *      The setters change a private copy of the whole set (edit()) and
+ *      publish() it in one step, update() picks up the newest published
+ *      set at the start of the next block (fetch()). Neither side ever
+ *      waits or disables the interrupts, a set is never seen half written,
+ *      several fields changed before one publish() arrive together.
+ *      
+ *      One writer (main loop or one control thread) and one reader
+ *      (audio interrupt or the host render thread). Both sides exchange
+ *      the index of the middle buffer with a single atomic operation:
+ *      LDREX/STREX on the Cortex-M7, std::atomic on the host.
+ * 
+ *      Sample accurate changes: at(t) before a setter call queues the 
+ *      published change for sample t of the audio side clock, time() is 
+ *      the next sample to be processed. The processing core asks for the
+ *      number of samples up to the next due change (fetch(dst, n)) and 
+ *      splits the block there, the samples in between run the normal
+ *      block code. The clock counts the samples passed through
+ *      fetch(dst, n): effects processing the same stream stay in step,
+ *      time() of one of them can be used for all. Up to PARAMS_EVENTS
+ *      changes can be pending.
+ * 
+ *      A queued change carries only the words (PARAMS_WORD bytes) changed
+ *      since the previous publish(), the sets published meanwhile keep
+ *      these words at their old values: a scheduled value is never applied
+ *      early. An immediate change is applied at the next block while other
+ *      changes are pending, unless it changes a word of a pending one: it
+ *      is then queued behind it, due at once, so the changes of a field
+ *      keep their order. With a full queue such a change is held, it goes
+ *      out with the first publish() finding room.
+ * 
+ * @tparam T plain struct, copied as a whole
+ */
+template<class T>
+class AudioParams
+{
+    static_assert(std::is_trivially_copyable<T>::value, "AudioParams: T is copied bytewise");
+public:
+    AudioParams() : mid(1), back(2), front(0), head(0), tail(0), clock(0) {}
+    /**
+     * @brief Writer side copy, holds the last written values of all fields
+     */
+    T &edit() { return shadow;}
+    const T &get() const { return shadow;}
+    /**
+     * @brief Makes the edited set visible to the audio side
+     */
+    void publish()
+    {
+        uint32_t h = head.load(std::memory_order_acquire);
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        mask_t m = {}, p = {};
+        bool queued = stamped, late = false;
+        uint32_t i;
+
+        for (i = h; i != t; i++) merge(p, queue[i & (PARAMS_EVENTS - 1)].mask);     // not applied yet
+        for (i = 0; i < PARAMS_WORDS; i++)
+        {
+            if (memcmp(wordPtr(shadow, i), wordPtr(last, i), wordLen(i))) mark(m, i);
+            if (has(held, i) && has(p, i)) late = true;
+        }
+        if (!late || stamped)                   // the held change goes out with this one
+        {
+            merge(m, held);
+            held = mask_t{};
+        }
+        else if (t - h < PARAMS_EVENTS)         // queued on its own, this one may be immediate
+        {
+            push(t++, time(), held);
+            merge(p, held);
+            held = mask_t{};
+        }
+        for (i = 0; i < PARAMS_WORDS; i++)
+        {
+            if (has(m, i) && has(p, i)) queued = true;  // keeps the order of the changes of a field
+        }
+        if (queued && t - h >= PARAMS_EVENTS)   // immediate change of a pending word, no room
+        {
+            merge(held, m);
+            last = shadow;
+            return;
+        }
+        for (i = 0; i < PARAMS_WORDS; i++)      // the immediate set, pending and held words keep their old values
+        {
+            if (!has(p, i) && !has(held, i)) memcpy(wordPtr(now, i), wordPtr(queued ? last : shadow, i), wordLen(i));
+        }
+        last = shadow;
+        if (queued)
+        {
+            push(t, stamped ? stamp : time(), m);
+            stamped = false;
+            return;
+        }
+        buf[back].set = now;
+        buf[back].head = h;
+        buf[back].pending = p;
+        back = mid.exchange(back | PARAMS_FRESH, std::memory_order_acq_rel) & PARAMS_IDX;
+    }
+    /**
+     * @brief The next publish() takes effect at sample t of time()
+     *      A time in the past is applied at the start of the next block.
+     * 
+     * @return false if the queue is full, the next publish() is immediate
+     *      (or held, see above)
+     */
+    bool at(uint32_t t)
+    {
+        if (tail.load(std::memory_order_relaxed) - head.load(std::memory_order_acquire) >= PARAMS_EVENTS) return false;
+        stamp = t;
+        stamped = true;
+        return true;
+    }
+    /**
+     * @brief Audio side clock, the next sample to be processed
+     */
+    uint32_t time() const { return clock.load(std::memory_order_relaxed);}
+    /**
+     * @brief Audio side: samples up to the next scheduled set, n at most
+     *      Does not advance the clock, for the block level shortcuts 
+     *      (bypass) taken before the processing core is called.
+     */
+    uint32_t due(uint32_t n) const
+    {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return n;
+        int32_t d = (int32_t)(queue[h & (PARAMS_EVENTS - 1)].when - time());
+        if (d <= 0) return 0;
+        return min((uint32_t)d, n);
+    }
+    /**
+     * @brief Audio side: copies the newest published set to dst
+     *      The words of the scheduled changes pending when it was
+     *      published or applied after that are kept.
+     * 
+     * @return true if there was a new set, dst unchanged otherwise
+     */
+    bool fetch(T &dst)
+    {
+        if (!(mid.load(std::memory_order_acquire) & PARAMS_FRESH)) return false;
+        front = mid.exchange(front, std::memory_order_acq_rel) & PARAMS_IDX;
+        const slot_t &b = buf[front];
+        uint32_t h = head.load(std::memory_order_relaxed);
+        mask_t keep = b.pending;
+        for (uint32_t i = b.head; i != h; i++) merge(keep, applied[i & (2 * PARAMS_EVENTS - 1)]);
+        for (uint32_t i = 0; i < PARAMS_WORDS; i++)
+        {
+            if (!has(keep, i)) memcpy(wordPtr(dst, i), wordPtr(b.set, i), wordLen(i));
+        }
+        return true;
+    }
+    /**
+     * @brief Audio side, sample accurate: copies the newest published set
+     *      and the scheduled changes due now to dst, then advances the clock 
+     *      up to the next scheduled change
+     * 
+     * @param dst   parameters for the returned number of samples
+     * @param n     samples left in the block
+     * @param fresh optional, set to true if dst was changed
+     * @return      samples to process with dst, 1..n (n > 0)
+     */
+    uint32_t fetch(T &dst, uint32_t n, bool *fresh = NULL)
+    {
+        uint32_t c = clock.load(std::memory_order_relaxed);
+        bool f = fetch(dst);
+        uint32_t h = head.load(std::memory_order_relaxed);
+        uint32_t t = tail.load(std::memory_order_acquire);     // once: bounds the applied[] range of a set
+        while (h != t)
+        {
+            const event_t &e = queue[h & (PARAMS_EVENTS - 1)];
+            int32_t d = (int32_t)(e.when - c);      // wraps after 13h at 44.1kHz
+            if (d > 0)
+            {
+                if ((uint32_t)d < n) n = d;
+                break;
+            }
+            for (uint32_t i = 0; i < PARAMS_WORDS; i++)
+            {
+                if (has(e.mask, i)) memcpy(wordPtr(dst, i), wordPtr(e.set, i), wordLen(i));
+            }
+            applied[h & (2 * PARAMS_EVENTS - 1)] = e.mask;
+            f = true;
+            head.store(++h, std::memory_order_release);
+        }
+        clock.store(c + n, std::memory_order_relaxed);
+        if (fresh) *fresh = f;
+        return n;
+    }
+    /**
+     * @brief Audio side: advances the clock by n samples without any
+     *      processing, for a stage skipped by its caller (a bypassed 
+     *      AudioEffectChain_F32 stage). The changes falling due meanwhile
+     *      are applied by the next fetch(dst, n), at its first sample.
+     */
+    void advance(uint32_t n) { clock.store(clock.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);}
+private:
+    enum {PARAMS_IDX = 0x03, PARAMS_FRESH = 0x04};
+    static const uint32_t PARAMS_WORDS = (sizeof(T) + PARAMS_WORD - 1) / PARAMS_WORD;
+    typedef struct
+    {
+        uint32_t bits[(PARAMS_WORDS + 31) / 32];    // changed words
+    } mask_t;
+    typedef struct
+    {
+        uint32_t when;
+        T set;
+        mask_t mask;
+    } event_t;
+    typedef struct
+    {
+        T set;
+        uint32_t head;              // events applied before the set was published
+        mask_t pending;             // words of the events not applied then
+    } slot_t;
+    void push(uint32_t t, uint32_t when, const mask_t &m)
+    {
+        event_t &e = queue[t & (PARAMS_EVENTS - 1)];
+        e.when = when;
+        e.set = shadow;
+        e.mask = m;
+        tail.store(t + 1, std::memory_order_release);
+    }
+    static void mark(mask_t &m, uint32_t i) { m.bits[i >> 5] |= 1u << (i & 31);}
+    static bool has(const mask_t &m, uint32_t i) { return m.bits[i >> 5] & (1u << (i & 31));}
+    static void merge(mask_t &m, const mask_t &a)
+    {
+        for (uint32_t i = 0; i < sizeof(m.bits) / sizeof(m.bits[0]); i++) m.bits[i] |= a.bits[i];
+    }
+    static uint8_t *wordPtr(T &s, uint32_t i) { return (uint8_t *)&s + i * PARAMS_WORD;}
+    static const uint8_t *wordPtr(const T &s, uint32_t i) { return (const uint8_t *)&s + i * PARAMS_WORD;}
+    static uint32_t wordLen(uint32_t i) { return min((uint32_t)PARAMS_WORD, (uint32_t)(sizeof(T) - i * PARAMS_WORD));}
+    T shadow{};                     // edited set, future values included
+    T last{};                       // shadow at the previous publish()
+    T now{};                        // immediate set, pending words at their old values
+    mask_t held{};                  // words of a change refused by a full queue
+    slot_t buf[3]{};
+    std::atomic<uint32_t> mid;      // buffer between the sides, PARAMS_FRESH = not fetched yet
+    uint32_t back;                  // writer's buffer
+    uint32_t front;                 // reader's buffer
+    event_t queue[PARAMS_EVENTS]{};
+    mask_t applied[2 * PARAMS_EVENTS]{};    // masks of the applied events, audio side
+    std::atomic<uint32_t> head;     // next event to apply, written by the audio side
+    std::atomic<uint32_t> tail;     // next free event, written by the setters
+    std::atomic<uint32_t> clock;    // samples processed, written by the audio side
+    uint32_t stamp;
+    bool stamped = false;
+};
+
+#endif // _UTILITY_PARAMS_H
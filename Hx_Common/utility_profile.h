@@ -0,0 +1,249 @@
+/*  Per stage cycle profiler for the effect update() functions
+ *
+ *  Author: Piotr Zapart
+ *          www.hexefx.com
+ *
+ * Copyright (c) 2021 by Piotr Zapart
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _UTILITY_PROFILE_H
+#define _UTILITY_PROFILE_H
+
+#include <Arduino.h>
+#include <atomic>
+
+/**
+ * Uncomment to compile the profiler into the effects. Disabled, the
+ * AUDIO_PROFILE_xxx macros expand to nothing and the effects have no
+ * profile member. The host build sets it with make PROFILE=1.
+ */
+//#define AUDIO_PROFILE
+
+#define AUDIO_PROFILE_MAX_STAGES    6
+
+#if defined(AUDIO_PROFILE)
+
+#if defined(__ARM_ARCH_7EM__)
+#define AUDIO_PROFILE_NOW()     (ARM_DWT_CYCCNT)        // core clock cycles
+#elif defined(HX_HOST_BUILD)
+#include "hx_timer.h"
+#define AUDIO_PROFILE_NOW()     ((uint32_t)hx_ticks())  // TSC ticks or ns, see hx_timer.h
+#else
+#error "AUDIO_PROFILE: no cycle counter on this target"
+#endif
+
+/**
+ * @brief Splits the update() time into named stages. The update() calls
+ *      start() once, lap(stage) at the end of each stage and commit() at
+ *      the end. The laps of a stage add up over the block: an effect with
+ *      interleaved stages runs them as passes over a part of the block
+ *      (ie. the reverb, 128 samples), a lap per sample would cost more 
+ *      than the stages it measures.
+ *      The table keeps the min/mean/max cycles per block of each stage.
+ *      Blocks returned early (bypass, missing input) are not counted.
+ *      Each lap costs a counter read: 1-2 cycles on the Cortex-M7, ~35 on
+ *      a x86 host. init() measures the cost of one lap, commit() subtracts
+ *      it for every lap of a stage. The total update() time measured 
+ *      outside (processorUsage(), hx_bench cyc/block) still includes them.
+ *      commit() runs in the audio interrupt, the getters in the main loop:
+ *      the getters retry while a commit() is in progress (sequence
+ *      counter), reset() is a request carried out by the next commit().
+ *      The interrupts are never disabled.
+ */
+class AudioProfile
+{
+public:
+    AudioProfile()
+    {
+        stageNames = NULL;
+        numStages = 0;
+        memset(acc, 0, sizeof(acc));
+        memset(laps, 0, sizeof(laps));
+        lapCost16 = 0;
+        clear();
+    }
+    /**
+     * @brief Sets the stage names, called by the effect constructor
+     */
+    void init(const char *const *names, uint8_t count)
+    {
+        stageNames = names;
+        numStages = count > AUDIO_PROFILE_MAX_STAGES ? AUDIO_PROFILE_MAX_STAGES : count;
+#if defined(__ARM_ARCH_7EM__)
+        ARM_DEMCR |= ARM_DEMCR_TRCENA;                  // the Teensy startup code enables it too
+        ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+#endif
+        calibrate();
+    }
+    inline void start()
+    {
+        for (uint8_t s = 0; s < numStages; s++)
+        {
+            acc[s] = 0;
+            laps[s] = 0;
+        }
+        t0 = AUDIO_PROFILE_NOW();
+    }
+    inline void lap(uint8_t stage)
+    {
+        uint32_t t = AUDIO_PROFILE_NOW();
+        acc[stage] += t - t0;
+        laps[stage]++;
+        t0 = t;
+    }
+    /**
+     * @brief Cost of one lap in 1/16 cycles, see calibrate()
+     */
+    uint32_t lapCost() const { return lapCost16;}
+    void commit()
+    {
+        uint32_t q = seq.load(std::memory_order_relaxed);
+        seq.store(q + 1, std::memory_order_relaxed);       // odd: stats being written
+        std::atomic_thread_fence(std::memory_order_release);
+        if (resetReq.exchange(false, std::memory_order_acquire)) clear();
+        for (uint8_t s = 0; s < numStages; s++)
+        {
+            uint32_t cost = (laps[s] * lapCost16) >> 4;
+            acc[s] = acc[s] > cost ? acc[s] - cost : 0;
+            if (acc[s] < cycMin[s]) cycMin[s] = acc[s];
+            if (acc[s] > cycMax[s]) cycMax[s] = acc[s];
+            cycSum[s] += acc[s];
+        }
+        blockCount++;
+        seq.store(q + 2, std::memory_order_release);
+    }
+    /**
+     * @brief Restarts the statistics with the next committed block, until
+     *      then the getters report no blocks
+     */
+    void reset() { resetReq.store(true, std::memory_order_release);}
+    uint8_t stages() const { return numStages;}
+    const char *name(uint8_t s) const { return s < numStages ? stageNames[s] : "";}
+    uint32_t blocks() const
+    {
+        stats_t st;
+        snapshot(0, st);
+        return st.n;
+    }
+    uint32_t cyclesMin(uint8_t s) const
+    {
+        stats_t st;
+        snapshot(s, st);
+        return st.n ? st.min : 0;
+    }
+    uint32_t cyclesMax(uint8_t s) const
+    {
+        stats_t st;
+        snapshot(s, st);
+        return st.n ? st.max : 0;
+    }
+    /**
+     * @brief Mean cycles per block of a stage
+     */
+    float cyclesMean(uint8_t s) const
+    {
+        stats_t st;
+        snapshot(s, st);
+        return st.n ? (float)st.sum / st.n : 0.0f;
+    }
+private:
+    typedef struct
+    {
+        uint32_t min, max;
+        uint64_t sum;
+        uint32_t n;
+    } stats_t;
+    /**
+     * @brief Consistent copy of one stage, read again if a commit() 
+     *      interrupted the copy
+     */
+    void snapshot(uint8_t s, stats_t &st) const
+    {
+        uint32_t q;
+        if (s >= AUDIO_PROFILE_MAX_STAGES) s = 0;
+        do
+        {
+            q = seq.load(std::memory_order_acquire);
+            st.min = cycMin[s];
+            st.max = cycMax[s];
+            st.sum = cycSum[s];
+            st.n = blockCount;
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while ((q & 1) || q != seq.load(std::memory_order_relaxed));
+        if (resetReq.load(std::memory_order_acquire)) st.n = 0;
+    }
+    /**
+     * @brief Measures the cost of one lap(): the fastest of 8 runs of 
+     *      32 laps back to back
+     */
+    void calibrate()
+    {
+        uint32_t best = UINT32_MAX;
+        lapCost16 = 0;
+        for (int r = 0; r < 8; r++)
+        {
+            start();
+            for (int k = 0; k < 32; k++) lap(0);
+            if (acc[0] < best) best = acc[0];
+        }
+        lapCost16 = best / 2;       // 16 * best / 32
+        acc[0] = 0;
+        laps[0] = 0;
+    }
+    void clear()
+    {
+        for (uint8_t s = 0; s < AUDIO_PROFILE_MAX_STAGES; s++)
+        {
+            cycMin[s] = UINT32_MAX;
+            cycMax[s] = 0;
+            cycSum[s] = 0;
+        }
+        blockCount = 0;
+    }
+    const char *const *stageNames;
+    uint8_t numStages;
+    uint32_t t0;
+    uint32_t acc[AUDIO_PROFILE_MAX_STAGES];     // current block
+    uint32_t laps[AUDIO_PROFILE_MAX_STAGES];    // lap() calls in the current block
+    uint32_t lapCost16;                         // cycles per lap * 16
+    uint32_t cycMin[AUDIO_PROFILE_MAX_STAGES];
+    uint32_t cycMax[AUDIO_PROFILE_MAX_STAGES];
+    uint64_t cycSum[AUDIO_PROFILE_MAX_STAGES];
+    uint32_t blockCount;
+    std::atomic<uint32_t> seq{0};           // odd while commit() writes the stats
+    std::atomic<bool> resetReq{false};
+};
+
+#define AUDIO_PROFILE_INIT(p, names, n)     (p).init((names), (n))
+#define AUDIO_PROFILE_START(p)              (p).start()
+#define AUDIO_PROFILE_LAP(p, stage)         (p).lap(stage)
+#define AUDIO_PROFILE_COMMIT(p)             (p).commit()
+
+#else
+
+#define AUDIO_PROFILE_INIT(p, names, n)
+#define AUDIO_PROFILE_START(p)
+#define AUDIO_PROFILE_LAP(p, stage)
+#define AUDIO_PROFILE_COMMIT(p)
+
+#endif // AUDIO_PROFILE
+
+#endif // _UTILITY_PROFILE_H
@@ -0,0 +1,129 @@
+/*  Linear parameter ramps
+ *
+ *  Author: Piotr Zapart
+ *          www.hexefx.com
+ *
+ * Copyright (c) 2021 by Piotr Zapart
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _UTILITY_RAMP_H
+#define _UTILITY_RAMP_H
+
+#include "arm_math.h"
+
+#ifndef AUDIO_RAMP_LEN
+#define AUDIO_RAMP_LEN  AUDIO_BLOCK_SAMPLES     // samples from one value to the next
+#endif
+
+/**
+ * @brief Linear ramp of one parameter, against the zipper noise of a
+ *      value jumping at the block boundary. A new value starts a ramp
+ *      of AUDIO_RAMP_LEN samples from the current one, whatever the
+ *      size of the processed blocks: the remaining steps are carried
+ *      over to the next blocks or segments. 
+ *      span() tells how many of the next n samples share one step,
+ *      the processing core splits the block there. begin() is called 
+ *      with up to span() samples and the value, the inner loop adds the
+ *      step after each sample and end() moves the value to the end of
+ *      the samples, exactly on the target at the end of the ramp.
+ *      A stable value costs nothing: begin() returns false and the
+ *      loop runs the unramped code with value.
+ * 
+ *      for (i=0; i < n; i += len)
+ *      {
+ *          len = ramp.span(t, n - i);
+ *          if (ramp.begin(t, len)) ramped loop with ramp.value, ramp.step
+ *          else                    loop with ramp.value
+ *          ramp.end();
+ *      }
+ * 
+ *      Audio side only, the setters publish the target (utility_params.h).
+ */
+class AudioRamp
+{
+public:
+    AudioRamp() : value(0.0f), step(0.0f), target(0.0f), left(0), len(0), primed(false) {}
+    /**
+     * @brief Jumps to v without a ramp (reset, model change)
+     */
+    void set(float32_t v) { value = target = v; step = 0.0f; left = len = 0; primed = true;}
+    /**
+     * @brief Samples of the next n with one step: up to the end of the
+     *      running ramp or of the ramp a new target t would start
+     */
+    uint32_t span(float32_t t, uint32_t n) const
+    {
+        uint32_t s = left;
+        if (primed && t != target && t != value) s = AUDIO_RAMP_LEN;
+        return (s && s < n) ? s : n;
+    }
+    /**
+     * @brief Start of n samples, n <= span(t, n). A new target t starts
+     *      a ramp from value, the first call after the construction 
+     *      jumps to t, the initial settings are not ramped.
+     * 
+     * @return true if the value moves in these samples
+     */
+    bool begin(float32_t t, uint32_t n)
+    {
+        if (!primed || (t != target && t == value))
+        {
+            set(t);
+            return false;
+        }
+        if (t != target)
+        {
+            target = t;
+            left = AUDIO_RAMP_LEN;
+            step = (t - value) / (float32_t)AUDIO_RAMP_LEN;
+        }
+        if (!left) return false;
+        if (n > left)               // n beyond span(): the rest of the ramp is stretched over n
+        {
+            step = (target - value) / (float32_t)n;
+            left = n;
+        }
+        len = n;
+        return true;
+    }
+    /**
+     * @brief End of the samples, value at the first sample of the next
+     *      ones. Lands exactly on the target at the end of the ramp,
+     *      without the rounding error accumulated by the steps.
+     */
+    void end()
+    {
+        if (!len) return;
+        left -= len;
+        value = left ? value + step * (float32_t)len : target;
+        if (!left) step = 0.0f;
+        len = 0;
+    }
+    float32_t value;        // at the first sample of begin()
+    float32_t step;         // added after each sample, 0 if not ramping
+private:
+    float32_t target;
+    uint32_t left;          // ramp samples not processed yet
+    uint32_t len;           // samples since begin()
+    bool primed;
+};
+
+#endif // _UTILITY_RAMP_H
@@ -0,0 +1,528 @@
+/*  hx_bench - per effect microbenchmark, times the update() of each effect
+ *  with a guitar like test signal and a running parameter sweep.
+ *
+ *  Author: Piotr Zapart
+ *          www.hexefx.com
+ *
+ * Copyright (c) 2021 by Piotr Zapart
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sched.h>
+#include <unistd.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include "hx_chain.h"
+#include "hx_timer.h"
+
+#define BENCH_SIGNAL_BLOCKS     512     // length of the looped test signal
+#define BENCH_SWEEP_EVERY       16      // blocks between two parameter changes
+#define BENCH_SWEEP_STEPS       32      // parameter changes per sweep period
+#define BENCH_NOISE_NS          0.05    // ns/sample, smaller differences are not a regression
+#define BENCH_TAIL_MAX          16      // seconds of silence in the tail mode
+
+typedef struct
+{
+    std::string name;
+    std::string spec;       // stages separated by spaces
+    uint8_t channels;       // stream width fed to the effect
+    const char *sweepKey;   // parameter of the first stage swept during the run, NULL = static
+    float sweepLo, sweepHi;
+    bool fused;             // stages in one AudioEffectChain_F32 node
+}hx_bench_case_t;
+
+typedef struct
+{
+    const char *name;
+    double cycMean, cycMin, cycMax;     // ticks per block
+}hx_bench_stage_t;
+
+typedef struct
+{
+    double cycBlock;        // mean ticks per block, all runs
+    double cycMin;          // fastest block
+    double cycMax;          // slowest block
+    double cv;              // stddev of the run means / mean, percent
+    double nsSample;
+    double realtime;        // audio time / processing time
+#if defined(AUDIO_PROFILE)
+    std::vector<hx_bench_stage_t> stages;   // update() breakdown of the first instance
+#endif
+}hx_bench_result_t;
+
+typedef struct
+{
+    const char *filter;
+    const char *jsonPath;
+    const char *csvPath;
+    const char *basePath;
+    float threshold;        // percent, regression limit for the baseline compare
+    unsigned int blocks;    // per run
+    unsigned int runs;
+    unsigned int warmup;
+    unsigned int tail;      // seconds of silence after the signal, 0 = regular benchmark
+    bool flush;             // flush-to-zero in HxChain::process()
+    bool list;
+}hx_bench_opts_t;
+
+static hx_bench_opts_t opt;
+static float signal[HX_CHAIN_MAX_CH][BENCH_SIGNAL_BLOCKS * AUDIO_BLOCK_SAMPLES];
+static float silence[AUDIO_BLOCK_SAMPLES];
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  -f TEXT   run only the cases containing TEXT\n"
+        "  -n N      blocks per run, default 2000\n"
+        "  -R N      runs per case, default 5\n"
+        "  -w N      warmup blocks, default 200\n"
+        "  -o FILE   write the results as JSON\n"
+        "  -c FILE   write the results as CSV\n"
+        "  -b FILE   compare with a JSON baseline, exit code 3 on a regression\n"
+        "  -t PCT    regression threshold in percent, default 5\n"
+        "  -T SEC    tail mode: 1s of signal followed by SEC (max %d) seconds of\n"
+        "            silence, ticks/block per second of the decaying tail\n"
+        "  -D        denormals on, no flush-to-zero, see utility_denormal.h\n"
+        "  -l        list the cases\n", name, BENCH_TAIL_MAX);
+}
+
+/**
+ * @brief Benchmark cases: every effect, model, quality, stage count and mode
+ */
+static void make_cases(std::vector<hx_bench_case_t> &cases)
+{
+    static const char *const models[] =
+        {"off", "bassman", "prince", "mesa", "vox", "jcm800", "twin", "hk", "jazz", "pignose"};
+    static const char *const quality[] = {"low", "mid", "high"};
+    static const char *const engine[] = {"allpass", "velvet", "hilbert"};
+    static const int phaserStages[] = {2, 4, 6, 8, 10, 12, 16, 24, 32, 40, 48};
+    char s[128];
+
+    for (const char *m : models)
+    {
+        snprintf(s, sizeof(s), "tonestack,model=%s", m);
+        cases.push_back({s, s, 2, "bass", 0.0f, 1.0f});
+    }
+    // hexaphonic tone stack, lane kernel vs the same 6 lanes on scalar filters
+    for (const char *m : {"bassman", "jcm800"})
+    {
+        snprintf(s, sizeof(s), "tonestack6,model=%s", m);
+        cases.push_back({s, s, 2, "bass", 0.0f, 1.0f});
+        snprintf(s, sizeof(s), "tonestack6s,model=%s", m);
+        cases.push_back({s, s, 2, "bass", 0.0f, 1.0f});
+    }
+    for (const char *e : engine)
+    {
+        for (const char *q : quality)
+        {
+            snprintf(s, sizeof(s), "mono2stereo,engine=%s,quality=%s", e, q);
+            cases.push_back({s, s, 1, "spread", 0.0f, 1.0f});
+        }
+    }
+    cases.push_back({"mono2stereo,bypass=1", "mono2stereo,bypass=1", 1, "spread", 0.0f, 1.0f});
+    for (int st : phaserStages)
+    {
+        snprintf(s, sizeof(s), "phaser,stages=%d,fb=0.5", st);
+        cases.push_back({s, s, 1, "rate", 0.1f, 4.0f});
+    }
+    for (int st = 2; st <= 12; st += 2)
+    {
+        snprintf(s, sizeof(s), "phaser_st,stages=%d,fb=0.5", st);
+        cases.push_back({s, s, 2, "rate", 0.1f, 4.0f});
+    }
+    for (int st = 2; st <= 12; st += 2)
+    {
+        snprintf(s, sizeof(s), "phaser_f32,stages=%d,fb=0.5", st);
+        cases.push_back({s, s, 1, "rate", 0.1f, 4.0f});
+    }
+    for (int st = 2; st <= 6; st += 2)
+    {
+        snprintf(s, sizeof(s), "infphaser,stages=%d,fb=0.5", st);
+        cases.push_back({s, s, 1, "rate", -1.0f, 1.0f});
+    }
+    cases.push_back({"phaser,bypass=1", "phaser,bypass=1", 1, "rate", 0.1f, 4.0f});
+    cases.push_back({"phaser_f32,bypass=1", "phaser_f32,bypass=1", 1, "rate", 0.1f, 4.0f});
+    cases.push_back({"reverb", "reverb", 2, "size", 0.2f, 1.0f});
+    cases.push_back({"reverb,bypass=1", "reverb,bypass=1", 2, "size", 0.2f, 1.0f});
+    for (int b = 0; b < 2; b++)
+    {
+        for (int f = 0; f < 2; f++)
+        {
+            snprintf(s, sizeof(s), "reverb_f32,freeze=%d,bypass=%d", f, b);
+            // size is overridden while frozen, sweep the output filter instead
+            cases.push_back({s, s, 2, f ? "lowpass" : "size", 0.2f, 1.0f});
+        }
+    }
+    // typical guitar patch, one node per effect vs the fused chain
+    const char *patch = "tonestack,model=jcm800 phaser_f32,stages=8,fb=0.5 mono2stereo reverb_f32";
+    cases.push_back({"patch", patch, 1, "bass", 0.0f, 1.0f, false});
+    cases.push_back({"patch,fused", patch, 1, "bass", 0.0f, 1.0f, true});
+}
+
+/**
+ * @brief Plucked notes with decaying harmonics over a low noise floor,
+ *      the right channel is a slightly detuned double.
+ */
+static void make_signal(void)
+{
+    static const float notes[] = {82.41f, 110.0f, 146.83f, 196.0f, 246.94f, 329.63f, 164.81f, 123.47f};
+    const size_t len = BENCH_SIGNAL_BLOCKS * AUDIO_BLOCK_SAMPLES;
+    const size_t noteLen = (size_t)(0.4f * AUDIO_SAMPLE_RATE_EXACT);
+    uint32_t rnd = 22222;
+
+    for (uint8_t c = 0; c < HX_CHAIN_MAX_CH; c++)
+    {
+        for (size_t i = 0; i < len; i++)
+        {
+            size_t n = i / noteLen;
+            float t = (float)(i - n * noteLen) / AUDIO_SAMPLE_RATE_EXACT;
+            float f0 = notes[n % (sizeof(notes) / sizeof(notes[0]))] * (c ? 1.003f : 1.0f);
+            float y = 0.0f;
+            for (int h = 1; h <= 6; h++)
+            {
+                y += expf(-t * (3.0f + 2.0f * h)) * sinf(2.0f * (float)M_PI * f0 * h * t) / h;
+            }
+            rnd = rnd * 1103515245u + 12345u;
+            signal[c][i] = 0.45f * y + 1e-3f * ((int32_t)rnd * (1.0f / 2147483648.0f));
+        }
+    }
+}
+
+static bool run_case(const hx_bench_case_t &bc, hx_bench_result_t &r, std::string &err)
+{
+    HxChain chain;
+    float outBuf[HX_CHAIN_MAX_CH][AUDIO_BLOCK_SAMPLES];
+    float *outPtr[HX_CHAIN_MAX_CH] = {outBuf[0], outBuf[1]};
+    const float *inPtr[HX_CHAIN_MAX_CH];
+    std::vector<double> runMean;
+    unsigned int blk = 0, total = opt.warmup + opt.runs * opt.blocks;
+    double sum = 0.0;
+    char val[32];
+
+    size_t beg = 0, end;
+    do
+    {
+        end = bc.spec.find(' ', beg);
+        chain.add(bc.spec.substr(beg, end - beg).c_str());
+        beg = end + 1;
+    } while (end != std::string::npos);
+    if (!chain.build(bc.channels, bc.fused))
+    {
+        err = chain.error();
+        return false;
+    }
+    chain.flushToZero(opt.flush);
+    r.cycMin = 1e30;
+    r.cycMax = 0.0;
+    for (blk = 0; blk < total; blk++)
+    {
+        size_t pos = (blk % BENCH_SIGNAL_BLOCKS) * AUDIO_BLOCK_SAMPLES;
+        for (uint8_t c = 0; c < HX_CHAIN_MAX_CH; c++) inPtr[c] = &signal[c][pos];
+        if (bc.sweepKey && blk % BENCH_SWEEP_EVERY == 0)   // triangle sweep, not timed
+        {
+            unsigned int step = (blk / BENCH_SWEEP_EVERY) % (2 * BENCH_SWEEP_STEPS);
+            float x = (step < BENCH_SWEEP_STEPS ? step : 2 * BENCH_SWEEP_STEPS - step) / (float)BENCH_SWEEP_STEPS;
+            snprintf(val, sizeof(val), "%.4f", bc.sweepLo + x * (bc.sweepHi - bc.sweepLo));
+            chain.set(0, bc.sweepKey, val);
+        }
+#if defined(AUDIO_PROFILE)
+        if (blk == opt.warmup) chain.profileReset();
+#endif
+        chain.process(inPtr, outPtr);
+        if (blk < opt.warmup) continue;
+
+        double cyc = chain.cycles();
+        sum += cyc;
+        r.cycMin = std::min(r.cycMin, cyc);
+        r.cycMax = std::max(r.cycMax, cyc);
+        if ((blk - opt.warmup + 1) % opt.blocks == 0)
+        {
+            runMean.push_back(sum / opt.blocks);
+            sum = 0.0;
+        }
+    }
+    double mean = 0.0, var = 0.0;
+    for (double m : runMean) mean += m;
+    mean /= runMean.size();
+    for (double m : runMean) var += (m - mean) * (m - mean);
+    var = runMean.size() > 1 ? var / (runMean.size() - 1) : 0.0;
+
+    const double blockNs = AUDIO_BLOCK_SAMPLES * 1e9 / AUDIO_SAMPLE_RATE_EXACT;
+    double nsBlock = mean / hx_ticks_per_ns();
+    r.cycBlock = mean;
+    r.cv = mean > 0.0 ? 100.0 * sqrt(var) / mean : 0.0;
+    r.nsSample = nsBlock / AUDIO_BLOCK_SAMPLES;
+    r.realtime = nsBlock > 0.0 ? blockNs / nsBlock : 0.0;
+#if defined(AUDIO_PROFILE)
+    const AudioProfile *p = chain.profile(0);
+    r.stages.clear();
+    for (uint8_t st = 0; p && p->blocks() && st < p->stages(); st++)     // bypassed: no blocks
+        r.stages.push_back({p->name(st), p->cyclesMean(st), (double)p->cyclesMin(st), (double)p->cyclesMax(st)});
+#endif
+    return true;
+}
+
+/**
+ * @brief Tail mode: the CPU load has to stay flat while the output decays
+ *      to silence, a rising load means denormal states.
+ *
+ * @param tail  ticks per block: [0] the last second of the signal,
+ *              [1..opt.tail] each second of the silence
+ */
+static bool run_tail(const hx_bench_case_t &bc, std::vector<double> &tail, std::string &err)
+{
+    HxChain chain;
+    float outBuf[HX_CHAIN_MAX_CH][AUDIO_BLOCK_SAMPLES];
+    float *outPtr[HX_CHAIN_MAX_CH] = {outBuf[0], outBuf[1]};
+    const float *inPtr[HX_CHAIN_MAX_CH];
+    const unsigned int perSec = (unsigned int)(AUDIO_SAMPLE_RATE_EXACT / AUDIO_BLOCK_SAMPLES);
+    unsigned int blk, total = (opt.tail + 1) * perSec;
+    double sum = 0.0;
+
+    size_t beg = 0, end;
+    do
+    {
+        end = bc.spec.find(' ', beg);
+        chain.add(bc.spec.substr(beg, end - beg).c_str());
+        beg = end + 1;
+    } while (end != std::string::npos);
+    if (!chain.build(bc.channels, bc.fused))
+    {
+        err = chain.error();
+        return false;
+    }
+    chain.flushToZero(opt.flush);
+    tail.clear();
+    for (blk = 0; blk < total; blk++)
+    {
+        size_t pos = (blk % BENCH_SIGNAL_BLOCKS) * AUDIO_BLOCK_SAMPLES;
+        for (uint8_t c = 0; c < HX_CHAIN_MAX_CH; c++) inPtr[c] = blk < perSec ? &signal[c][pos] : silence;
+        chain.process(inPtr, outPtr);
+        sum += chain.cycles();
+        if ((blk + 1) % perSec == 0)
+        {
+            tail.push_back(sum / perSec);
+            sum = 0.0;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Reads the ns/sample of each case from a JSON file written by -o,
+ *      one case object per line.
+ */
+static bool read_baseline(const char *path, std::map<std::string, double> &base)
+{
+    FILE *f = fopen(path, "r");
+    char line[512], name[256];
+    double ns;
+    if (!f) return false;
+    while (fgets(line, sizeof(line), f))
+    {
+        const char *p = strstr(line, "\"name\": \"");
+        const char *q = strstr(line, "\"ns_sample\": ");
+        if (!p || !q) continue;
+        if (sscanf(p + 9, "%255[^\"]", name) == 1 && sscanf(q + 13, "%lf", &ns) == 1) base[name] = ns;
+    }
+    fclose(f);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<hx_bench_case_t> cases;
+    std::vector<std::pair<const hx_bench_case_t *, hx_bench_result_t>> results;
+    std::map<std::string, double> base;
+    FILE *json = NULL, *csv = NULL;
+    int c, regressions = 0;
+    cpu_set_t cpus;
+
+    opt.filter = NULL;
+    opt.jsonPath = NULL;
+    opt.csvPath = NULL;
+    opt.basePath = NULL;
+    opt.threshold = 5.0f;
+    opt.blocks = 2000;
+    opt.runs = 5;
+    opt.warmup = 200;
+    opt.tail = 0;
+    opt.flush = true;
+    opt.list = false;
+
+    while ((c = getopt(argc, argv, "f:n:R:w:o:c:b:t:T:Dlh")) != -1)
+    {
+        switch (c)
+        {
+            case 'f': opt.filter = optarg; break;
+            case 'n': opt.blocks = atoi(optarg); break;
+            case 'R': opt.runs = atoi(optarg); break;
+            case 'w': opt.warmup = atoi(optarg); break;
+            case 'o': opt.jsonPath = optarg; break;
+            case 'c': opt.csvPath = optarg; break;
+            case 'b': opt.basePath = optarg; break;
+            case 't': opt.threshold = atof(optarg); break;
+            case 'T': opt.tail = std::max(atoi(optarg), 0); break;
+            case 'D': opt.flush = false; break;
+            case 'l': opt.list = true; break;
+            default:
+                usage(argv[0]);
+                return c == 'h' ? 0 : 1;
+        }
+    }
+    if (opt.blocks < 1) opt.blocks = 1;
+    if (opt.runs < 1) opt.runs = 1;
+    if (opt.tail > BENCH_TAIL_MAX) opt.tail = BENCH_TAIL_MAX;
+
+    make_cases(cases);
+    if (opt.list)
+    {
+        for (const hx_bench_case_t &bc : cases) printf("%s\n", bc.name.c_str());
+        return 0;
+    }
+    if (opt.basePath && !read_baseline(opt.basePath, base))
+    {
+        fprintf(stderr, "%s: cannot open the baseline\n", opt.basePath);
+        return 1;
+    }
+    if (opt.jsonPath && !(json = fopen(opt.jsonPath, "w")))
+    {
+        fprintf(stderr, "%s: cannot create\n", opt.jsonPath);
+        return 1;
+    }
+    if (opt.csvPath && !(csv = fopen(opt.csvPath, "w")))
+    {
+        fprintf(stderr, "%s: cannot create\n", opt.csvPath);
+        return 1;
+    }
+    // stay on one core, the TSC and the caches of a migrated thread are not comparable
+    CPU_ZERO(&cpus);
+    CPU_SET(sched_getcpu(), &cpus);
+    sched_setaffinity(0, sizeof(cpus), &cpus);
+    make_signal();
+
+    if (opt.tail)
+    {
+        printf("fs=%.2fHz block=%d, %s, ticks/block: last second of the signal, each second of the tail\n",
+               AUDIO_SAMPLE_RATE_EXACT, AUDIO_BLOCK_SAMPLES, opt.flush ? "flush-to-zero" : "denormals on");
+        printf("%-40s %9s", "case", "signal");
+        for (unsigned int s = 1; s <= opt.tail; s++) printf(" %8us", s);
+        printf(" %7s\n", "max/sig");
+        for (const hx_bench_case_t &bc : cases)
+        {
+            std::vector<double> tail;
+            std::string err;
+            if (opt.filter && !strstr(bc.name.c_str(), opt.filter)) continue;     // no sweep, static parameters
+            if (!run_tail(bc, tail, err))
+            {
+                fprintf(stderr, "%s: %s\n", bc.name.c_str(), err.c_str());
+                return 1;
+            }
+            double peak = *std::max_element(tail.begin() + 1, tail.end());
+            printf("%-40s %9.0f", bc.name.c_str(), tail[0]);
+            for (unsigned int s = 1; s <= opt.tail; s++) printf(" %9.0f", tail[s]);
+            printf(" %7.2f\n", tail[0] > 0.0 ? peak / tail[0] : 0.0);
+        }
+        return 0;
+    }
+    printf("fs=%.2fHz block=%d, %.3f ticks/ns, %u runs x %u blocks\n",
+           AUDIO_SAMPLE_RATE_EXACT, AUDIO_BLOCK_SAMPLES, hx_ticks_per_ns(), opt.runs, opt.blocks);
+    printf("%-40s %11s %9s %9s %7s %9s %9s\n", "case", "cyc/block", "min", "max", "cv%", "ns/smp", "xRT");
+    for (const hx_bench_case_t &bc : cases)
+    {
+        hx_bench_result_t r;
+        std::string err;
+        if (opt.filter && !strstr(bc.name.c_str(), opt.filter)) continue;
+        if (!run_case(bc, r, err))
+        {
+            fprintf(stderr, "%s: %s\n", bc.name.c_str(), err.c_str());
+            return 1;
+        }
+        results.push_back({&bc, r});
+        printf("%-40s %11.0f %9.0f %9.0f %7.2f %9.3f %9.1f", bc.name.c_str(),
+               r.cycBlock, r.cycMin, r.cycMax, r.cv, r.nsSample, r.realtime);
+        auto b = base.find(bc.name);
+        if (b != base.end() && b->second > 0.0)
+        {
+            double d = 100.0 * (r.nsSample - b->second) / b->second;
+            bool slow = d > opt.threshold && r.nsSample - b->second > BENCH_NOISE_NS;
+            printf("  %+6.1f%%%s", d, slow ? "  REGRESSION" : "");
+            regressions += slow;
+        }
+        printf("\n");
+#if defined(AUDIO_PROFILE)
+        for (const hx_bench_stage_t &s : r.stages)
+        {
+            printf("  %-38s %11.0f %9.0f %9.0f %6.1f%%\n", s.name, s.cycMean, s.cycMin, s.cycMax,
+                   r.cycBlock > 0.0 ? 100.0 * s.cycMean / r.cycBlock : 0.0);
+        }
+#endif
+        fflush(stdout);
+    }
+
+    if (json)
+    {
+        fprintf(json, "{\n  \"fs\": %.4f,\n  \"block\": %d,\n  \"ticks_per_ns\": %.4f,\n  \"runs\": %u,\n  \"blocks\": %u,\n  \"cases\": [\n",
+                AUDIO_SAMPLE_RATE_EXACT, AUDIO_BLOCK_SAMPLES, hx_ticks_per_ns(), opt.runs, opt.blocks);
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const hx_bench_result_t &r = results[i].second;
+            fprintf(json, "    {\"name\": \"%s\", \"cycles_block\": %.1f, \"cycles_min\": %.0f, \"cycles_max\": %.0f, "
+                    "\"cv_pct\": %.3f, \"ns_sample\": %.4f, \"realtime\": %.2f",
+                    results[i].first->name.c_str(), r.cycBlock, r.cycMin, r.cycMax, r.cv, r.nsSample, r.realtime);
+#if defined(AUDIO_PROFILE)
+            fprintf(json, ", \"stages\": [");
+            for (size_t s = 0; s < r.stages.size(); s++)
+            {
+                fprintf(json, "%s{\"name\": \"%s\", \"mean\": %.1f, \"min\": %.0f, \"max\": %.0f}", s ? ", " : "",
+                        r.stages[s].name, r.stages[s].cycMean, r.stages[s].cycMin, r.stages[s].cycMax);
+            }
+            fprintf(json, "]");
+#endif
+            fprintf(json, "}%s\n", i + 1 < results.size() ? "," : "");
+        }
+        fprintf(json, "  ]\n}\n");
+        fclose(json);
+    }
+    if (csv)
+    {
+        fprintf(csv, "case,cycles_block,cycles_min,cycles_max,cv_pct,ns_sample,realtime\n");
+        for (auto &res : results)
+        {
+            const hx_bench_result_t &r = res.second;
+            fprintf(csv, "\"%s\",%.1f,%.0f,%.0f,%.3f,%.4f,%.2f\n", res.first->name.c_str(),
+                    r.cycBlock, r.cycMin, r.cycMax, r.cv, r.nsSample, r.realtime);
+        }
+        fclose(csv);
+    }
+    if (regressions)
+    {
+        printf("%d case(s) slower than the baseline by more than %.1f%%\n", regressions, opt.threshold);
+        return 3;
+    }
+    return 0;
+}
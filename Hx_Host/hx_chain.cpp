@@ -0,0 +1,796 @@
+/*  Effect chain builder for the host tools
+ *
+ *  Author: Piotr Zapart
+ *          www.hexefx.com
+ *
+ * Copyright (c) 2021 by Piotr Zapart
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "hx_chain.h"
+#include "effect_chain_F32.h"
+#include "filter_tonestackStereo_F32.h"
+#include "filter_tonestackMulti_F32.h"
+#include "effect_monoToStereo_F32.h"
+#include "effect_phaser.h"
+#include "effect_phaserStereo.h"
+#include "effect_phaser_F32.h"
+#include "effect_infphaser_F32.h"
+#include "effect_platervbstereo.h"
+#include "effect_platervbstereo_F32.h"
+#include "utility_denormal.h"
+
+void AudioHostSource_F32::update(void)
+{
+    audio_block_f32_t *b;
+    for (uint8_t c = 0; c < channels; c++)
+    {
+        b = allocate_f32();
+        if (!b) return;
+        memcpy(b->data, src[c], sizeof(b->data));
+        AudioStream_F32::transmit(b, c);
+        AudioStream_F32::release(b);
+    }
+}
+
+void AudioHostSink_F32::update(void)
+{
+    audio_block_f32_t *b;
+    for (uint8_t c = 0; c < channels; c++)
+    {
+        b = receiveReadOnly_f32(c);
+        if (b)
+        {
+            memcpy(dst[c], b->data, sizeof(b->data));
+            AudioStream_F32::release(b);
+        }
+        else memset(dst[c], 0, AUDIO_BLOCK_SAMPLES * sizeof(float));
+    }
+}
+
+void AudioHostLaneMix_F32::update(void)
+{
+    audio_block_f32_t *out[2], *b;
+    const float g = 2.0f / lanes;
+    out[0] = allocate_f32();
+    out[1] = allocate_f32();
+    if (!out[0] || !out[1])
+    {
+        if (out[0]) AudioStream_F32::release(out[0]);
+        if (out[1]) AudioStream_F32::release(out[1]);
+        return;
+    }
+    memset(out[0]->data, 0, sizeof(out[0]->data));
+    memset(out[1]->data, 0, sizeof(out[1]->data));
+    for (uint8_t l = 0; l < lanes; l++)
+    {
+        b = receiveReadOnly_f32(l);
+        if (!b) continue;
+        for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) out[l & 1]->data[i] += g * b->data[i];
+        AudioStream_F32::release(b);
+    }
+    for (uint8_t c = 0; c < 2; c++)
+    {
+        AudioStream_F32::transmit(out[c], c);
+        AudioStream_F32::release(out[c]);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// stages: one adapter per effect, parameters named after the effect API
+
+static bool parse_f(const char *val, float &f)
+{
+    char *end;
+    f = strtof(val, &end);
+    return end != val && *end == '\0';
+}
+
+static bool parse_b(const char *val, bool &b)
+{
+    if (!strcmp(val, "1") || !strcmp(val, "on") || !strcmp(val, "true")) b = true;
+    else if (!strcmp(val, "0") || !strcmp(val, "off") || !strcmp(val, "false")) b = false;
+    else return false;
+    return true;
+}
+
+static int parse_e(const char *val, const char *const *names, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (!strcmp(val, names[i])) return i;
+    }
+    return -1;
+}
+
+#define HX_STAGE_MAX_INST   3   // effect objects of a stage
+
+class HxStage
+{
+public:
+    virtual ~HxStage() {}
+    /**
+     * @return false if the key is unknown or the value invalid
+     */
+    virtual bool set(const char *key, const char *val) = 0;
+#if defined(AUDIO_PROFILE)
+    virtual AudioProfile *profile(int i) = 0;
+#endif
+    /**
+     * @brief Appends the effect instances to a fused chain
+     * @return stage number, -1 for an int16 or a multi lane effect
+     */
+    virtual int fuse(AudioEffectChain_F32 &chain) = 0;
+    /**
+     * @brief Object and port receiving audio input i of a single instance stage
+     */
+    virtual AudioStream *input(uint8_t i, uint8_t &port) { port = i; return node[0];}
+    /**
+     * @brief Object and port sending audio output c of a single instance stage
+     */
+    virtual AudioStream *output(uint8_t c, uint8_t &port) { port = c; return node[0];}
+    AudioStream *node[HX_STAGE_MAX_INST];
+    uint8_t instances;      // 2 for a mono effect in a stereo stream
+    uint8_t ins, outs;      // audio ports of the stage, of one instance if dual mono
+    bool f32;
+    const char *name;
+};
+
+template <class T, int INS, int OUTS, bool F32>
+class HxStageFx : public HxStage
+{
+public:
+    HxStageFx(uint8_t width)
+    {
+        instances = (INS == 1 && OUTS == 1) ? width : 1;
+        for (int i = 0; i < instances; i++) node[i] = fx[i] = new T;
+        ins = INS;
+        outs = OUTS;
+        f32 = F32;
+    }
+    ~HxStageFx()
+    {
+        for (int i = 0; i < instances; i++) delete fx[i];
+    }
+#if defined(AUDIO_PROFILE)
+    AudioProfile *profile(int i) { return &fx[i]->profile;}
+#endif
+    int fuse(AudioEffectChain_F32 &chain)
+    {
+        if constexpr (!F32) return -1;
+        else if constexpr (INS > 2 || OUTS > 2) return -1;
+        else if constexpr (INS == 1 && OUTS == 1)
+        {
+            if (instances == 2) return chain.add(*fx[0], *fx[1]);
+            return chain.add(*fx[0]);
+        }
+        else return chain.add(*fx[0]);
+    }
+protected:
+    T *fx[HX_STAGE_MAX_INST];
+};
+
+static const char *const toneStackModels[] =
+    {"off", "bassman", "prince", "mesa", "vox", "jcm800", "twin", "hk", "jazz", "pignose"};
+
+class HxToneStack : public HxStageFx<AudioFilterToneStackStereo_F32, 2, 2, true>
+{
+public:
+    HxToneStack(uint8_t w) : HxStageFx(w) {}
+    bool set(const char *key, const char *val)
+    {
+        float f = 0.0f;
+        if (!strcmp(key, "model"))
+        {
+            int m = parse_e(val, toneStackModels, sizeof(toneStackModels) / sizeof(toneStackModels[0]));
+            if (m < 0) return false;
+            fx[0]->setModel((toneStack_presets_e)m);
+            return true;
+        }
+        if (!parse_f(val, f)) return false;
+        if (!strcmp(key, "bass")) fx[0]->setBass(f);
+        else if (!strcmp(key, "mid")) fx[0]->setMid(f);
+        else if (!strcmp(key, "treble")) fx[0]->setTreble(f);
+        else if (!strcmp(key, "gain")) fx[0]->setGain(f);
+        else return false;
+        return true;
+    }
+};
+
+/**
+ * @brief Lane parameters of the multi lane stages: "bass" sets all lanes,
+ *      "bass3" lane 3 only
+ * @return first lane, -1 for an invalid lane, last lane + 1 in end
+ */
+static int parse_lane(const char *key, std::string &name, int &end)
+{
+    size_t n = strcspn(key, "0123456789");
+    char *e;
+    name.assign(key, n);
+    if (!key[n])
+    {
+        end = HX_CHAIN_MAX_LANES;
+        return 0;
+    }
+    long l = strtol(key + n, &e, 10);
+    if (*e || l >= HX_CHAIN_MAX_LANES) return -1;
+    end = l + 1;
+    return l;
+}
+
+/**
+ * @brief Hexaphonic tone stack, lane settings per string, the lanes are
+ *      mixed to stereo
+ */
+class HxToneStack6 : public HxStage
+{
+public:
+    HxToneStack6(uint8_t w)
+    {
+        (void)w;
+        node[0] = fx = new AudioFilterToneStackMulti_F32<HX_CHAIN_MAX_LANES>;
+        mix = new AudioHostLaneMix_F32(HX_CHAIN_MAX_LANES);     // after the effect, the update order follows the signal
+        for (uint8_t l = 0; l < HX_CHAIN_MAX_LANES; l++) conn[l] = new AudioConnection(*fx, l, *mix, l);
+        instances = 1;
+        ins = HX_CHAIN_MAX_LANES;
+        outs = 2;
+        f32 = true;
+    }
+    ~HxToneStack6()
+    {
+        for (AudioConnection *c : conn) delete c;
+        delete mix;
+        delete fx;
+    }
+    AudioStream *output(uint8_t c, uint8_t &port) { port = c; return mix;}
+#if defined(AUDIO_PROFILE)
+    AudioProfile *profile(int i) { (void)i; return &fx->profile;}
+#endif
+    int fuse(AudioEffectChain_F32 &chain) { (void)chain; return -1;}
+    bool set(const char *key, const char *val)
+    {
+        std::string k;
+        float f = 0.0f;
+        int end, l = parse_lane(key, k, end);
+        if (l < 0) return false;
+        if (k == "model")
+        {
+            int m = parse_e(val, toneStackModels, sizeof(toneStackModels) / sizeof(toneStackModels[0]));
+            if (m < 0) return false;
+            if (l == 0 && end == HX_CHAIN_MAX_LANES) fx->setModel((toneStack_presets_e)m);   // one change
+            else for (; l < end; l++) fx->setModel(l, (toneStack_presets_e)m);
+            return true;
+        }
+        if (!parse_f(val, f)) return false;
+        for (; l < end; l++)
+        {
+            if (k == "bass") fx->setBass(l, f);
+            else if (k == "mid") fx->setMid(l, f);
+            else if (k == "treble") fx->setTreble(l, f);
+            else if (k == "gain") fx->setGain(l, f);
+            else return false;
+        }
+        return true;
+    }
+private:
+    AudioFilterToneStackMulti_F32<HX_CHAIN_MAX_LANES> *fx;
+    AudioHostLaneMix_F32 *mix;
+    AudioConnection *conn[HX_CHAIN_MAX_LANES];
+};
+
+/**
+ * @brief The lanes of tonestack6 on 3 stereo tone stacks (scalar filters),
+ *      the hx_bench reference. Lanes 2k and 2k + 1 share the settings.
+ */
+class HxToneStack6Scalar : public HxStage
+{
+public:
+    HxToneStack6Scalar(uint8_t w)
+    {
+        (void)w;
+        instances = HX_CHAIN_MAX_LANES / 2;
+        for (int i = 0; i < instances; i++) node[i] = fx[i] = new AudioFilterToneStackStereo_F32;
+        mix = new AudioHostLaneMix_F32(HX_CHAIN_MAX_LANES);
+        for (uint8_t l = 0; l < HX_CHAIN_MAX_LANES; l++) conn[l] = new AudioConnection(*fx[l / 2], l & 1, *mix, l);
+        ins = HX_CHAIN_MAX_LANES;
+        outs = 2;
+        f32 = true;
+    }
+    ~HxToneStack6Scalar()
+    {
+        for (AudioConnection *c : conn) delete c;
+        delete mix;
+        for (int i = 0; i < instances; i++) delete fx[i];
+    }
+    AudioStream *input(uint8_t i, uint8_t &port) { port = i & 1; return fx[i / 2];}
+    AudioStream *output(uint8_t c, uint8_t &port) { port = c; return mix;}
+#if defined(AUDIO_PROFILE)
+    AudioProfile *profile(int i) { return &fx[i]->profile;}
+#endif
+    int fuse(AudioEffectChain_F32 &chain) { (void)chain; return -1;}
+    bool set(const char *key, const char *val)
+    {
+        std::string k;
+        float f = 0.0f;
+        int end, l = parse_lane(key, k, end);
+        if (l < 0) return false;
+        if (k == "model")
+        {
+            int m = parse_e(val, toneStackModels, sizeof(toneStackModels) / sizeof(toneStackModels[0]));
+            if (m < 0) return false;
+            for (l /= 2; l < (end + 1) / 2; l++) fx[l]->setModel((toneStack_presets_e)m);
+            return true;
+        }
+        if (!parse_f(val, f)) return false;
+        for (l /= 2; l < (end + 1) / 2; l++)
+        {
+            if (k == "bass") fx[l]->setBass(f);
+            else if (k == "mid") fx[l]->setMid(f);
+            else if (k == "treble") fx[l]->setTreble(f);
+            else if (k == "gain") fx[l]->setGain(f);
+            else return false;
+        }
+        return true;
+    }
+private:
+    AudioFilterToneStackStereo_F32 *fx[HX_CHAIN_MAX_LANES / 2];
+    AudioHostLaneMix_F32 *mix;
+    AudioConnection *conn[HX_CHAIN_MAX_LANES];
+};
+
+static const char *const monoToStereoQuality[] = {"low", "mid", "high"};
+static const char *const monoToStereoEngine[] = {"allpass", "velvet", "hilbert"};
+
+class HxMonoToStereo : public HxStageFx<AudioEffectMonoToStereo_F32, 1, 2, true>
+{
+public:
+    HxMonoToStereo(uint8_t w) : HxStageFx(w) {}
+    bool set(const char *key, const char *val)
+    {
+        float f;
+        bool b;
+        int e;
+        if (!strcmp(key, "quality") && (e = parse_e(val, monoToStereoQuality, 3)) >= 0)
+            fx[0]->setQuality((monoToStereo_quality_e)e);
+        else if (!strcmp(key, "engine") && (e = parse_e(val, monoToStereoEngine, 3)) >= 0)
+            fx[0]->setEngine((monoToStereo_engine_e)e);
+        else if (!strcmp(key, "bypass") && parse_b(val, b)) fx[0]->setBypass(b);
+        else if (!strcmp(key, "spread") && parse_f(val, f)) fx[0]->setSpread(f);
+        else if (!strcmp(key, "pan") && parse_f(val, f)) fx[0]->setPan(f);
+        else return false;
+        return true;
+    }
+};
+
+/**
+ * @brief The phasers share the parameter set, only the bypass call differs
+ */
+template <class T, int INS, int OUTS, bool F32>
+class HxPhaserBase : public HxStageFx<T, INS, OUTS, F32>
+{
+public:
+    HxPhaserBase(uint8_t w) : HxStageFx<T, INS, OUTS, F32>(w) {}
+    bool set(const char *key, const char *val)
+    {
+        float f;
+        bool b;
+        if (!strcmp(key, "bypass") && parse_b(val, b))
+        {
+            for (int i = 0; i < this->instances; i++) bypass(*this->fx[i], b);
+            return true;
+        }
+        if (!parse_f(val, f)) return false;
+        if (!strcmp(key, "top")) top = f;
+        else if (!strcmp(key, "btm")) btm = f;
+        for (int i = 0; i < this->instances; i++)
+        {
+            T &p = *this->fx[i];
+            if (!strcmp(key, "rate")) p.lfo_rate(f);
+            else if (!strcmp(key, "top") || !strcmp(key, "btm")) p.depth(top, btm);
+            else if (!strcmp(key, "fb")) p.feedback(f);
+            else if (!strcmp(key, "mix")) p.mix(f);
+            else if (!strcmp(key, "stages")) p.stages((uint8_t)f);
+            else if (!setExtra(p, key, f)) return false;
+        }
+        return true;
+    }
+protected:
+    float top = 1.0f, btm = 0.0f;       // effect defaults
+    virtual void bypass(T &p, bool b) = 0;
+    virtual bool setExtra(T &p, const char *key, float f) { (void)p; (void)key; (void)f; return false;}
+};
+
+class HxPhaser : public HxPhaserBase<AudioEffectPhaser, 1, 1, false>
+{
+public:
+    HxPhaser(uint8_t w) : HxPhaserBase(w) {}
+    void bypass(AudioEffectPhaser &p, bool b) { p.bypass(b);}
+};
+
+class HxPhaserStereo : public HxPhaserBase<AudioEffectPhaserStereo, 2, 2, false>
+{
+public:
+    HxPhaserStereo(uint8_t w) : HxPhaserBase(w) {}
+    void bypass(AudioEffectPhaserStereo &p, bool b) { p.bypass(b);}
+    bool setExtra(AudioEffectPhaserStereo &p, const char *key, float f)
+    {
+        if (strcmp(key, "phase")) return false;
+        p.stereo_phase(f);
+        return true;
+    }
+};
+
+class HxPhaserF32 : public HxPhaserBase<AudioEffectPhaser_F32, 1, 1, true>
+{
+public:
+    HxPhaserF32(uint8_t w) : HxPhaserBase(w) {}
+    void bypass(AudioEffectPhaser_F32 &p, bool b) { p.set_bypass(b);}
+};
+
+class HxInfPhaser : public HxPhaserBase<AudioEffectInfinitePhaser_F32, 1, 1, true>
+{
+public:
+    HxInfPhaser(uint8_t w) : HxPhaserBase(w) {}
+    void bypass(AudioEffectInfinitePhaser_F32 &p, bool b) { p.set_bypass(b);}
+};
+
+/**
+ * @brief Both reverbs share the parameter set
+ */
+template <class T, bool F32>
+class HxReverbBase : public HxStageFx<T, 2, 2, F32>
+{
+public:
+    HxReverbBase(uint8_t w) : HxStageFx<T, 2, 2, F32>(w) {}
+    bool set(const char *key, const char *val)
+    {
+        float f;
+        bool b;
+        T &r = *this->fx[0];
+        if (parse_b(val, b) && setFlag(r, key, b)) return true;
+        if (!parse_f(val, f)) return false;
+        if (!strcmp(key, "size")) r.size(f);
+        else if (!strcmp(key, "hidamp")) r.hidamp(f);
+        else if (!strcmp(key, "lodamp")) r.lodamp(f);
+        else if (!strcmp(key, "lowpass")) r.lowpass(f);
+        else if (!strcmp(key, "diffusion")) r.diffusion(f);
+        else return false;
+        return true;
+    }
+protected:
+    virtual bool setFlag(T &r, const char *key, bool b) = 0;
+};
+
+class HxReverb : public HxReverbBase<AudioEffectPlateReverb, false>
+{
+public:
+    HxReverb(uint8_t w) : HxReverbBase(w) {}
+    bool setFlag(AudioEffectPlateReverb &r, const char *key, bool b)
+    {
+        if (strcmp(key, "bypass")) return false;
+        r.set_bypass(b);
+        return true;
+    }
+};
+
+class HxReverbF32 : public HxReverbBase<AudioEffectPlateReverb_F32, true>
+{
+public:
+    HxReverbF32(uint8_t w) : HxReverbBase(w) {}
+    bool setFlag(AudioEffectPlateReverb_F32 &r, const char *key, bool b)
+    {
+        if (!strcmp(key, "bypass")) r.bypass_set(b);
+        else if (!strcmp(key, "freeze")) r.freeze(b);
+        else return false;
+        return true;
+    }
+};
+
+template <class S> static HxStage *make(uint8_t width) { return new S(width);}
+
+typedef struct
+{
+    const char *name;
+    HxStage *(*create)(uint8_t width);
+    bool f32;
+    uint8_t ins;
+    bool dualMono;          // mono effect, 2 instances in a stereo stream
+    const char *params;
+}hx_stage_info_t;
+
+static const hx_stage_info_t stageTable[] =
+{
+    {"tonestack",   make<HxToneStack>,      true,  2, false, "model=off|bassman|prince|mesa|vox|jcm800|twin|hk|jazz|pignose bass mid treble gain"},
+    {"mono2stereo", make<HxMonoToStereo>,   true,  1, false, "spread pan quality=low|mid|high engine=allpass|velvet|hilbert bypass"},
+    {"phaser",      make<HxPhaser>,         false, 1, true,  "rate(Hz) top btm fb mix stages bypass"},
+    {"phaser_st",   make<HxPhaserStereo>,   false, 2, false, "rate(Hz) top btm fb mix stages phase(deg) bypass"},
+    {"phaser_f32",  make<HxPhaserF32>,      true,  1, true,  "rate(Hz) top btm fb mix stages bypass"},
+    {"infphaser",   make<HxInfPhaser>,      true,  1, true,  "rate(-1..1) top btm fb mix stages bypass"},
+    {"reverb",      make<HxReverb>,         false, 2, false, "size hidamp lodamp lowpass diffusion bypass"},
+    {"reverb_f32",  make<HxReverbF32>,      true,  2, false, "size hidamp lodamp lowpass diffusion freeze bypass"},
+    {"tonestack6",  make<HxToneStack6>,     true,  6, false, "model[N]=off|bassman|... bass[N] mid[N] treble[N] gain[N], N = lane 0..5, default all"},
+    {"tonestack6s", make<HxToneStack6Scalar>, true, 6, false, "as tonestack6, lanes 2k and 2k+1 share the settings"},
+};
+
+static const hx_stage_info_t *find_stage(const std::string &spec)
+{
+    std::string name = spec.substr(0, spec.find(','));
+    for (const hx_stage_info_t &s : stageTable)
+    {
+        if (name == s.name) return &s;
+    }
+    return NULL;
+}
+
+// ---------------------------------------------------------------------------
+
+HxChain::HxChain()
+{
+    fused = NULL;
+    source = NULL;
+    sink = NULL;
+    chIn = 0;
+    chOut = 0;
+    flush = true;           // as on the Teensy 4, see flushToZero()
+}
+
+HxChain::~HxChain()
+{
+    clear();
+}
+
+void HxChain::clear()
+{
+    // connections first, the objects release their pending blocks
+    for (AudioConnection *c : connections) delete c;
+    connections.clear();
+    delete sink;
+    delete fused;
+    for (size_t i = stages.size(); i > 0; i--) delete stages[i - 1];
+    for (AudioStream *c : converters) delete c;
+    delete source;
+    stages.clear();
+    converters.clear();
+    sink = NULL;
+    fused = NULL;
+    source = NULL;
+}
+
+void HxChain::list(FILE *f)
+{
+    for (const hx_stage_info_t &s : stageTable)
+    {
+        fprintf(f, "  %-12s %s  %s\n", s.name, s.f32 ? "f32  " : "int16", s.params);
+    }
+}
+
+bool HxChain::fusable(const char *spec)
+{
+    const hx_stage_info_t *info = find_stage(spec);
+    return info && info->f32 && info->ins <= HX_CHAIN_MAX_CH;     // AudioEffectChain_F32 stages are mono or stereo
+}
+
+bool HxChain::add(const char *spec)
+{
+    if (!find_stage(spec))
+    {
+        err = std::string("unknown effect: ") + spec;
+        return false;
+    }
+    specs.push_back(spec);
+    return true;
+}
+
+bool HxChain::build(uint8_t channels, bool fuse)
+{
+    struct port_t { AudioStream *node; uint8_t idx; bool f32;};
+    port_t cur[HX_CHAIN_MAX_CH], nxt[HX_CHAIN_MAX_CH];
+    uint8_t width, c, i;
+
+    clear();
+    if (channels < 1 || channels > HX_CHAIN_MAX_CH)
+    {
+        err = "only mono and stereo inputs are supported";
+        return false;
+    }
+    for (const std::string &spec : specs)
+    {
+        if (fuse && !fusable(spec.c_str()))
+        {
+            err = "fused chain: " + spec.substr(0, spec.find(',')) + " is not a mono or stereo F32 effect";
+            return false;
+        }
+    }
+    // generous pools, each connection holds at most one block per cycle
+    AudioMemory(16 + 8 * specs.size());
+    AudioMemory_F32(16 + 8 * specs.size());
+
+    width = channels;
+    source = new AudioHostSource_F32(channels);
+    for (c = 0; c < width; c++) cur[c] = {source, c, true};
+    if (fuse)       // one node, the stage objects are not connected
+    {
+        fused = new AudioEffectChain_F32;
+        for (c = 0; c < width; c++) connections.push_back(new AudioConnection(*source, c, *fused, c));
+        for (c = 0; c < HX_CHAIN_MAX_CH; c++) cur[c] = {fused, c, true};
+    }
+
+    for (const std::string &spec : specs)
+    {
+        const hx_stage_info_t *info = find_stage(spec);
+        uint8_t used = (info->dualMono || info->ins >= 2) ? width : 1;
+        // converters are created before the stage, the update order follows the signal
+        for (c = 0; c < used && !fused; c++)
+        {
+            if (cur[c].f32 == info->f32) continue;
+            AudioStream *conv = info->f32 ? (AudioStream *)new AudioConvert_I16toF32 : (AudioStream *)new AudioConvert_F32toI16;
+            converters.push_back(conv);
+            connections.push_back(new AudioConnection(*cur[c].node, cur[c].idx, *conv, 0));
+            cur[c] = {conv, 0, info->f32};
+        }
+        HxStage *st = info->create(width);
+        st->name = info->name;
+        stages.push_back(st);
+        if (fused)
+        {
+            st->fuse(*fused);
+            if (st->instances == 1) width = st->outs;
+            memcpy(nxt, cur, sizeof(cur));
+        }
+        else if (st->instances == 2)
+        {
+            for (c = 0; c < 2; c++)
+            {
+                connections.push_back(new AudioConnection(*cur[c].node, cur[c].idx, *st->node[c], 0));
+                nxt[c] = {st->node[c], 0, st->f32};
+            }
+        }
+        else
+        {
+            for (i = 0; i < st->ins; i++)   // channel i % width: a mono stream feeds both inputs of a stereo effect
+            {
+                uint8_t port;
+                AudioStream *dst = st->input(i, port);
+                c = i % width;
+                connections.push_back(new AudioConnection(*cur[c].node, cur[c].idx, *dst, port));
+            }
+            for (c = 0; c < st->outs; c++)
+            {
+                uint8_t port;
+                AudioStream *src = st->output(c, port);
+                nxt[c] = {src, port, st->f32};
+            }
+            width = st->outs;
+        }
+        memcpy(cur, nxt, sizeof(cur));
+
+        // parameters
+        size_t pos = spec.find(',');
+        while (pos != std::string::npos)
+        {
+            size_t end = spec.find(',', pos + 1);
+            std::string kv = spec.substr(pos + 1, end == std::string::npos ? std::string::npos : end - pos - 1);
+            size_t eq = kv.find('=');
+            if (eq == std::string::npos || !st->set(kv.substr(0, eq).c_str(), kv.substr(eq + 1).c_str()))
+            {
+                err = std::string(info->name) + ": invalid parameter '" + kv + "', expected: " + info->params;
+                clear();
+                return false;
+            }
+            pos = end;
+        }
+    }
+
+    for (c = 0; c < width; c++)
+    {
+        if (cur[c].f32) continue;
+        AudioStream *conv = new AudioConvert_I16toF32;
+        converters.push_back(conv);
+        connections.push_back(new AudioConnection(*cur[c].node, cur[c].idx, *conv, 0));
+        cur[c] = {conv, 0, true};
+    }
+    sink = new AudioHostSink_F32(width);
+    for (c = 0; c < width; c++) connections.push_back(new AudioConnection(*cur[c].node, cur[c].idx, *sink, c));
+    chIn = channels;
+    chOut = width;
+    return true;
+}
+
+void HxChain::process(const float *const *in, float *const *out)
+{
+    source->src = in;
+    sink->dst = out;
+    AudioFlushToZero ftz(flush);
+    AudioStream::update_all();
+}
+
+bool HxChain::process(const float *const *in, float *const *out, uint32_t n)
+{
+    if (!fused) return false;
+    const float *src[HX_CHAIN_MAX_CH] = {in[0], chIn > 1 ? in[1] : NULL};
+    AudioFlushToZero ftz(flush);
+    fused->process(src, out, n);
+    return true;
+}
+
+bool HxChain::set(size_t stage, const char *key, const char *val)
+{
+    if (stage >= stages.size()) return false;
+    return stages[stage]->set(key, val);
+}
+
+uint32_t HxChain::cycles() const
+{
+    uint32_t c = 0;
+    if (fused) return fused->cpu_cycles;
+    for (size_t s = 0; s < stages.size(); s++) c += stageCycles(s);
+    return c;
+}
+
+uint32_t HxChain::stageCycles(size_t stage) const
+{
+    uint32_t c = 0;
+    if (stage >= stages.size()) return 0;
+    for (int i = 0; i < stages[stage]->instances; i++) c += stages[stage]->node[i]->cpu_cycles;
+    return c;
+}
+
+#if defined(AUDIO_PROFILE)
+const AudioProfile *HxChain::profile(size_t stage, int inst) const
+{
+    if (stage >= stages.size() || inst >= stages[stage]->instances) return NULL;
+    return stages[stage]->profile(inst);
+}
+
+void HxChain::profileReset()
+{
+    for (HxStage *s : stages)
+        for (int i = 0; i < s->instances; i++) s->profile(i)->reset();
+}
+#endif
+
+void HxChain::usage(FILE *f)
+{
+    if (fused) fprintf(f, "  %-12s max %6.2f%%\n", "fused chain", fused->processorUsageMax());
+    for (HxStage *s : stages)
+    {
+        float u = 0.0f;
+        for (int i = 0; i < s->instances; i++) u += s->node[i]->processorUsageMax();
+        if (!fused) fprintf(f, "  %-12s max %6.2f%%\n", s->name, u);
+        else fprintf(f, "  %s\n", s->name);
+#if defined(AUDIO_PROFILE)
+        for (int i = 0; i < s->instances; i++)
+        {
+            const AudioProfile *p = s->profile(i);
+            char tag[8] = "";
+            if (s->instances == 2) strcpy(tag, i ? "R:" : "L:");
+            else if (s->instances > 2) snprintf(tag, sizeof(tag), "%d:", i);
+            for (uint8_t st = 0; st < p->stages(); st++)
+            {
+                fprintf(f, "    %s%-10s mean %9.0f  min %8u  max %8u ticks/block\n",
+                        tag, p->name(st),
+                        p->cyclesMean(st), (unsigned)p->cyclesMin(st), (unsigned)p->cyclesMax(st));
+            }
+        }
+#endif
+    }
+}
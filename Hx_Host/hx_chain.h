@@ -0,0 +1,194 @@
+/*  Effect chain builder for the host tools
+ *
+ *  Author: Piotr Zapart
+ *          www.hexefx.com
+ *
+ * Copyright (c) 2021 by Piotr Zapart
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _HX_CHAIN_H
+#define _HX_CHAIN_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "AudioStream_F32.h"
+#include "utility_profile.h"
+
+#define HX_CHAIN_MAX_CH     2       // mono or stereo streams
+#define HX_CHAIN_MAX_LANES  6       // multi lane effects, ie. a hexaphonic tone stack
+
+/**
+ * @brief Graph input, transmits the caller's buffers as float blocks
+ */
+class AudioHostSource_F32 : public AudioStream_F32
+{
+public:
+    AudioHostSource_F32(uint8_t ch) : AudioStream_F32(0, NULL), channels(ch) {}
+    virtual void update(void);
+    const float *const *src = NULL;     // one AUDIO_BLOCK_SAMPLES buffer per channel
+private:
+    uint8_t channels;
+};
+
+/**
+ * @brief Graph output, copies the received float blocks to the caller's
+ *      buffers, silence if a block is missing
+ */
+class AudioHostSink_F32 : public AudioStream_F32
+{
+public:
+    AudioHostSink_F32(uint8_t ch) : AudioStream_F32(ch, inputQueueArray_f32), channels(ch) {}
+    virtual void update(void);
+    float *const *dst = NULL;
+private:
+    uint8_t channels;
+    audio_block_f32_t *inputQueueArray_f32[HX_CHAIN_MAX_CH];
+};
+
+/**
+ * @brief Sums the outputs of a multi lane effect to a stereo stream: even
+ *      lanes to L, odd lanes to R, scaled by 2 / lanes
+ */
+class AudioHostLaneMix_F32 : public AudioStream_F32
+{
+public:
+    AudioHostLaneMix_F32(uint8_t n) : AudioStream_F32(n, inputQueueArray_f32), lanes(n) {}
+    virtual void update(void);
+private:
+    uint8_t lanes;
+    audio_block_f32_t *inputQueueArray_f32[HX_CHAIN_MAX_LANES];
+};
+
+class HxStage;
+class AudioEffectChain_F32;
+
+/**
+ * @brief Chain of effects rendered block by block through the regular
+ *      AudioStream graph of the calling thread: source -> effects -> sink.
+ *      int16 <-> float32 converters are inserted between the int16 and
+ *      float effects. Mono effects in a stereo stream run as two instances.
+ *      Lane l of a multi lane effect is fed by the stream channel
+ *      l % width, the lanes are mixed to stereo (AudioHostLaneMix_F32).
+ *      Only one chain may exist per thread, update_all() runs all objects
+ *      created by the thread.
+ *
+ *      Stage spec:  name[,param=value,...]  ie. "phaser,rate=0.5,stages=8"
+ */
+class HxChain
+{
+public:
+    HxChain();
+    ~HxChain();
+    /**
+     * @brief Appends a stage, the objects are created by build()
+     * @return false if the effect name is unknown
+     */
+    bool add(const char *spec);
+    /**
+     * @brief Creates the audio objects and connections, applies the parameters
+     *
+     * @param channels input channels, 1 or 2
+     * @param fuse  run all stages in one AudioEffectChain_F32 node instead
+     *              of a node per stage, F32 effects only
+     * @return false on an invalid parameter, see error()
+     */
+    bool build(uint8_t channels, bool fuse = false);
+    /**
+     * @brief Renders one block of AUDIO_BLOCK_SAMPLES samples
+     *
+     * @param in    channelsIn() buffers
+     * @param out   channelsOut() buffers
+     */
+    void process(const float *const *in, float *const *out);
+    /**
+     * @brief Renders n samples, any n, through the processing core of a
+     *      fused chain (AudioEffectChain_F32::process()), without the graph
+     *
+     * @param in    channelsIn() buffers
+     * @param out   2 buffers, a mono stream is sent to both
+     * @return false if the chain is not fused
+     */
+    bool process(const float *const *in, float *const *out, uint32_t n);
+    /**
+     * @brief process() runs with the FPU in flush-to-zero mode like the
+     *      Teensy 4 does (default), off: denormals are computed, to check
+     *      the denormal protection of the effects, see utility_denormal.h
+     */
+    void flushToZero(bool on) { flush = on;}
+    uint8_t channelsIn() const { return chIn;}
+    uint8_t channelsOut() const { return chOut;}
+    /**
+     * @brief Changes a parameter of a built stage, ie. for a parameter sweep
+     * @return false if the key is unknown or the value invalid
+     */
+    bool set(size_t stage, const char *key, const char *val);
+    size_t numStages() const { return stages.size();}
+    /**
+     * @brief Ticks spent in update() of the stage objects in the last
+     *      process() call, converters and lane mixers excluded, 0 if fused. See hx_timer.h
+     */
+    uint32_t stageCycles(size_t stage) const;
+    /**
+     * @brief Ticks of all stages in the last process() call, converters
+     *      and lane mixers excluded. The whole AudioEffectChain_F32 update() if fused.
+     */
+    uint32_t cycles() const;
+#if defined(AUDIO_PROFILE)
+    /**
+     * @brief Per stage ticks of the effect update(), see utility_profile.h
+     *
+     * @param inst instance of a mono effect in a stereo stream, or
+     *      of the stereo effects that make up a multi lane stage
+     * @return NULL if there is no such stage
+     */
+    const AudioProfile *profile(size_t stage, int inst = 0) const;
+    void profileReset();
+#endif
+    /**
+     * @brief Processor usage of the objects, percent of one block period,
+     *      with the update() stage breakdown in a profiling build
+     */
+    void usage(FILE *f);
+    const char *error() const { return err.c_str();}
+    /**
+     * @brief Prints the available effects and their parameters
+     */
+    static void list(FILE *f);
+    /**
+     * @return true if the effect can be a stage of a fused chain
+     */
+    static bool fusable(const char *spec);
+private:
+    std::vector<std::string> specs;
+    std::vector<HxStage *> stages;
+    std::vector<AudioStream *> converters;
+    std::vector<AudioConnection *> connections;
+    AudioEffectChain_F32 *fused;
+    AudioHostSource_F32 *source;
+    AudioHostSink_F32 *sink;
+    uint8_t chIn, chOut;
+    bool flush;
+    std::string err;
+    void clear();
+};
+
+#endif // _HX_CHAIN_H
@@ -0,0 +1,941 @@
+/*  hx_golden - golden output regression check, renders fixed stimuli through
+ *  each effect with a fixed parameter script and compares the result with
+ *  the stored reference renders.
+ *
+ *  Author: Piotr Zapart
+ *          www.hexefx.com
+ *
+ * Copyright (c) 2021 by Piotr Zapart
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "hx_chain.h"
+#include "hx_wav.h"
+#include "effect_platervbstereo.h"      // TAP1_MODULATED, TAP2_MODULATED of this build
+#include "effect_phaser.h"              // PHASER_USE_FIXEDPOINT of this build
+#include "effect_phaserStereo.h"
+#include "synth_modbus.h"
+#include "utility_params.h"
+#include "filter_tonestackMulti_F32.h"
+#include "effect_chain_F32.h"
+#include "effect_platervbstereo_F32.h"
+#include "effect_phaser_F32.h"
+#include "effect_monoToStereo_F32.h"
+
+// the reverb references are stored per loop tap modulation variant
+#if defined(TAP1_MODULATED) && defined(TAP2_MODULATED)
+#define GOLDEN_TAPS         "tap12"
+#elif defined(TAP1_MODULATED)
+#define GOLDEN_TAPS         "tap1"
+#elif defined(TAP2_MODULATED)
+#define GOLDEN_TAPS         "tap2"
+#else
+#define GOLDEN_TAPS         "tap0"
+#endif
+
+// the int16 phasers have own references in the fixed point build
+#if defined(PHASER_USE_FIXEDPOINT)
+#define GOLDEN_PHASER       "_fixed"
+#else
+#define GOLDEN_PHASER       ""
+#endif
+
+#define GOLDEN_BLOCK        128         // block size the references were rendered with
+#define GOLDEN_SEGMENTS     4
+
+// stimulus segments, rendered back to back without resetting the effect
+static const char *const segName[GOLDEN_SEGMENTS] = {"impulse", "sweep", "noise", "guitar"};
+static const size_t segLen[GOLDEN_SEGMENTS] = {8192, 16384, 4096, 16384};
+
+typedef struct
+{
+    std::string name;       // reference file name
+    const char *spec;       // chain stage
+    uint8_t channels;       // stimulus width
+    const char *script;     // "block:key=value ..." parameter changes during the render
+    float maxDb;            // error rms relative to the reference rms, per segment
+    float maxAbs;           // largest sample error, full scale = 1.0
+    const char *ref;        // compare with the reference of another case, NULL = name
+}hx_golden_case_t;
+
+typedef struct
+{
+    const char *dir;
+    const char *keepDir;
+    const char *filter;
+    bool update;
+    bool verbose;
+    bool list;
+    bool fused;             // render through AudioEffectChain_F32, same references
+    std::vector<uint32_t> chunks;   // fused, process() called with these lengths in turn
+}hx_golden_opts_t;
+
+static hx_golden_opts_t opt;
+static std::vector<float> stim[HX_CHAIN_MAX_CH];
+
+/**
+ * @brief Tolerances: about 10dB above the error caused by a rebuild with fused
+ *      multiply-add (-ffp-contract=fast, as on the Cortex-M7), so reordered
+ *      float math passes and a changed algorithm does not. The tone stack is
+ *      a 3rd order IIR sensitive to coefficient rounding, in the int16 phaser
+ *      a rounding flip in the LFO or feedback spreads through the chain.
+ */
+static void make_cases(std::vector<hx_golden_case_t> &cases)
+{
+    cases.push_back({"tonestack", "tonestack,model=bassman,bass=0.5,mid=0.5,treble=0.5", 2,
+                     "60:treble=0.9 120:model=jcm800 180:bass=0.2 240:model=off 260:model=vox 300:gain=0.5",
+                     -40.0f, 1e-2f});
+    cases.push_back({"tonestack6", "tonestack6,model=bassman,model3=jcm800,bass1=0.2,treble4=0.9", 2,
+                     "60:treble2=0.1 120:model5=vox 180:bass=0.7 240:model0=off 300:gain3=0.5",
+                     -40.0f, 1e-2f});
+    cases.push_back({"mono2stereo_allpass", "mono2stereo,engine=allpass,quality=high", 1,
+                     "100:spread=0.3 200:pan=0.7 300:quality=low", -100.0f, 1e-5f});
+    cases.push_back({"mono2stereo_velvet", "mono2stereo,engine=velvet,quality=mid", 1,
+                     "100:spread=0.5 200:bypass=1 230:bypass=0", -100.0f, 1e-5f});
+    cases.push_back({"mono2stereo_hilbert", "mono2stereo,engine=hilbert", 1,
+                     "100:spread=0.8 250:pan=0.2", -100.0f, 1e-5f});
+    cases.push_back({"phaser" GOLDEN_PHASER, "phaser,stages=6,fb=0.5,rate=0.8", 1,
+                     "100:stages=12 150:rate=3 200:stages=16 250:bypass=1 280:bypass=0 300:stages=48",
+                     -55.0f, 1e-2f});
+    cases.push_back({"phaser_st" GOLDEN_PHASER, "phaser_st,stages=8,phase=90,fb=0.3", 2,
+                     "120:phase=180 200:rate=2 260:stages=4", -75.0f, 3e-4f});
+#if defined(PHASER_USE_FIXEDPOINT)          // fixed point vs the float references, int16 rounding and Q15 feedback/mix
+    cases.push_back({"phaser_fixed_vs_float", "phaser,stages=6,fb=0.5,rate=0.8", 1,
+                     "100:stages=12 150:rate=3 200:stages=16 250:bypass=1 280:bypass=0 300:stages=48",
+                     -40.0f, 1e-2f, "phaser"});
+    cases.push_back({"phaser_st_fixed_vs_float", "phaser_st,stages=8,phase=90,fb=0.3", 2,
+                     "120:phase=180 200:rate=2 260:stages=4", -40.0f, 1e-2f, "phaser_st"});
+#endif
+    cases.push_back({"phaser_f32", "phaser_f32,stages=8,fb=0.6,rate=0.5", 1,
+                     "100:top=0.8 150:btm=0.2 200:stages=12 250:mix=0.7", -100.0f, 1e-5f});
+    cases.push_back({"infphaser", "infphaser,stages=6,rate=0.5,fb=0.4", 1,
+                     "120:rate=-0.7 220:stages=4", -120.0f, 1e-5f});
+    cases.push_back({"reverb_" GOLDEN_TAPS, "reverb,size=0.8", 2,
+                     "100:hidamp=0.7 150:lodamp=0.3 200:size=0.4 250:bypass=1 280:bypass=0", -90.0f, 3e-4f});
+    cases.push_back({"reverb_f32_" GOLDEN_TAPS, "reverb_f32,size=0.8", 2,
+                     "100:hidamp=0.7 150:lodamp=0.3 200:size=0.4 250:bypass=1 280:bypass=0", -120.0f, 1e-5f});
+#if !defined(REVERB_TAP_CONFIG)             // freeze does not depend on the taps, default build only
+    cases.push_back({"reverb_f32_freeze", "reverb_f32,size=0.6,diffusion=0.8", 2,
+                     "70:freeze=1 180:freeze=0 300:lowpass=0.3", -120.0f, 1e-5f});
+#endif
+}
+
+/**
+ * @brief Deterministic stimuli: impulse, log sweep 20Hz..20kHz, white noise
+ *      and a plucked string standing in for a guitar DI (Karplus-Strong,
+ *      two notes). The right channel is the left one delayed and attenuated.
+ */
+static void make_stimuli(void)
+{
+    const float fs = AUDIO_SAMPLE_RATE_EXACT;
+    size_t total = 0, pos, i;
+    uint32_t rnd = 12345;
+
+    for (i = 0; i < GOLDEN_SEGMENTS; i++) total += segLen[i];
+    for (uint8_t c = 0; c < HX_CHAIN_MAX_CH; c++) stim[c].assign(total, 0.0f);
+    std::vector<float> &s = stim[0];
+
+    s[0] = 1.0f;
+    pos = segLen[0];
+    const float k = logf(20000.0f / 20.0f);
+    const float T = segLen[1] / fs;
+    for (i = 0; i < segLen[1]; i++)
+    {
+        float t = i / fs;
+        s[pos + i] = 0.5f * sinf(2.0f * (float)M_PI * 20.0f * T / k * (expf(t * k / T) - 1.0f));
+    }
+    pos += segLen[1];
+    for (i = 0; i < segLen[2]; i++)
+    {
+        rnd = rnd * 1103515245u + 12345u;
+        s[pos + i] = 0.25f * ((int32_t)rnd * (1.0f / 2147483648.0f));
+    }
+    pos += segLen[2];
+    for (int note = 0; note < 2; note++)
+    {
+        size_t len = segLen[3] / 2;
+        size_t period = (size_t)(fs / (note ? 146.83f : 82.41f));
+        std::vector<float> line(period);
+        for (float &x : line)
+        {
+            rnd = rnd * 1103515245u + 12345u;
+            x = 0.6f * ((int32_t)rnd * (1.0f / 2147483648.0f));
+        }
+        for (i = 0; i < len; i++)
+        {
+            size_t j = i % period;
+            float y = line[j];
+            line[j] = 0.996f * 0.5f * (y + line[(j + 1) % period]);
+            s[pos + note * len + i] = y;
+        }
+    }
+    for (i = 31; i < total; i++) stim[1][i] = 0.8f * s[i - 31];
+}
+
+/**
+ * @brief Parses the script into per block events
+ */
+static bool parse_script(const char *script, std::vector<std::pair<size_t, std::string>> &ev)
+{
+    const char *p = script;
+    while (*p)
+    {
+        char *end;
+        size_t blk = strtoul(p, &end, 10);
+        if (end == p || *end != ':') return false;
+        p = end + 1;
+        size_t len = strcspn(p, " ");
+        std::string kv(p, len);
+        if (kv.find('=') == std::string::npos) return false;
+        ev.push_back({blk, kv});
+        p += len;
+        while (*p == ' ') p++;
+    }
+    return true;
+}
+
+static bool render(const hx_golden_case_t &gc, std::vector<float> *out, uint8_t &outCh, std::string &err)
+{
+    HxChain chain;
+    std::vector<std::pair<size_t, std::string>> ev;
+    float outBuf[HX_CHAIN_MAX_CH][AUDIO_BLOCK_SAMPLES];
+    float *outPtr[HX_CHAIN_MAX_CH] = {outBuf[0], outBuf[1]};
+    const float *inPtr[HX_CHAIN_MAX_CH];
+    size_t total = stim[0].size(), pos, n, e = 0, chunk = 0;
+
+    if (!parse_script(gc.script, ev))
+    {
+        err = std::string("invalid script: ") + gc.script;
+        return false;
+    }
+    chain.add(gc.spec);
+    if (!chain.build(gc.channels, opt.fused))
+    {
+        err = chain.error();
+        return false;
+    }
+    outCh = chain.channelsOut();
+    for (uint8_t c = 0; c < HX_CHAIN_MAX_CH; c++) out[c].assign(total, 0.0f);
+    for (pos = 0; pos < total; pos += n)
+    {
+        // events are timed in reference blocks
+        for (; e < ev.size() && ev[e].first * GOLDEN_BLOCK <= pos; e++)
+        {
+            const std::string &kv = ev[e].second;
+            size_t eq = kv.find('=');
+            if (!chain.set(0, kv.substr(0, eq).c_str(), kv.substr(eq + 1).c_str()))
+            {
+                err = "invalid script parameter " + kv;
+                return false;
+            }
+        }
+        for (uint8_t c = 0; c < HX_CHAIN_MAX_CH; c++) inPtr[c] = &stim[c][pos];
+        if (opt.chunks.empty())
+        {
+            n = std::min((size_t)AUDIO_BLOCK_SAMPLES, total - pos);
+            chain.process(inPtr, outPtr);
+            for (uint8_t c = 0; c < outCh; c++) memcpy(&out[c][pos], outBuf[c], n * sizeof(float));
+            continue;
+        }
+        // chunked: any length, cut at the next event to keep it on its sample
+        n = std::min((size_t)opt.chunks[chunk++ % opt.chunks.size()], total - pos);
+        if (e < ev.size()) n = std::min(n, ev[e].first * GOLDEN_BLOCK - pos);
+        float *dst[HX_CHAIN_MAX_CH] = {&out[0][pos], &out[1][pos]};
+        chain.process(inPtr, dst, n);
+    }
+    return true;
+}
+
+static bool save(const std::string &path, std::vector<float> *data, uint8_t ch, hx_sample_fmt_e fmt)
+{
+    HxAudioFile f;
+    const float *src[HX_CHAIN_MAX_CH] = {data[0].data(), ch > 1 ? data[1].data() : NULL};
+    if (!f.create(path.c_str(), data[0].size(), ch, (uint32_t)(AUDIO_SAMPLE_RATE_EXACT + 0.5f), fmt))
+    {
+        fprintf(stderr, "%s: %s\n", path.c_str(), f.error());
+        return false;
+    }
+    f.write(0, data[0].size(), src);
+    f.close();
+    return true;
+}
+
+/**
+ * @brief Compares a render with its reference segment by segment
+ * @return true if within the case tolerances
+ */
+static bool compare(const hx_golden_case_t &gc, std::vector<float> *out, uint8_t outCh)
+{
+    HxAudioFile ref;
+    std::string path = std::string(opt.dir) + "/" + (gc.ref ? gc.ref : gc.name) + ".wav";
+    std::vector<float> r[HX_CHAIN_MAX_CH];
+    float *dst[HX_CHAIN_MAX_CH];
+    size_t total = out[0].size(), pos = 0;
+    double worstDb = -400.0, worstAbs = 0.0;
+    int worstSeg = 0;
+    char segInfo[GOLDEN_SEGMENTS][64];
+
+    if (!ref.open(path.c_str()))
+    {
+        printf("%-28s FAIL  %s: %s\n", gc.name.c_str(), path.c_str(), ref.error());
+        return false;
+    }
+    if (ref.channels() != outCh || ref.frames() != total
+        || ref.rate() != (uint32_t)(AUDIO_SAMPLE_RATE_EXACT + 0.5f))
+    {
+        printf("%-28s FAIL  reference is %uch %zu frames %uHz, render %uch %zu frames %.0fHz\n",
+               gc.name.c_str(), ref.channels(), ref.frames(), ref.rate(),
+               outCh, total, AUDIO_SAMPLE_RATE_EXACT);
+        return false;
+    }
+    for (uint8_t c = 0; c < outCh; c++)
+    {
+        r[c].resize(total);
+        dst[c] = r[c].data();
+    }
+    ref.read(0, total, dst);
+
+    for (int s = 0; s < GOLDEN_SEGMENTS; s++)
+    {
+        double eSum = 0.0, rSum = 0.0, eMax = 0.0;
+        for (uint8_t c = 0; c < outCh; c++)
+        {
+            for (size_t i = pos; i < pos + segLen[s]; i++)
+            {
+                double d = (double)out[c][i] - r[c][i];
+                eSum += d * d;
+                rSum += (double)r[c][i] * r[c][i];
+                eMax = std::max(eMax, fabs(d));
+            }
+        }
+        // a silent reference segment is judged against a -100dBFS rms floor
+        double db = 10.0 * log10((eSum + 1e-30) / std::max(rSum, segLen[s] * outCh * 1e-10));
+        if (db > worstDb)
+        {
+            worstDb = db;
+            worstSeg = s;
+        }
+        worstAbs = std::max(worstAbs, eMax);
+        snprintf(segInfo[s], sizeof(segInfo[s]), "%s %.1fdB %.2e", segName[s], db, eMax);
+        pos += segLen[s];
+    }
+    bool pass = worstDb <= gc.maxDb && worstAbs <= gc.maxAbs;
+    printf("%-28s %s  err %7.1fdB (%s, limit %.0fdB)  max abs %.2e (limit %.0e)\n", gc.name.c_str(),
+           pass ? "ok  " : "FAIL", worstDb, segName[worstSeg], gc.maxDb, worstAbs, gc.maxAbs);
+    if (opt.verbose || !pass)
+    {
+        for (int s = 0; s < GOLDEN_SEGMENTS; s++) printf("%30s%s\n", "", segInfo[s]);
+    }
+    return pass;
+}
+
+/**
+ * @brief AudioParams scheduling, driven directly with a one word per field
+ *      set: an at() change is applied at its sample and never earlier, also
+ *      with a full queue, an immediate change does not wait behind the 
+ *      pending ones, changes of a field keep their order.
+ */
+typedef struct
+{
+    int64_t a, b, c;
+}hx_params_test_t;
+
+static bool check_params(void)
+{
+    AudioParams<hx_params_test_t> params;
+    std::vector<hx_params_test_t> trace;     // dst of every processed sample
+    hx_params_test_t prm = {};
+    std::string err;
+    char msg[96];
+
+    // audio side: n samples in the segments returned by fetch()
+    auto run = [&](uint32_t n)
+    {
+        while (n)
+        {
+            uint32_t seg = params.fetch(prm, n);
+            trace.insert(trace.end(), seg, prm);
+            n -= seg;
+        }
+    };
+    // expected value of a field from sample t0 up to t1 (excluded)
+    auto expect = [&](const char *what, int64_t hx_params_test_t::*f, size_t t0, size_t t1, int64_t v)
+    {
+        for (size_t t = t0; t < t1 && err.empty(); t++)
+        {
+            if (trace[t].*f == v) continue;
+            snprintf(msg, sizeof(msg), "%s: %lld at sample %zu, expected %lld", what, (long long)(trace[t].*f), t, (long long)v);
+            err = msg;
+        }
+    };
+
+    params.at(100); params.edit().a = 1; params.publish();
+    params.edit().b = 2; params.publish();          // immediate, a pending
+    run(64);
+    params.edit().a = 5; params.publish();          // immediate change of a pending field
+    run(64);
+    expect("immediate behind at()", &hx_params_test_t::b, 0, 128, 2);
+    expect("at() applied early", &hx_params_test_t::a, 0, 100, 0);
+    expect("field order", &hx_params_test_t::a, 100, 128, 5);
+
+    for (int k = 0; k < PARAMS_EVENTS; k++)
+    {
+        params.at(1000 + k * 10); params.edit().c = 10 + k; params.publish();
+    }
+    if (params.at(2000) && err.empty()) err = "at() accepted with a full queue";
+    params.edit().c = 99; params.publish();         // no room: held
+    params.edit().b = 7; params.publish();          // not pending: immediate
+    run(1000 - 128 + 35);
+    params.edit().b = 8; params.publish();          // room again, takes the held c along
+    run(256);
+    expect("full queue, future c", &hx_params_test_t::c, 128, 1000, 0);
+    expect("full queue, immediate b", &hx_params_test_t::b, 128, 1000, 7);
+    expect("scheduled c", &hx_params_test_t::c, 1030, 1040, 13);
+    expect("held c", &hx_params_test_t::c, 1070, 1100, 99);
+    expect("immediate b", &hx_params_test_t::b, 1035, 1100, 8);
+    if (trace.size() != params.time() && err.empty()) err = "clock does not count the samples";
+
+    printf("%-28s %s  %s\n", "params_at", err.empty() ? "ok  " : "FAIL", err.empty() ? "at() scheduling" : err.c_str());
+    return err.empty();
+}
+
+/**
+ * @brief The all lane setters of the multi tone stack scheduled with at()
+ *      must give the same output as the setters called at that sample:
+ *      all lanes change together, none of them early.
+ */
+static bool check_multi_at(void)
+{
+    typedef AudioFilterToneStackMulti_F32<HX_CHAIN_MAX_LANES> multi_t;
+    const uint32_t len = 2048, tModel = 1000, tTone = 1500;
+    std::vector<float> in[HX_CHAIN_MAX_LANES], outA[HX_CHAIN_MAX_LANES], outB[HX_CHAIN_MAX_LANES];
+    const float *src[HX_CHAIN_MAX_LANES];
+    float *dstA[HX_CHAIN_MAX_LANES], *dstB[HX_CHAIN_MAX_LANES];
+    multi_t *a = new multi_t, *b = new multi_t;     // scheduled, set at the sample
+    uint32_t seed = 1;
+    char msg[96] = "";
+
+    for (int l = 0; l < HX_CHAIN_MAX_LANES; l++)
+    {
+        in[l].resize(len);
+        for (float &x : in[l]) x = (float)(int32_t)(seed = seed * 1664525u + 1013904223u) * (0.5f / 2147483648.0f);
+        outA[l].assign(len, 0.0f);
+        outB[l].assign(len, 0.0f);
+        src[l] = in[l].data();
+        dstA[l] = outA[l].data();
+        dstB[l] = outB[l].data();
+    }
+    a->at(a->time() + tModel); a->setModel(TONESTACK_BASSMAN);
+    a->at(a->time() + tTone); a->setTone(1.0f, 0.0f, 1.0f);
+    a->process(src, dstA, len);
+
+    auto runB = [&](uint32_t from, uint32_t to)
+    {
+        const float *s[HX_CHAIN_MAX_LANES];
+        float *d[HX_CHAIN_MAX_LANES];
+        for (int l = 0; l < HX_CHAIN_MAX_LANES; l++)
+        {
+            s[l] = src[l] + from;
+            d[l] = dstB[l] + from;
+        }
+        b->process(s, d, to - from);
+    };
+    runB(0, tModel);
+    b->setModel(TONESTACK_BASSMAN);
+    runB(tModel, tTone);
+    b->setTone(1.0f, 0.0f, 1.0f);
+    runB(tTone, len);
+
+    for (int l = 0; l < HX_CHAIN_MAX_LANES && !msg[0]; l++)
+    {
+        for (uint32_t i = 0; i < len; i++)
+        {
+            if (outA[l][i] == outB[l][i]) continue;
+            snprintf(msg, sizeof(msg), "lane %d differs at sample %u", l, i);
+            break;
+        }
+    }
+    delete a;
+    delete b;
+    printf("%-28s %s  %s\n", "tonestack6_at", msg[0] ? "FAIL" : "ok  ", msg[0] ? msg : "all lane setters at()");
+    return !msg[0];
+}
+
+/**
+ * @brief Dry/wet mix of a fused chain stage: a reverb at 0.3 must give
+ *      the dry and wet signals of a separate instance mixed 0.7/0.3,
+ *      back at 1.0 (after the ramp) the wet signal only.
+ */
+static bool check_chain_mix(void)
+{
+    const uint32_t blocks = 96, ramp = 64;  // past the input delay of the reverb, mix 1.0 from block ramp
+    const float ratio = 0.3f;
+    AudioEffectChain_F32 *chain = new AudioEffectChain_F32;
+    AudioEffectPlateReverb_F32 *fx = new AudioEffectPlateReverb_F32, *ref = new AudioEffectPlateReverb_F32;
+    float in[AUDIO_BLOCK_SAMPLES], out[2][AUDIO_BLOCK_SAMPLES], wet[2][AUDIO_BLOCK_SAMPLES];
+    const float *src[2] = {in, NULL}, *srcRef[2] = {in, in};
+    float *dst[2] = {out[0], out[1]}, *dstRef[2] = {wet[0], wet[1]};
+    uint32_t seed = 7;
+    char msg[96] = "";
+
+    chain->mix(chain->add(*fx), ratio);
+    for (uint32_t b = 0; b < blocks && !msg[0]; b++)
+    {
+        for (float &x : in) x = (float)(int32_t)(seed = seed * 1664525u + 1013904223u) * (0.5f / 2147483648.0f);
+        if (b == ramp) chain->mix(0, 1.0f);
+        chain->process(src, dst, AUDIO_BLOCK_SAMPLES);
+        ref->process(srcRef, dstRef, AUDIO_BLOCK_SAMPLES);
+        if (b == ramp) continue;
+        for (int c = 0; c < 2 && !msg[0]; c++)
+        {
+            for (uint32_t i = 0; i < AUDIO_BLOCK_SAMPLES; i++)
+            {
+                float y = b < ramp ? in[i] * (1.0f - ratio) + wet[c][i] * ratio : wet[c][i];
+                if (out[c][i] == y) continue;
+                snprintf(msg, sizeof(msg), "ch %d differs at sample %u", c, b * AUDIO_BLOCK_SAMPLES + i);
+                break;
+            }
+        }
+    }
+    delete chain;
+    delete fx;
+    delete ref;
+    printf("%-28s %s  %s\n", "chain_mix", msg[0] ? "FAIL" : "ok  ", msg[0] ? msg : "reverb stage dry/wet 0.3, 1.0");
+    return !msg[0];
+}
+
+/**
+ * @brief The clock of a bypassed fused chain stage keeps running:
+ *      all stages stay at the time of the processed stream
+ */
+static bool check_chain_clock(void)
+{
+    static const uint32_t chunk[] = {100, 37, 200, AUDIO_BLOCK_SAMPLES};
+    AudioEffectChain_F32 *chain = new AudioEffectChain_F32;
+    AudioFilterToneStackStereo_F32 *tone = new AudioFilterToneStackStereo_F32;
+    AudioEffectPhaser_F32 *phaser = new AudioEffectPhaser_F32;
+    float buf[2][AUDIO_BLOCK_SAMPLES * 2] = {};
+    const float *src[2] = {buf[0], NULL};
+    float *dst[2] = {buf[0], buf[1]};
+    uint32_t t = 0;
+    char msg[96] = "";
+
+    chain->add(*tone);
+    uint8_t stage = chain->add(*phaser);
+    for (uint32_t i = 0; i < sizeof(chunk) / sizeof(chunk[0]) && !msg[0]; i++)
+    {
+        chain->bypass(stage, i < 2);
+        chain->process(src, dst, chunk[i]);
+        t += chunk[i];
+        if (tone->time() != t || phaser->time() != t)
+            snprintf(msg, sizeof(msg), "at %u: tone stack %u, bypassed phaser %u", t, tone->time(), phaser->time());
+    }
+    delete chain;
+    delete tone;
+    delete phaser;
+    printf("%-28s %s  %s\n", "chain_clock", msg[0] ? "FAIL" : "ok  ", msg[0] ? msg : "bypassed stage in step");
+    return !msg[0];
+}
+
+/**
+ * @brief MonoToStereo engine, quality, matrix and output count scheduled
+ *      with at() must give the same output as the setters called at that
+ *      sample, the output count at the first block starting after t
+ */
+static bool check_m2s_at(void)
+{
+    const uint32_t blocks = 24, outs = 3;
+    const uint32_t tSpread = 200, tEngine = 300, tQuality = 700, tMulti = 1000, tMatrix = 1800;
+    const uint32_t cut[] = {tSpread, tEngine, tQuality, 1024, tMatrix};    // immediate calls of B
+    AudioEffectMonoToStereo_F32 *a = new AudioEffectMonoToStereo_F32, *b = new AudioEffectMonoToStereo_F32;
+    float in[AUDIO_BLOCK_SAMPLES], outA[outs][AUDIO_BLOCK_SAMPLES], outB[outs][AUDIO_BLOCK_SAMPLES];
+    const float *src[1] = {in};
+    float *dstA[outs] = {outA[0], outA[1], outA[2]};
+    uint32_t seed = 3, next = 0;
+    char msg[96] = "";
+
+    auto set = [](AudioEffectMonoToStereo_F32 *fx, uint32_t i)
+    {
+        switch (i)
+        {
+            case 0: fx->setSpread(1.0f); break;
+            case 1: fx->setEngine(MONOTOSTEREO_ENGINE_VELVET); break;
+            case 2: fx->setQuality(MONOTOSTEREO_QUALITY_LOW); break;
+            case 3: fx->setMultiOutput(outs); break;
+            default: fx->setMatrix(0, MONOTOSTEREO_TAP_NET1_Q2, 0.5f); break;
+        }
+    };
+    const uint32_t when[] = {tSpread, tEngine, tQuality, tMulti, tMatrix};
+    for (uint32_t i = 0; i < 5; i++)
+    {
+        a->at(a->time() + when[i]);
+        set(a, i);
+    }
+    for (uint32_t blk = 0; blk < blocks && !msg[0]; blk++)
+    {
+        const uint32_t t0 = blk * AUDIO_BLOCK_SAMPLES, nOut = t0 >= cut[3] ? outs : 2;
+        for (float &x : in) x = (float)(int32_t)(seed = seed * 1664525u + 1013904223u) * (0.5f / 2147483648.0f);
+        a->process(src, dstA, AUDIO_BLOCK_SAMPLES);
+        for (uint32_t pos = 0, len; pos < AUDIO_BLOCK_SAMPLES; pos += len)
+        {
+            const float *s[1] = {in + pos};
+            float *d[outs] = {outB[0] + pos, outB[1] + pos, outB[2] + pos};
+            if (next < 5 && cut[next] == t0 + pos) set(b, next++);
+            len = AUDIO_BLOCK_SAMPLES - pos;
+            if (next < 5 && cut[next] < t0 + AUDIO_BLOCK_SAMPLES) len = cut[next] - t0 - pos;
+            b->process(s, d, len);
+        }
+        for (uint32_t c = 0; c < nOut && !msg[0]; c++)
+        {
+            for (uint32_t i = 0; i < AUDIO_BLOCK_SAMPLES; i++)
+            {
+                if (outA[c][i] == outB[c][i]) continue;
+                snprintf(msg, sizeof(msg), "output %u differs at sample %u", c, t0 + i);
+                break;
+            }
+        }
+    }
+    delete a;
+    delete b;
+    printf("%-28s %s  %s\n", "m2s_at", msg[0] ? "FAIL" : "ok  ", msg[0] ? msg : "engine, quality, outputs, matrix at()");
+    return !msg[0];
+}
+
+/**
+ * @brief Stereo phaser driven by two modulation bus channels must give
+ *      the same L/R outputs as two mono phasers on the same channels
+ */
+static bool check_phaser_bus(void)
+{
+    const uint32_t blocks = 64;
+    static const uint32_t chunk[] = {AUDIO_BLOCK_SAMPLES, 37, 91, 200};  // the bus cycle spans the calls
+    AudioEffectPhaserStereo *st = new AudioEffectPhaserStereo;
+    AudioEffectPhaser *mono[2] = {new AudioEffectPhaser, new AudioEffectPhaser};
+    float bus[2][AUDIO_BLOCK_SAMPLES];
+    std::vector<int16_t> in[2], outSt[2], outMono[2];
+    uint32_t seed = 11, pos = 0, k = 0;
+    char msg[96] = "";
+
+    for (uint32_t i = 0; i < AUDIO_BLOCK_SAMPLES; i++)       // a bus cycle: L ramp, R a quarter later
+    {
+        bus[0][i] = (float)i / AUDIO_BLOCK_SAMPLES;
+        bus[1][i] = (float)((i + AUDIO_BLOCK_SAMPLES / 4) % AUDIO_BLOCK_SAMPLES) / AUDIO_BLOCK_SAMPLES;
+    }
+    for (int c = 0; c < 2; c++)
+    {
+        in[c].resize(blocks * AUDIO_BLOCK_SAMPLES);
+        for (int16_t &x : in[c]) x = (int16_t)((seed = seed * 1664525u + 1013904223u) >> 18);
+        outSt[c].assign(in[c].size(), 0);
+        outMono[c].assign(in[c].size(), 0);
+        mono[c]->feedback(0.5f);
+        mono[c]->modulation(bus[c]);
+    }
+    st->feedback(0.5f);
+    st->modulation(bus[0], bus[1]);
+    while (pos < in[0].size())
+    {
+        uint32_t n = std::min((uint32_t)in[0].size() - pos, chunk[k++ % 4]);
+        const int16_t *src[3] = {&in[0][pos], &in[1][pos], NULL};
+        int16_t *dst[2] = {&outSt[0][pos], &outSt[1][pos]};
+        st->process(src, dst, n);
+        for (int c = 0; c < 2; c++)
+        {
+            const int16_t *s[2] = {&in[c][pos], NULL};
+            int16_t *d[1] = {&outMono[c][pos]};
+            mono[c]->process(s, d, n);
+        }
+        pos += n;
+    }
+    for (int c = 0; c < 2 && !msg[0]; c++)
+    {
+        for (size_t i = 0; i < in[c].size(); i++)
+        {
+            if (outSt[c][i] == outMono[c][i]) continue;
+            snprintf(msg, sizeof(msg), "ch %d differs at sample %zu: %d vs %d", c, i, outSt[c][i], outMono[c][i]);
+            break;
+        }
+    }
+    delete st;
+    delete mono[0];
+    delete mono[1];
+    printf("%-28s %s  %s\n", "phaser_st_bus", msg[0] ? "FAIL" : "ok  ", msg[0] ? msg : "L/R bus channels vs 2 mono phasers");
+    return !msg[0];
+}
+
+/**
+ * @brief A modulation bus channel with followers linked to another one:
+ *      the followers keep their phase offset to it and keep running
+ */
+static bool check_modbus_link(void)
+{
+    AudioModulationBus *bus = new AudioModulationBus;
+    char msg[96] = "";
+
+    bus->lfo(0, MODBUS_WAVE_RAMP, 100.0f);
+    bus->lfo(2, MODBUS_WAVE_RAMP, 37.0f);
+    bus->link(3, 2, 45.0f, MODBUS_WAVE_RAMP);
+    bus->update();
+    const uint32_t d = bus->phase(3) - bus->phase(2);
+    bus->link(2, 0, 180.0f, MODBUS_WAVE_RAMP);
+    for (int i = 0; i < 4 && !msg[0]; i++)
+    {
+        bus->update();
+        if (bus->phase(3) - bus->phase(2) != d || bus->phase(2) - bus->phase(0) != 0x80000000u)
+            snprintf(msg, sizeof(msg), "block %d: phases %08x %08x %08x", i, bus->phase(0), bus->phase(2), bus->phase(3));
+    }
+    delete bus;
+    printf("%-28s %s  %s\n", "modbus_link", msg[0] ? "FAIL" : "ok  ", msg[0] ? msg : "followers of a relinked channel");
+    return !msg[0];
+}
+
+/**
+ * @brief MonoToStereo at spread = 1, pan = centre, measured with sine probes
+ *      on the DFT bins of the analysis window, 1/6 octave apart: the level 
+ *      of the mono sum M = (L + R)/2 relative to the input and the phase 
+ *      difference between M and the side signal S = (L - R)/2 (the I/Q pair
+ *      of the Hilbert engine). Limits as stated in the MonoToStereo README.
+ */
+typedef struct
+{
+    const char *name;
+    const char *spec;
+    float fLo, fHi;         // measured band
+    float monoMin, monoMax; // mono sum level, dB
+    float phaseTol;         // |M/S phase - 90deg|, deg, 0 = not checked
+}hx_m2s_case_t;
+
+#define M2S_SETTLE      16384   // samples before the analysis window, the allpass network delay
+#define M2S_WINDOW      16384   // analysis window, bin = 2.7Hz @ 44.1kHz
+
+static bool check_m2s(const hx_m2s_case_t &mc)
+{
+    const double fs = AUDIO_SAMPLE_RATE_EXACT;
+    double monoLo = 1e9, monoHi = -1e9, phaseErr = 0.0, fWorst = 0.0;
+    float in[AUDIO_BLOCK_SAMPLES], outBuf[HX_CHAIN_MAX_CH][AUDIO_BLOCK_SAMPLES];
+    const float *inPtr[HX_CHAIN_MAX_CH] = {in, in};
+    float *outPtr[HX_CHAIN_MAX_CH] = {outBuf[0], outBuf[1]};
+    uint32_t lastBin = 0;
+
+    for (double f = mc.fLo; lastBin < (uint32_t)(mc.fHi * M2S_WINDOW / fs); f *= pow(2.0, 1.0 / 6.0))
+    {
+        // inside the band, the last probe at its top
+        uint32_t bin = f < mc.fHi ? (uint32_t)ceil(f * M2S_WINDOW / fs) : (uint32_t)(mc.fHi * M2S_WINDOW / fs);
+        if (bin == lastBin) continue;
+        lastBin = bin;
+        double w = 2.0 * M_PI * bin / M2S_WINDOW;
+        double mRe = 0.0, mIm = 0.0, sRe = 0.0, sIm = 0.0;
+        HxChain chain;
+        chain.add(mc.spec);
+        if (!chain.build(1))
+        {
+            printf("%-28s FAIL  %s\n", mc.name, chain.error());
+            return false;
+        }
+        for (uint32_t pos = 0; pos < M2S_SETTLE + M2S_WINDOW; pos += AUDIO_BLOCK_SAMPLES)
+        {
+            for (uint32_t i = 0; i < AUDIO_BLOCK_SAMPLES; i++) in[i] = 0.5f * (float)cos(w * (pos + i));
+            chain.process(inPtr, outPtr);
+            if (pos < M2S_SETTLE) continue;
+            for (uint32_t i = 0; i < AUDIO_BLOCK_SAMPLES; i++)
+            {
+                double c = cos(w * (pos + i)), s = -sin(w * (pos + i));
+                double m = 0.5 * ((double)outBuf[0][i] + outBuf[1][i]), d = 0.5 * ((double)outBuf[0][i] - outBuf[1][i]);
+                mRe += m * c; mIm += m * s;
+                sRe += d * c; sIm += d * s;
+            }
+        }
+        // input amplitude 0.5, bin of a real cosine 0.25 * M2S_WINDOW
+        double mono = 20.0 * log10(hypot(mRe, mIm) / (0.25 * M2S_WINDOW));
+        monoLo = std::min(monoLo, mono);
+        monoHi = std::max(monoHi, mono);
+        if (opt.verbose) printf("%30s%7.1fHz  mono %+6.2fdB", "", bin * fs / M2S_WINDOW, mono);
+        if (mc.phaseTol > 0.0f)
+        {
+            double ph = fabs(atan2(mIm * sRe - mRe * sIm, mRe * sRe + mIm * sIm)) * 180.0 / M_PI;
+            if (fabs(ph - 90.0) > phaseErr)
+            {
+                phaseErr = fabs(ph - 90.0);
+                fWorst = bin * fs / M2S_WINDOW;
+            }
+            if (opt.verbose) printf("  M/S %6.2fdeg", ph);
+        }
+        if (opt.verbose) printf("\n");
+    }
+    bool pass = monoLo >= mc.monoMin && monoHi <= mc.monoMax && phaseErr <= mc.phaseTol;
+    printf("%-28s %s  mono %+.2f..%+.2fdB (limit %+.2f..%+.2fdB)", mc.name, pass ? "ok  " : "FAIL", 
+           monoLo, monoHi, mc.monoMin, mc.monoMax);
+    if (mc.phaseTol > 0.0f) printf("  M/S 90+-%.3fdeg @%.0fHz (limit %.2fdeg)", phaseErr, fWorst, mc.phaseTol);
+    printf("\n");
+    return pass;
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<hx_golden_case_t> cases;
+    int c, failed = 0, done = 0;
+
+    opt.dir = "golden";
+    opt.keepDir = NULL;
+    opt.filter = NULL;
+    opt.update = false;
+    opt.verbose = false;
+    opt.list = false;
+    opt.fused = false;
+
+    while ((c = getopt(argc, argv, "d:k:f:uvlFB:h")) != -1)
+    {
+        switch (c)
+        {
+            case 'd': opt.dir = optarg; break;
+            case 'k': opt.keepDir = optarg; break;
+            case 'f': opt.filter = optarg; break;
+            case 'u': opt.update = true; break;
+            case 'v': opt.verbose = true; break;
+            case 'l': opt.list = true; break;
+            case 'F': opt.fused = true; break;
+            case 'B':
+                for (char *p = optarg, *end; *p; p = *end ? end + 1 : end)
+                {
+                    uint32_t len = strtoul(p, &end, 10);
+                    if (end == p || !len || (*end && *end != ',')) 
+                    {
+                        fprintf(stderr, "invalid chunk list: %s\n", optarg);
+                        return 1;
+                    }
+                    opt.chunks.push_back(len);
+                }
+                opt.fused = true;
+                break;
+            default:
+                fprintf(stderr,
+                    "usage: %s [options]\n"
+                    "  -d DIR    reference directory, default: golden\n"
+                    "  -f TEXT   run only the cases containing TEXT\n"
+                    "  -u        write new references instead of comparing\n"
+                    "  -k DIR    keep the renders of the failed cases in DIR\n"
+                    "  -v        print the error of every stimulus segment\n"
+                    "  -F        render the F32 cases through a fused chain\n"
+                    "  -B LIST   as -F, process() called with the lengths of LIST in turn,\n"
+                    "            ie. 8,37,4096: the result must not depend on the chunking\n"
+                    "  -l        list the cases\n", argv[0]);
+                return c == 'h' ? 0 : 1;
+        }
+    }
+    make_cases(cases);
+    if (opt.list)
+    {
+        for (const hx_golden_case_t &gc : cases) printf("%-28s %s\n", gc.name.c_str(), gc.spec);
+        return 0;
+    }
+    if (AUDIO_BLOCK_SAMPLES != GOLDEN_BLOCK)
+    {
+        printf("warning: built with %d sample blocks, the references use %d\n", AUDIO_BLOCK_SAMPLES, GOLDEN_BLOCK);
+    }
+    make_stimuli();
+
+    for (const hx_golden_case_t &gc : cases)
+    {
+        std::vector<float> out[HX_CHAIN_MAX_CH];
+        uint8_t outCh = 0;
+        std::string err;
+
+        if (opt.filter && !strstr(gc.name.c_str(), opt.filter)) continue;
+        if (opt.fused && !HxChain::fusable(gc.spec)) continue;
+        if (opt.update && gc.ref) continue;     // compare only
+        done++;
+        if (!render(gc, out, outCh, err))
+        {
+            printf("%-28s FAIL  %s\n", gc.name.c_str(), err.c_str());
+            failed++;
+            continue;
+        }
+        if (opt.update)
+        {
+            std::string path = std::string(opt.dir) + "/" + gc.name + ".wav";
+            if (!save(path, out, outCh, HX_SAMPLE_F32)) return 1;
+            printf("%-28s -> %s\n", gc.name.c_str(), path.c_str());
+            continue;
+        }
+        if (!compare(gc, out, outCh))
+        {
+            failed++;
+            if (opt.keepDir) save(std::string(opt.keepDir) + "/" + gc.name + ".wav", out, outCh, HX_SAMPLE_F32);
+        }
+    }
+    if (!opt.update && !opt.fused && (!opt.filter || strstr("params_at", opt.filter)))
+    {
+        done++;
+        if (!check_params()) failed++;
+    }
+    if (!opt.update && !opt.fused && (!opt.filter || strstr("tonestack6_at", opt.filter)))
+    {
+        done++;
+        if (!check_multi_at()) failed++;
+    }
+    if (!opt.update && !opt.fused && (!opt.filter || strstr("chain_mix", opt.filter)))
+    {
+        done++;
+        if (!check_chain_mix()) failed++;
+    }
+    if (!opt.update && !opt.fused && (!opt.filter || strstr("chain_clock", opt.filter)))
+    {
+        done++;
+        if (!check_chain_clock()) failed++;
+    }
+    if (!opt.update && !opt.fused && (!opt.filter || strstr("m2s_at", opt.filter)))
+    {
+        done++;
+        if (!check_m2s_at()) failed++;
+    }
+    if (!opt.update && !opt.fused && (!opt.filter || strstr("phaser_st_bus", opt.filter)))
+    {
+        done++;
+        if (!check_phaser_bus()) failed++;
+    }
+    if (!opt.update && !opt.fused && (!opt.filter || strstr("modbus_link", opt.filter)))
+    {
+        done++;
+        if (!check_modbus_link()) failed++;
+    }
+    static const hx_m2s_case_t m2s[] = 
+    {
+        {"m2s_allpass_low", "mono2stereo,engine=allpass,quality=low,spread=1", 100.0f, 10000.0f, -0.1f, 3.1f, 0.0f},
+        {"m2s_allpass_mid", "mono2stereo,engine=allpass,quality=mid,spread=1", 100.0f, 10000.0f, -0.1f, 3.1f, 0.0f},
+        {"m2s_allpass_high", "mono2stereo,engine=allpass,quality=high,spread=1", 100.0f, 10000.0f, -0.1f, 3.1f, 0.0f},
+        {"m2s_velvet", "mono2stereo,engine=velvet,spread=1", 20.0f, 20000.0f, -0.05f, 0.05f, 0.0f},
+        {"m2s_hilbert", "mono2stereo,engine=hilbert,spread=1", 20.0f, 21000.0f, -0.05f, 0.05f, 0.75f},
+    };
+    for (const hx_m2s_case_t &mc : m2s)
+    {
+        if (opt.update || opt.fused || (opt.filter && !strstr(mc.name, opt.filter))) continue;
+        done++;
+        if (!check_m2s(mc)) failed++;
+    }
+    if (!opt.update) printf("%d of %d cases passed\n", done - failed, done);
+    return failed ? 1 : 0;
+}
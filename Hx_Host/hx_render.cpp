@@ -0,0 +1,262 @@
+/*  hx_render - offline batch renderer, runs audio files through a chain of
+ *  the t40fx effects using the same code as the Teensy builds.
+ *
+ *  Author: Piotr Zapart
+ *          www.hexefx.com
+ *
+ * Copyright (c) 2021 by Piotr Zapart
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "hx_chain.h"
+#include "hx_wav.h"
+
+typedef struct
+{
+    std::vector<const char *> effects;
+    std::vector<const char *> inputs;
+    const char *outPath;
+    bool outIsDir;
+    unsigned int threads;
+    float tailSec;
+    int outFmt;             // hx_sample_fmt_e, -1 = same as the input
+    uint16_t rawCh;
+    uint32_t rawRate;
+    bool quiet;
+    bool usage;
+    bool fused;             // one AudioEffectChain_F32 node
+}hx_render_opts_t;
+
+static hx_render_opts_t opt;
+static std::mutex logLock;
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+        "usage: %s [options] -e effect[,param=value...] [-e ...] input...\n"
+        "  -e SPEC   append an effect stage, stages run in the given order\n"
+        "  -o PATH   output file (single input) or directory, default: <input>_hx.wav\n"
+        "  -j N      worker threads, default: number of cores\n"
+        "  -t SEC    render SEC seconds of tail after the end of the input\n"
+        "  -f FMT    output format s16, s24, s32, f32, default: input format\n"
+        "  -c N      channels of raw float inputs (.raw, .f32), default 1\n"
+        "  -r HZ     sample rate of raw float inputs, default 44100\n"
+        "  -u        print the processor usage of each stage\n"
+        "  -F        run the stages fused in one node (F32 effects only)\n"
+        "  -q        quiet\n"
+        "effects (compiled for fs = %.2fHz):\n", name, AUDIO_SAMPLE_RATE_EXACT);
+    HxChain::list(stderr);
+}
+
+static std::string out_name(const char *in)
+{
+    std::string base = in;
+    size_t slash = base.rfind('/');
+    if (opt.outPath && !opt.outIsDir) return opt.outPath;
+    if (slash != std::string::npos) base = base.substr(slash + 1);
+    size_t dot = base.rfind('.');
+    std::string ext = hx_is_raw(in) ? base.substr(dot) : ".wav";
+    if (dot != std::string::npos) base = base.substr(0, dot);
+    base += "_hx" + ext;
+    if (opt.outPath) return std::string(opt.outPath) + "/" + base;
+    if (slash != std::string::npos) return std::string(in, slash + 1) + base;
+    return base;
+}
+
+static bool render(const char *path)
+{
+    HxAudioFile in, out;
+    HxChain chain;
+    float inBuf[HX_CHAIN_MAX_CH][AUDIO_BLOCK_SAMPLES], outBuf[HX_CHAIN_MAX_CH][AUDIO_BLOCK_SAMPLES];
+    float *inPtr[HX_CHAIN_MAX_CH] = {inBuf[0], inBuf[1]};
+    float *outPtr[HX_CHAIN_MAX_CH] = {outBuf[0], outBuf[1]};
+    std::string outPath = out_name(path);
+    size_t total, pos;
+
+    auto t0 = std::chrono::steady_clock::now();
+    if (!in.open(path, opt.rawCh, opt.rawRate))
+    {
+        std::lock_guard<std::mutex> l(logLock);
+        fprintf(stderr, "%s: %s\n", path, in.error());
+        return false;
+    }
+    if (in.channels() > HX_CHAIN_MAX_CH)
+    {
+        std::lock_guard<std::mutex> l(logLock);
+        fprintf(stderr, "%s: %u channels, only mono and stereo files are supported\n", path, in.channels());
+        return false;
+    }
+    if (outPath == path)
+    {
+        std::lock_guard<std::mutex> l(logLock);
+        fprintf(stderr, "%s: output would overwrite the input\n", path);
+        return false;
+    }
+    for (const char *e : opt.effects) chain.add(e);
+    chain.build(in.channels(), opt.fused);
+    total = in.frames() + (size_t)(opt.tailSec * in.rate());
+    if (!out.create(outPath.c_str(), total, chain.channelsOut(), in.rate(),
+                    opt.outFmt < 0 ? in.format() : (hx_sample_fmt_e)opt.outFmt))
+    {
+        std::lock_guard<std::mutex> l(logLock);
+        fprintf(stderr, "%s: %s\n", outPath.c_str(), out.error());
+        return false;
+    }
+    for (pos = 0; pos < total; pos += AUDIO_BLOCK_SAMPLES)
+    {
+        in.read(pos, AUDIO_BLOCK_SAMPLES, inPtr);
+        chain.process(inPtr, outPtr);
+        out.write(pos, AUDIO_BLOCK_SAMPLES, outPtr);
+    }
+    out.close();
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    std::lock_guard<std::mutex> l(logLock);
+    if (fabsf(in.rate() - AUDIO_SAMPLE_RATE_EXACT) > 0.01f * AUDIO_SAMPLE_RATE_EXACT)
+    {
+        fprintf(stderr, "%s: warning, file rate %uHz, effects compiled for %.0fHz (make FS=...)\n",
+                path, in.rate(), AUDIO_SAMPLE_RATE_EXACT);
+    }
+    if (!opt.quiet)
+    {
+        printf("%s -> %s: %.2fs audio in %.3fs, %.1fx realtime\n", path, outPath.c_str(),
+               (double)total / in.rate(), sec, (double)total / in.rate() / sec);
+    }
+    if (opt.usage) chain.usage(stdout);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    int c;
+    struct stat st;
+
+    opt.outPath = NULL;
+    opt.outIsDir = false;
+    opt.threads = std::thread::hardware_concurrency();
+    opt.tailSec = 0.0f;
+    opt.outFmt = -1;
+    opt.rawCh = 1;
+    opt.rawRate = 44100;
+    opt.quiet = false;
+    opt.usage = false;
+    opt.fused = false;
+
+    while ((c = getopt(argc, argv, "e:o:j:t:f:c:r:uqFh")) != -1)
+    {
+        switch (c)
+        {
+            case 'e': opt.effects.push_back(optarg); break;
+            case 'o': opt.outPath = optarg; break;
+            case 'j': opt.threads = atoi(optarg); break;
+            case 't': opt.tailSec = atof(optarg); break;
+            case 'c': opt.rawCh = atoi(optarg); break;
+            case 'r': opt.rawRate = atoi(optarg); break;
+            case 'u': opt.usage = true; break;
+            case 'F': opt.fused = true; break;
+            case 'q': opt.quiet = true; break;
+            case 'f':
+                if (!strcmp(optarg, "s16")) opt.outFmt = HX_SAMPLE_S16;
+                else if (!strcmp(optarg, "s24")) opt.outFmt = HX_SAMPLE_S24;
+                else if (!strcmp(optarg, "s32")) opt.outFmt = HX_SAMPLE_S32;
+                else if (!strcmp(optarg, "f32")) opt.outFmt = HX_SAMPLE_F32;
+                else
+                {
+                    fprintf(stderr, "unknown output format %s\n", optarg);
+                    return 1;
+                }
+                break;
+            default:
+                usage(argv[0]);
+                return c == 'h' ? 0 : 1;
+        }
+    }
+    for (c = optind; c < argc; c++) opt.inputs.push_back(argv[c]);
+    if (opt.inputs.empty())
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    if (opt.outPath)
+    {
+        opt.outIsDir = stat(opt.outPath, &st) == 0 && S_ISDIR(st.st_mode);
+        if (!opt.outIsDir && opt.inputs.size() > 1)
+        {
+            fprintf(stderr, "-o must be a directory for multiple inputs\n");
+            return 1;
+        }
+    }
+    // check the chain once for both input widths before starting the workers
+    for (uint8_t ch = 1; ch <= HX_CHAIN_MAX_CH; ch++)
+    {
+        HxChain probe;
+        for (const char *e : opt.effects)
+        {
+            if (!probe.add(e))
+            {
+                fprintf(stderr, "%s\n", probe.error());
+                return 1;
+            }
+        }
+        if (!probe.build(ch, opt.fused))
+        {
+            fprintf(stderr, "%s\n", probe.error());
+            return 1;
+        }
+    }
+
+    // worker pool: each thread owns its audio graph and takes the next file
+    std::atomic<size_t> next(0);
+    std::atomic<int> failed(0);
+    std::vector<std::thread> workers;
+    if (opt.threads < 1) opt.threads = 1;
+    if (opt.threads > opt.inputs.size()) opt.threads = opt.inputs.size();
+    auto t0 = std::chrono::steady_clock::now();
+    for (unsigned int t = 0; t < opt.threads; t++)
+    {
+        workers.emplace_back([&]()
+        {
+            size_t i;
+            while ((i = next++) < opt.inputs.size())
+            {
+                if (!render(opt.inputs[i])) failed++;
+            }
+        });
+    }
+    for (std::thread &w : workers) w.join();
+    if (!opt.quiet && opt.inputs.size() > 1)
+    {
+        double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        printf("%zu files, %u threads, %.3fs\n", opt.inputs.size(), opt.threads, sec);
+    }
+    return failed ? 2 : 0;
+}
@@ -0,0 +1,280 @@
+/*  Memory mapped WAV / raw float file access for the host tools
+ *
+ *  Author: Piotr Zapart
+ *          www.hexefx.com
+ *
+ * Copyright (c) 2021 by Piotr Zapart
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <fcntl.h>
+#include <math.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "hx_wav.h"
+
+// all supported hosts are little endian, the WAV fields are read in place
+#define WAV_FORMAT_PCM          0x0001
+#define WAV_FORMAT_FLOAT        0x0003
+#define WAV_FORMAT_EXTENSIBLE   0xFFFE
+#define WAV_HEADER_LEN          44
+
+static uint16_t rd16(const uint8_t *p) { return p[0] | (p[1] << 8);}
+static uint32_t rd32(const uint8_t *p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);}
+static void wr16(uint8_t *p, uint16_t v) { p[0] = v; p[1] = v >> 8;}
+static void wr32(uint8_t *p, uint32_t v) { p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;}
+
+bool hx_is_raw(const char *path)
+{
+    const char *ext = strrchr(path, '.');
+    return ext && (!strcmp(ext, ".raw") || !strcmp(ext, ".f32"));
+}
+
+HxAudioFile::HxAudioFile()
+{
+    fd = -1;
+    map = NULL;
+    mapLen = 0;
+    data = NULL;
+    numFrames = 0;
+    numCh = 0;
+    sampleRate = 0;
+    fmt = HX_SAMPLE_F32;
+    bytesPerSample = 4;
+    err = "";
+}
+
+HxAudioFile::~HxAudioFile()
+{
+    close();
+}
+
+bool HxAudioFile::fail(const char *msg)
+{
+    close();
+    err = msg;
+    return false;
+}
+
+void HxAudioFile::close()
+{
+    if (map) munmap(map, mapLen);
+    if (fd >= 0) ::close(fd);
+    map = NULL;
+    mapLen = 0;
+    data = NULL;
+    fd = -1;
+}
+
+bool HxAudioFile::open(const char *path, uint16_t rawCh, uint32_t rawRate)
+{
+    struct stat st;
+    const uint8_t *p, *end;
+    uint16_t tag = 0, bits = 0, align = 0;
+    bool fmtFound = false;
+
+    close();
+    fd = ::open(path, O_RDONLY);
+    if (fd < 0) return fail("cannot open the file");
+    if (fstat(fd, &st) < 0 || st.st_size == 0) return fail("empty file");
+    mapLen = st.st_size;
+    map = (uint8_t *)mmap(NULL, mapLen, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        map = NULL;
+        return fail("mmap failed");
+    }
+    madvise(map, mapLen, MADV_SEQUENTIAL);
+
+    if (hx_is_raw(path))
+    {
+        if (!rawCh) return fail("raw file channel count not set");
+        fmt = HX_SAMPLE_F32;
+        bytesPerSample = 4;
+        numCh = rawCh;
+        sampleRate = rawRate;
+        data = map;
+        numFrames = mapLen / (4 * rawCh);
+        return true;
+    }
+    if (mapLen < 12 || memcmp(map, "RIFF", 4) || memcmp(map + 8, "WAVE", 4)) return fail("not a WAV file");
+    p = map + 12;
+    end = map + mapLen;
+    while (p + 8 <= end)
+    {
+        uint32_t len = rd32(p + 4);
+        const uint8_t *body = p + 8;
+        size_t avail = end - body;
+        if (!memcmp(p, "fmt ", 4) && len >= 16 && avail >= 16)
+        {
+            tag = rd16(body);
+            numCh = rd16(body + 2);
+            sampleRate = rd32(body + 4);
+            align = rd16(body + 12);
+            bits = rd16(body + 14);
+            if (tag == WAV_FORMAT_EXTENSIBLE && len >= 26 && avail >= 26) tag = rd16(body + 24);   // sub format GUID
+            fmtFound = true;
+        }
+        else if (!memcmp(p, "data", 4))
+        {
+            if (!fmtFound) return fail("data chunk before the fmt chunk");
+            data = (uint8_t *)body;
+            if (len > avail) len = avail;           // truncated file or streamed header
+            if (tag == WAV_FORMAT_PCM && bits == 16) fmt = HX_SAMPLE_S16;
+            else if (tag == WAV_FORMAT_PCM && bits == 24) fmt = HX_SAMPLE_S24;
+            else if (tag == WAV_FORMAT_PCM && bits == 32) fmt = HX_SAMPLE_S32;
+            else if (tag == WAV_FORMAT_FLOAT && bits == 32) fmt = HX_SAMPLE_F32;
+            else return fail("unsupported sample format");
+            bytesPerSample = bits / 8;
+            if (!numCh || align != numCh * bytesPerSample) return fail("invalid block align");
+            numFrames = len / align;
+            return true;
+        }
+        p = body + len + (len & 1);                 // chunks are word aligned
+    }
+    return fail("no data chunk");
+}
+
+bool HxAudioFile::create(const char *path, size_t frames, uint16_t channels, uint32_t rate, hx_sample_fmt_e f)
+{
+    bool raw = hx_is_raw(path);
+    size_t header, dataLen;
+
+    close();
+    if (raw) f = HX_SAMPLE_F32;
+    fmt = f;
+    bytesPerSample = (f == HX_SAMPLE_S16) ? 2 : ((f == HX_SAMPLE_S24) ? 3 : 4);
+    numCh = channels;
+    numFrames = frames;
+    sampleRate = rate;
+    header = raw ? 0 : WAV_HEADER_LEN;
+    dataLen = frames * channels * bytesPerSample;
+    if (!raw && dataLen > 0xFFFFFFFFu - WAV_HEADER_LEN) return fail("output exceeds the 4GB WAV limit");
+    mapLen = header + dataLen;
+
+    fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return fail("cannot create the file");
+    if (ftruncate(fd, mapLen) < 0) return fail("cannot resize the file");
+    if (mapLen == 0) return true;
+    map = (uint8_t *)mmap(NULL, mapLen, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        map = NULL;
+        return fail("mmap failed");
+    }
+    data = map + header;
+    if (raw) return true;
+
+    memcpy(map, "RIFF", 4);
+    wr32(map + 4, mapLen - 8);
+    memcpy(map + 8, "WAVEfmt ", 8);
+    wr32(map + 16, 16);
+    wr16(map + 20, f == HX_SAMPLE_F32 ? WAV_FORMAT_FLOAT : WAV_FORMAT_PCM);
+    wr16(map + 22, channels);
+    wr32(map + 24, rate);
+    wr32(map + 28, rate * channels * bytesPerSample);
+    wr16(map + 32, channels * bytesPerSample);
+    wr16(map + 34, bytesPerSample * 8);
+    memcpy(map + 36, "data", 4);
+    wr32(map + 40, dataLen);
+    return true;
+}
+
+void HxAudioFile::read(size_t pos, size_t n, float *const *dst) const
+{
+    size_t i, valid = 0;
+    uint16_t c;
+    const uint8_t *p;
+
+    if (pos < numFrames) valid = (numFrames - pos < n) ? numFrames - pos : n;
+    p = data + pos * numCh * bytesPerSample;
+    for (i = 0; i < valid; i++)
+    {
+        for (c = 0; c < numCh; c++)
+        {
+            switch (fmt)
+            {
+                case HX_SAMPLE_S16:
+                    dst[c][i] = (int16_t)rd16(p) * (1.0f / 32768.0f);
+                    break;
+                case HX_SAMPLE_S24:
+                    dst[c][i] = ((int32_t)((uint32_t)(p[0] | (p[1] << 8) | (p[2] << 16)) << 8) >> 8) * (1.0f / 8388608.0f);
+                    break;
+                case HX_SAMPLE_S32:
+                    dst[c][i] = (float)((int32_t)rd32(p) * (1.0 / 2147483648.0));
+                    break;
+                case HX_SAMPLE_F32:
+                    memcpy(&dst[c][i], p, 4);
+                    break;
+            }
+            p += bytesPerSample;
+        }
+    }
+    for (c = 0; c < numCh; c++)
+    {
+        if (valid < n) memset(&dst[c][valid], 0, (n - valid) * sizeof(float));
+    }
+}
+
+void HxAudioFile::write(size_t pos, size_t n, const float *const *src)
+{
+    size_t i;
+    uint16_t c;
+    uint8_t *p;
+    float s;
+    int32_t v;
+
+    if (pos >= numFrames) return;
+    if (n > numFrames - pos) n = numFrames - pos;
+    p = data + pos * numCh * bytesPerSample;
+    for (i = 0; i < n; i++)
+    {
+        for (c = 0; c < numCh; c++)
+        {
+            s = src[c][i];
+            switch (fmt)
+            {
+                case HX_SAMPLE_S16:
+                    v = lrintf(s * 32768.0f);
+                    v = v > 32767 ? 32767 : (v < -32768 ? -32768 : v);
+                    wr16(p, v);
+                    break;
+                case HX_SAMPLE_S24:
+                    v = lrintf(s * 8388608.0f);
+                    v = v > 8388607 ? 8388607 : (v < -8388608 ? -8388608 : v);
+                    p[0] = v; p[1] = v >> 8; p[2] = v >> 16;
+                    break;
+                case HX_SAMPLE_S32:
+                {
+                    double d = rint(s * 2147483648.0);
+                    d = d > 2147483647.0 ? 2147483647.0 : (d < -2147483648.0 ? -2147483648.0 : d);
+                    wr32(p, (uint32_t)(int32_t)d);
+                    break;
+                }
+                case HX_SAMPLE_F32:
+                    memcpy(p, &s, 4);
+                    break;
+            }
+            p += bytesPerSample;
+        }
+    }
+}
@@ -0,0 +1,107 @@
+/*  Memory mapped WAV / raw float file access for the host tools
+ *
+ *  Author: Piotr Zapart
+ *          www.hexefx.com
+ *
+ * Copyright (c) 2021 by Piotr Zapart
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _HX_WAV_H
+#define _HX_WAV_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef enum
+{
+    HX_SAMPLE_S16,
+    HX_SAMPLE_S24,
+    HX_SAMPLE_S32,
+    HX_SAMPLE_F32
+}hx_sample_fmt_e;
+
+/**
+ * @brief Audio file mapped into memory. WAV (PCM 16/24/32bit, float 32bit,
+ *      also WAVE_FORMAT_EXTENSIBLE) or headerless raw float32 interleaved,
+ *      selected by the .raw/.f32 file extension.
+ *      The sample data is read and written in place, no stdio buffering.
+ */
+class HxAudioFile
+{
+public:
+    HxAudioFile();
+    ~HxAudioFile();
+    /**
+     * @brief Maps an existing file for reading
+     *
+     * @param path      file name
+     * @param rawCh     channel count of raw files
+     * @param rawRate   sample rate of raw files
+     * @return false on error, see error()
+     */
+    bool open(const char *path, uint16_t rawCh = 1, uint32_t rawRate = 44100);
+    /**
+     * @brief Creates a file of the final size and maps it for writing
+     */
+    bool create(const char *path, size_t frames, uint16_t channels, uint32_t rate, hx_sample_fmt_e fmt);
+    /**
+     * @brief Unmaps and closes the file
+     */
+    void close();
+    /**
+     * @brief Reads frames into deinterleaved float buffers, range -1.0 to 1.0.
+     *      Frames past the end of the file are read as silence.
+     *
+     * @param pos   first frame
+     * @param n     number of frames
+     * @param dst   one buffer per file channel
+     */
+    void read(size_t pos, size_t n, float *const *dst) const;
+    /**
+     * @brief Writes deinterleaved float buffers, integer formats are
+     *      rounded and clipped.
+     */
+    void write(size_t pos, size_t n, const float *const *src);
+    size_t frames() const { return numFrames;}
+    uint16_t channels() const { return numCh;}
+    uint32_t rate() const { return sampleRate;}
+    hx_sample_fmt_e format() const { return fmt;}
+    const char *error() const { return err;}
+private:
+    int fd;
+    uint8_t *map;
+    size_t mapLen;
+    uint8_t *data;          // first sample
+    size_t numFrames;
+    uint16_t numCh;
+    uint32_t sampleRate;
+    hx_sample_fmt_e fmt;
+    uint8_t bytesPerSample;
+    const char *err;
+    bool fail(const char *msg);
+};
+
+/**
+ * @brief true if the file name has a raw float extension (.raw, .f32)
+ */
+bool hx_is_raw(const char *path);
+
+#endif // _HX_WAV_H
@@ -0,0 +1,67 @@
+/*  Host (Linux) stand-in for the parts of Arduino.h used by the effects
+ *
+ *  Author: Piotr Zapart
+ *          www.hexefx.com
+ *
+ * Copyright (c) 2021 by Piotr Zapart
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _HX_HOST_ARDUINO_H
+#define _HX_HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <cmath>
+#include <type_traits>
+
+#define DMAMEM
+#define FASTRUN
+#define FLASHMEM
+#define PROGMEM
+
+// the host graph runs in one thread, there is no audio interrupt to hold off
+static inline void __disable_irq(void) {}
+static inline void __enable_irq(void) {}
+static inline void AudioNoInterrupts(void) {}
+static inline void AudioInterrupts(void) {}
+
+// Teensy 4 wiring.h semantics, mixed argument types allowed
+template <class T, class L, class H>
+static inline T constrain(T amt, L low, H high)
+{
+    return (amt < low) ? (T)low : ((amt > high) ? (T)high : amt);
+}
+template <class A, class B>
+static inline typename std::common_type<A, B>::type min(A a, B b) { return (a < b) ? a : b;}
+template <class A, class B>
+static inline typename std::common_type<A, B>::type max(A a, B b) { return (a > b) ? a : b;}
+template <class T, class A, class B, class C, class D>
+static inline T map(T x, A in_min, B in_max, C out_min, D out_max)
+{
+    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+using std::abs;
+
+static inline float pow10f(float x) { return powf(10.0f, x);}
+
+#endif // _HX_HOST_ARDUINO_H
@@ -0,0 +1,199 @@
+/*  Host (Linux) stand-in for the Teensy AudioStream block API
+ *
+ *  Author: Piotr Zapart
+ *          www.hexefx.com
+ *
+ * Copyright (c) 2021 by Piotr Zapart
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+#include "AudioStream.h"
+#include "hx_blockpool.h"
+#include "hx_timer.h"
+
+static thread_local HxBlockPool<audio_block_t> pool;
+static thread_local AudioStream *first_update = NULL;
+thread_local uint16_t AudioStream::memory_used = 0;
+thread_local uint16_t AudioStream::memory_used_max = 0;
+
+void AudioMemory(unsigned int num)
+{
+    pool.resize(num);
+}
+
+AudioStream::AudioStream(unsigned char ninput, audio_block_t **iqueue) :
+    num_inputs(ninput), inputQueue(iqueue)
+{
+    AudioStream *p;
+    active = false;
+    destination_list = NULL;
+    for (int i = 0; i < num_inputs; i++) inputQueue[i] = NULL;
+    cpu_cycles = 0;
+    cpu_cycles_max = 0;
+    // append to the update list, objects are updated in the order of creation
+    next_update = NULL;
+    if (first_update == NULL)
+    {
+        first_update = this;
+        return;
+    }
+    for (p = first_update; p->next_update; p = p->next_update) ;
+    p->next_update = this;
+}
+
+AudioStream::~AudioStream()
+{
+    AudioStream **p;
+    for (p = &first_update; *p; p = &(*p)->next_update)
+    {
+        if (*p == this)
+        {
+            *p = next_update;
+            break;
+        }
+    }
+    for (int i = 0; i < num_inputs; i++)
+    {
+        if (inputQueue[i]) release(inputQueue[i]);
+        inputQueue[i] = NULL;
+    }
+}
+
+void AudioStream::update_all(void)
+{
+    uint32_t cycles;
+    for (AudioStream *p = first_update; p; p = p->next_update)
+    {
+        if (!p->active) continue;
+        cycles = hx_ticks();
+        p->update();
+        cycles = hx_ticks() - cycles;
+        p->cpu_cycles = cycles;
+        if (cycles > p->cpu_cycles_max) p->cpu_cycles_max = cycles;
+    }
+}
+
+float AudioStream::usage(uint32_t cycles)
+{
+    const double blockNs = AUDIO_BLOCK_SAMPLES * 1e9 / AUDIO_SAMPLE_RATE_EXACT;
+    return cycles / hx_ticks_per_ns() * 100.0 / blockNs;
+}
+
+audio_block_t *AudioStream::allocate(void)
+{
+    return pool.allocate(memory_used, memory_used_max);
+}
+
+void AudioStream::release(audio_block_t *block)
+{
+    if (block) pool.release(block, memory_used);
+}
+
+void AudioStream::transmit(audio_block_t *block, unsigned char index)
+{
+    for (AudioConnection *c = destination_list; c != NULL; c = c->next_dest)
+    {
+        if (c->src_index == index && c->dst->inputQueue[c->dest_index] == NULL)
+        {
+            c->dst->inputQueue[c->dest_index] = block;
+            block->ref_count++;
+        }
+    }
+}
+
+audio_block_t *AudioStream::receiveReadOnly(unsigned int index)
+{
+    audio_block_t *in;
+    if (index >= num_inputs) return NULL;
+    in = inputQueue[index];
+    inputQueue[index] = NULL;
+    return in;
+}
+
+audio_block_t *AudioStream::receiveWritable(unsigned int index)
+{
+    audio_block_t *in, *p;
+    if (index >= num_inputs) return NULL;
+    in = inputQueue[index];
+    inputQueue[index] = NULL;
+    if (in && in->ref_count > 1)      // shared block, the receiver gets its own copy
+    {
+        p = allocate();
+        if (p) memcpy(p->data, in->data, sizeof(p->data));
+        in->ref_count--;
+        in = p;
+    }
+    return in;
+}
+
+AudioConnection::AudioConnection(AudioStream &source, AudioStream &destination) :
+    src(&source), dst(&destination), src_index(0), dest_index(0), next_dest(NULL), isConnected(false)
+{
+    connect();
+}
+
+AudioConnection::AudioConnection(AudioStream &source, unsigned char sourceOutput,
+    AudioStream &destination, unsigned char destinationInput) :
+    src(&source), dst(&destination), src_index(sourceOutput), dest_index(destinationInput),
+    next_dest(NULL), isConnected(false)
+{
+    connect();
+}
+
+AudioConnection::~AudioConnection()
+{
+    disconnect();
+}
+
+int AudioConnection::connect(void)
+{
+    AudioConnection **p;
+    if (isConnected) return 0;
+    if (dest_index >= dst->num_inputs) return 1;
+    for (p = &src->destination_list; *p; p = &(*p)->next_dest) ;   // append at the end
+    *p = this;
+    next_dest = NULL;
+    src->active = true;
+    dst->active = true;
+    isConnected = true;
+    return 0;
+}
+
+int AudioConnection::disconnect(void)
+{
+    AudioConnection **p;
+    if (!isConnected) return 1;
+    for (p = &src->destination_list; *p; p = &(*p)->next_dest)
+    {
+        if (*p == this)
+        {
+            *p = next_dest;
+            break;
+        }
+    }
+    if (dst->inputQueue[dest_index])            // drop the pending block
+    {
+        AudioStream::release(dst->inputQueue[dest_index]);
+        dst->inputQueue[dest_index] = NULL;
+    }
+    isConnected = false;
+    return 0;
+}
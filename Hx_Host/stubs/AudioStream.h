@@ -0,0 +1,119 @@
+/*  Host (Linux) stand-in for the Teensy AudioStream block API
+ *
+ *  Author: Piotr Zapart
+ *          www.hexefx.com
+ *
+ * Copyright (c) 2021 by Piotr Zapart
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ *  Same semantics as the Teensy cores: blocks are reference counted,
+ *  transmit() fans a block out to all connected inputs, update_all() runs
+ *  the active objects in the order they were created.
+ *  The update list and the block pool are per thread, each worker thread
+ *  of a host tool builds and runs its own independent audio graph.
+ */
+#ifndef _HX_HOST_AUDIOSTREAM_H
+#define _HX_HOST_AUDIOSTREAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef AUDIO_BLOCK_SAMPLES
+#define AUDIO_BLOCK_SAMPLES         128
+#endif
+
+#ifndef AUDIO_SAMPLE_RATE_EXACT
+#define AUDIO_SAMPLE_RATE_EXACT     44117.64706f
+#endif
+
+#define AUDIO_SAMPLE_RATE           AUDIO_SAMPLE_RATE_EXACT
+
+typedef struct audio_block_struct
+{
+    uint8_t  ref_count;
+    uint8_t  reserved1;
+    uint16_t memory_pool_index;
+    int16_t  data[AUDIO_BLOCK_SAMPLES];
+} audio_block_t;
+
+class AudioStream;
+
+class AudioConnection
+{
+public:
+    AudioConnection(AudioStream &source, AudioStream &destination);
+    AudioConnection(AudioStream &source, unsigned char sourceOutput,
+        AudioStream &destination, unsigned char destinationInput);
+    ~AudioConnection();
+    int connect(void);
+    int disconnect(void);
+protected:
+    AudioStream *src;
+    AudioStream *dst;
+    unsigned char src_index;
+    unsigned char dest_index;
+    AudioConnection *next_dest;
+    bool isConnected;
+    friend class AudioStream;
+};
+
+/**
+ * @brief sets the size of the int16 block pool of the calling thread
+ */
+void AudioMemory(unsigned int num);
+
+class AudioStream
+{
+public:
+    AudioStream(unsigned char ninput, audio_block_t **iqueue);
+    virtual ~AudioStream();
+    virtual void update(void) = 0;
+    /**
+     * @brief runs update() of all active objects of the calling thread,
+     *      the host counterpart of the software interrupt
+     */
+    static void update_all(void);
+    float processorUsage(void) { return usage(cpu_cycles);}
+    float processorUsageMax(void) { return usage(cpu_cycles_max);}
+    void processorUsageMaxReset(void) { cpu_cycles_max = cpu_cycles;}
+    bool isActive(void) { return active;}
+    uint32_t cpu_cycles;            // ticks of the last update(), see hx_timer.h
+    uint32_t cpu_cycles_max;
+    static thread_local uint16_t memory_used;
+    static thread_local uint16_t memory_used_max;
+protected:
+    bool active;
+    unsigned char num_inputs;
+    static audio_block_t *allocate(void);
+    static void release(audio_block_t *block);
+    void transmit(audio_block_t *block, unsigned char index = 0);
+    audio_block_t *receiveReadOnly(unsigned int index = 0);
+    audio_block_t *receiveWritable(unsigned int index = 0);
+    friend class AudioConnection;
+private:
+    AudioConnection *destination_list;
+    audio_block_t **inputQueue;
+    AudioStream *next_update;
+    static float usage(uint32_t cycles);    // percent of one block period
+};
+
+#endif // _HX_HOST_AUDIOSTREAM_H
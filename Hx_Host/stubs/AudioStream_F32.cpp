@@ -0,0 +1,117 @@
+/*  Host (Linux) stand-in for the OpenAudio_ArduinoLibrary AudioStream_F32
+ *
+ *  Author: Piotr Zapart
+ *          www.hexefx.com
+ *
+ * Copyright (c) 2021 by Piotr Zapart
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+#include "AudioStream_F32.h"
+#include "hx_blockpool.h"
+
+// OpenAudio converter scaling
+#define I16_TO_F32_NORM_FACTOR  (3.051850947599719e-05f)    // 1/32767
+#define F32_TO_I16_NORM_FACTOR  (32767.0f)
+
+static thread_local HxBlockPool<audio_block_f32_t> pool_f32;
+static thread_local uint16_t used_f32 = 0;
+static thread_local uint16_t used_f32_max = 0;
+
+void AudioMemory_F32(unsigned int num)
+{
+    pool_f32.resize(num);
+}
+
+audio_block_f32_t *AudioStream_F32::allocate_f32(void)
+{
+    audio_block_f32_t *b = pool_f32.allocate(used_f32, used_f32_max);
+    if (b) b->length = AUDIO_BLOCK_SAMPLES;
+    return b;
+}
+
+void AudioStream_F32::release(audio_block_f32_t *block)
+{
+    if (block) pool_f32.release(block, used_f32);
+}
+
+uint16_t AudioStream_F32::f32_memory_used() { return used_f32;}
+uint16_t AudioStream_F32::f32_memory_used_max() { return used_f32_max;}
+
+audio_block_f32_t *AudioStream_F32::receiveWritable_f32(unsigned int index)
+{
+    audio_block_f32_t *in, *p;
+    in = receiveReadOnly_f32(index);
+    if (in && in->ref_count > 1)      // shared block, the receiver gets its own copy
+    {
+        p = allocate_f32();
+        if (p)
+        {
+            memcpy(p->data, in->data, sizeof(p->data));
+            p->length = in->length;
+            p->id = in->id;
+        }
+        in->ref_count--;
+        in = p;
+    }
+    return in;
+}
+
+void AudioConvert_I16toF32::update(void)
+{
+    audio_block_t *in = AudioStream::receiveReadOnly(0);
+    if (!in) return;
+    audio_block_f32_t *out = allocate_f32();
+    if (!out)
+    {
+        AudioStream::release(in);
+        return;
+    }
+    for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++)
+    {
+        out->data[i] = (float32_t)in->data[i] * I16_TO_F32_NORM_FACTOR;
+    }
+    AudioStream::release(in);
+    AudioStream_F32::transmit(out);
+    AudioStream_F32::release(out);
+}
+
+void AudioConvert_F32toI16::update(void)
+{
+    audio_block_f32_t *in = receiveReadOnly_f32(0);
+    if (!in) return;
+    audio_block_t *out = AudioStream::allocate();
+    if (!out)
+    {
+        AudioStream_F32::release(in);
+        return;
+    }
+    for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++)
+    {
+        float32_t s = in->data[i] * F32_TO_I16_NORM_FACTOR;
+        s = s > F32_TO_I16_NORM_FACTOR ? F32_TO_I16_NORM_FACTOR : s;
+        s = s < -F32_TO_I16_NORM_FACTOR ? -F32_TO_I16_NORM_FACTOR : s;
+        out->data[i] = (int16_t)s;
+    }
+    AudioStream_F32::release(in);
+    AudioStream::transmit(out);
+    AudioStream::release(out);
+}
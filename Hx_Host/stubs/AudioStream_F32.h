@@ -0,0 +1,109 @@
+/*  Host (Linux) stand-in for the OpenAudio_ArduinoLibrary AudioStream_F32
+ *
+ *  Author: Piotr Zapart
+ *          www.hexefx.com
+ *
+ * Copyright (c) 2021 by Piotr Zapart
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ *  As in OpenAudio the float objects share the update list and the
+ *  connection mechanism of AudioStream, only the block type and its pool
+ *  differ. Includes the int16 <-> float32 converters used to mix both
+ *  kinds of objects in one graph.
+ */
+#ifndef _HX_HOST_AUDIOSTREAM_F32_H
+#define _HX_HOST_AUDIOSTREAM_F32_H
+
+#include "AudioStream.h"
+#include "arm_math.h"
+
+class audio_block_f32_t
+{
+public:
+    unsigned char ref_count;
+    unsigned char memory_pool_index;
+    unsigned char reserved1;
+    unsigned char reserved2;
+    float32_t data[AUDIO_BLOCK_SAMPLES];
+    int full_length = AUDIO_BLOCK_SAMPLES;
+    int length = AUDIO_BLOCK_SAMPLES;
+    float fs_Hz = AUDIO_SAMPLE_RATE;
+    unsigned long id;
+};
+
+/**
+ * @brief sets the size of the float32 block pool of the calling thread
+ */
+void AudioMemory_F32(unsigned int num);
+
+class AudioConnection_F32 : public AudioConnection
+{
+public:
+    AudioConnection_F32(AudioStream &source, AudioStream &destination) :
+        AudioConnection(source, destination) {}
+    AudioConnection_F32(AudioStream &source, unsigned char sourceOutput,
+        AudioStream &destination, unsigned char destinationInput) :
+        AudioConnection(source, sourceOutput, destination, destinationInput) {}
+};
+
+class AudioStream_F32 : public AudioStream
+{
+public:
+    AudioStream_F32(unsigned char n_input_f32, audio_block_f32_t **iqueue) :
+        AudioStream(n_input_f32, (audio_block_t **)iqueue) {}
+    static audio_block_f32_t *allocate_f32(void);
+    static void release(audio_block_f32_t *block);
+    static uint16_t f32_memory_used();
+    static uint16_t f32_memory_used_max();
+    void transmit(audio_block_f32_t *block, unsigned char index = 0)
+    {
+        AudioStream::transmit((audio_block_t *)block, index);
+    }
+    audio_block_f32_t *receiveReadOnly_f32(unsigned int index = 0)
+    {
+        return (audio_block_f32_t *)AudioStream::receiveReadOnly(index);
+    }
+    audio_block_f32_t *receiveWritable_f32(unsigned int index = 0);
+protected:
+    using AudioStream::release;
+    using AudioStream::transmit;
+};
+
+class AudioConvert_I16toF32 : public AudioStream_F32
+{
+public:
+    AudioConvert_I16toF32() : AudioStream_F32(1, (audio_block_f32_t **)inputQueueArray) {}
+    virtual void update(void);
+private:
+    audio_block_t *inputQueueArray[1];
+};
+
+class AudioConvert_F32toI16 : public AudioStream_F32
+{
+public:
+    AudioConvert_F32toI16() : AudioStream_F32(1, inputQueueArray_f32) {}
+    virtual void update(void);
+private:
+    audio_block_f32_t *inputQueueArray_f32[1];
+};
+
+#endif // _HX_HOST_AUDIOSTREAM_F32_H
@@ -0,0 +1,57 @@
+/*  Host versions of the CMSIS-DSP functions used by the effects
+ *
+ *  Author: Piotr Zapart
+ *          www.hexefx.com
+ *
+ * Copyright (c) 2021 by Piotr Zapart
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _HX_HOST_ARM_MATH_H
+#define _HX_HOST_ARM_MATH_H
+
+#include <stdint.h>
+#include <math.h>
+
+#ifndef PI
+#define PI                  3.14159265358979f
+#endif
+
+typedef int8_t      q7_t;
+typedef int16_t     q15_t;
+typedef int32_t     q31_t;
+typedef int64_t     q63_t;
+typedef float       float32_t;
+typedef double      float64_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+float32_t arm_sin_f32(float32_t x);
+float32_t arm_cos_f32(float32_t x);
+void arm_scale_f32(const float32_t *pSrc, float32_t scale, float32_t *pDst, uint32_t blockSize);
+void arm_q15_to_float(const q15_t *pSrc, float32_t *pDst, uint32_t blockSize);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _HX_HOST_ARM_MATH_H
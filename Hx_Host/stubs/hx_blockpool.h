@@ -0,0 +1,78 @@
+/*  Host block pool shared by the int16 and float32 AudioStream stand-ins
+ *
+ *  Author: Piotr Zapart
+ *          www.hexefx.com
+ *
+ * Copyright (c) 2021 by Piotr Zapart
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _HX_BLOCKPOOL_H
+#define _HX_BLOCKPOOL_H
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief Fixed size pool like the AudioMemory() one: allocate() returns NULL
+ *      when all blocks are in use, so the effects see the same allocation
+ *      failures as on the Teensy. One pool per thread.
+ */
+template <typename T>
+class HxBlockPool
+{
+public:
+    void resize(unsigned int num)
+    {
+        if (used) return;               // blocks still in flight
+        storage.reset(new T[num]());
+        freeList.clear();
+        for (unsigned int i = num; i > 0; i--) freeList.push_back(&storage[i - 1]);
+    }
+    T *allocate(uint16_t &inUse, uint16_t &inUseMax)
+    {
+        if (freeList.empty()) return NULL;
+        T *b = freeList.back();
+        freeList.pop_back();
+        b->ref_count = 1;
+        b->memory_pool_index = (uint16_t)(b - storage.get());
+        if (++used > inUseMax) inUseMax = used;
+        inUse = used;
+        return b;
+    }
+    void release(T *b, uint16_t &inUse)
+    {
+        if (b->ref_count > 1)
+        {
+            b->ref_count--;
+            return;
+        }
+        b->ref_count = 0;
+        freeList.push_back(b);
+        inUse = --used;
+    }
+private:
+    std::unique_ptr<T[]> storage;
+    std::vector<T *> freeList;
+    uint16_t used = 0;
+};
+
+#endif // _HX_BLOCKPOOL_H
@@ -27,22 +27,32 @@
 
 // ---------------------------- INFINITE PHASER MODULATION -----------------------
 #define INF_PHASER_STEP     (0x100000000u / INFINITE_PHASER_PATHS)
+#define INF_PHASER_PASS_LEN 16      // samples per stage pass, see process_segment()
 
 #define USE_TABLE
 
+#if defined(AUDIO_PROFILE)
+static const char *const profNames[] = {"mod", "allpass", "mix"};
+#endif
+
 
 AudioEffectInfinitePhaser_F32::AudioEffectInfinitePhaser_F32() : AudioStream_F32(1, inputQueueArray_f32)
 {
-	memset(allpass_x, 0, INFINITE_PHASER_STAGES * INFINITE_PHASER_PATHS * sizeof(float32_t));
-	memset(allpass_y, 0, INFINITE_PHASER_STAGES * INFINITE_PHASER_PATHS * sizeof(float32_t));
-    bps = false;
-    lfo_top = 1.0f;
-    lfo_btm = 0.0f;
+    params_t &p = params.edit();
+    allpass.reset();
     lfo_phase_acc = 0;
-    lfo_add = 0;
-    feedb = 0.5f;              // effect is hard noticable with low feedback settings, hence the range is limited to 0.5-0.999
-    mix_ratio = 0.5f;         // start with classic phaser sound 
-    stg = INFINITE_PHASER_STAGES;
+    busPos = 0;
+    p.modBus = NULL;
+    p.bps = false;
+    p.lfo_top = 1.0f;
+    p.lfo_btm = 0.0f;
+    p.lfo_add = 0;
+    p.feedb = 0.5f;              // effect is hard noticable with low feedback settings, hence the range is limited to 0.5-0.999
+    p.mix_ratio = 0.5f;         // start with classic phaser sound 
+    p.stg = INFINITE_PHASER_STAGES;
+    params.publish();
+    params.fetch(prm);
+    AUDIO_PROFILE_INIT(profile, profNames, PROF_NUM);
 }
 AudioEffectInfinitePhaser_F32::~AudioEffectInfinitePhaser_F32()
 {
@@ -50,72 +60,135 @@ AudioEffectInfinitePhaser_F32::~AudioEffectInfinitePhaser_F32()
 
 void AudioEffectInfinitePhaser_F32::update()
 {
-
-#if defined(__ARM_ARCH_7EM__)
+#if defined(__ARM_ARCH_7EM__) || defined(HX_HOST_BUILD)
     audio_block_f32_t *blockIn; 
-    uint16_t i = 0;
-    float32_t modSig;
-    uint32_t phaseAcc = lfo_phase_acc;
-    int32_t phaseAdd = lfo_add;
-    float32_t top = lfo_top;
-    float32_t btm = lfo_btm;
-    uint32_t phase_acc_local;
-    uint32_t y0, y1;
-    float32_t inSig, drySig, wetSig;
-    float32_t fdb = feedb;
-    float32_t ampl;
 
     blockIn = AudioStream_F32::receiveWritable_f32(0);       // audio data
-    
     if (!blockIn)
     {
         return;
     }
-    if (bps)
+    const float32_t *in[1] = {blockIn->data};
+    float32_t *out[1] = {blockIn->data};
+    process(in, out, blockIn->length);      // bypass: the input block is sent unchanged
+    AudioStream_F32::transmit(blockIn);
+	AudioStream_F32::release(blockIn);
+#endif
+}
+
+void AudioEffectInfinitePhaser_F32::process(const float32_t *const *in, float32_t *const *out, uint32_t n)
+{
+#if defined(__ARM_ARCH_7EM__) || defined(HX_HOST_BUILD)
+    const float32_t *src = in[0];
+    float32_t *dst = out[0];
+    uint32_t seg;
+    uint32_t pos = busPos;
+
+    seg = params.fetch(prm, n);         // samples up to the next scheduled change
+    if (prm.bps && seg == n)
     {
-        AudioStream_F32::transmit(blockIn);
-        AudioStream_F32::release(blockIn);
+        if (dst != src) memcpy(dst, src, n * sizeof(float32_t));
+        busPos = (busPos + n) % AUDIO_BLOCK_SAMPLES;
         return;
     }
-
-	for (i=0; i < AUDIO_BLOCK_SAMPLES; i++) 
+    AUDIO_PROFILE_START(profile);
+    while (n)
     {
-        wetSig = 0.0f;
-        drySig = blockIn->data[i] * (1.0f - fdb*0.25f);  // attenuate the input if using feedback
-        
-        y1 = INFINITE_PHASER_PATHS;
-        while (y1)
+        if (prm.bps)
         {
-            y1--;
-            phase_acc_local = phaseAcc + y1*INF_PHASER_STEP;
-            modSig =  1.0f - ((float32_t)phase_acc_local / 4294967295.0f);
-            ampl = modSig * 2.0f; 
-            
-            if (ampl > 1.0f)  ampl = -2.0f * modSig + 2.0f;
-            modSig = modSig*modSig * abs(top - btm) + min(top, btm);
+            if (dst != src) memcpy(dst, src, seg * sizeof(float32_t));
+        }
+        else process_segment(src, dst, pos, seg);
+        src += seg;
+        dst += seg;
+        pos += seg;
+        n -= seg;
+        if (n) seg = params.fetch(prm, n);
+    }
+    busPos = pos % AUDIO_BLOCK_SAMPLES;
+    AUDIO_PROFILE_COMMIT(profile);
+#endif
+}
 
-            inSig = drySig + last_sample[y1] * fdb;
-            y0 = stg;
-            while (y0)  // process allpass filters in pairs
+// samples with one parameter set, pos = modulation bus read position
+void AudioEffectInfinitePhaser_F32::process_segment(const float32_t *src, float32_t *dst, uint32_t pos, uint32_t len)
+{
+    uint32_t i, c, pass;
+    float32_t modSig;
+    uint32_t phaseAcc = lfo_phase_acc;
+    int32_t phaseAdd = prm.lfo_add;
+    float32_t top = prm.lfo_top;
+    float32_t btm = prm.lfo_btm;
+    const float32_t * const *bus = prm.modBus;
+    uint32_t phase_acc_local;
+    uint32_t busIdx;
+    int32_t y1;
+    float32_t drySig, wetSig, f, fdb, mix;
+    bool ramp;
+    // the stages run as passes over up to INF_PHASER_PASS_LEN samples: the
+    // profiler times each stage once per pass, not per sample
+    float32_t dry[INF_PHASER_PASS_LEN];
+    float32_t ampl[INF_PHASER_PASS_LEN][INFINITE_PHASER_PATHS];
+    float32_t k[INF_PHASER_PASS_LEN][INFINITE_PHASER_PATHS];
+    float32_t outSig[INF_PHASER_PASS_LEN][INFINITE_PHASER_PATHS];
+    float32_t inSig[INFINITE_PHASER_PATHS];
+
+    for (c = 0; c < len; c += pass)
+    {
+        pass = min(len - c, (uint32_t)INF_PHASER_PASS_LEN);
+        pass = fdbRamp.span(prm.feedb, pass);           // parameter ramps, see utility_ramp.h
+        pass = mixRamp.span(prm.mix_ratio, pass);
+        ramp = fdbRamp.begin(prm.feedb, pass);
+        ramp |= mixRamp.begin(prm.mix_ratio, pass);
+        fdb = f = fdbRamp.value;
+        mix = mixRamp.value;
+        for (i = 0; i < pass; i++)
+        {
+            dry[i] = src[c + i] * (1.0f - f*0.25f);  // attenuate the input if using feedback
+            busIdx = (pos + c + i) % AUDIO_BLOCK_SAMPLES;   // the bus holds one audio cycle
+            for (y1 = 0; y1 < INFINITE_PHASER_PATHS; y1++)
             {
-                y0--;
-                allpass_y[y1][y0] = modSig * (allpass_y[y1][y0] + inSig) - allpass_x[y1][y0];
-                allpass_x[y1][y0] = inSig;
-                y0--;
-                allpass_y[y1][y0] = modSig * (allpass_y[y1][y0] + allpass_y[y1][y0+1]) - allpass_x[y1][y0];
-                allpass_x[y1][y0] = allpass_y[y1][y0+1];
-                inSig = allpass_y[y1][y0];
+                if (bus) modSig = 1.0f - bus[y1][busIdx];
+                else
+                {
+                    phase_acc_local = phaseAcc + y1*INF_PHASER_STEP;
+                    modSig =  1.0f - ((float32_t)phase_acc_local / 4294967295.0f);
+                }
+                ampl[i][y1] = modSig * 2.0f; 
+                if (ampl[i][y1] > 1.0f)  ampl[i][y1] = -2.0f * modSig + 2.0f;
+                k[i][y1] = modSig*modSig * abs(top - btm) + min(top, btm);
             }
-            last_sample[y1] = inSig;
-            wetSig += ((drySig * (1.0f - mix_ratio) + inSig * mix_ratio)* ampl)/2.0f;
+            phaseAcc += phaseAdd;
+            if (ramp) f += fdbRamp.step;
+        }
+        AUDIO_PROFILE_LAP(profile, PROF_MOD);
+
+        for (i = 0; i < pass; i++)
+        {
+            for (y1 = 0; y1 < INFINITE_PHASER_PATHS; y1++) inSig[y1] = dry[i];
+            // all paths run in parallel through the shared allpass kernel
+            allpass.tick(inSig, k[i], fdb, outSig[i], prm.stg);
+            if (ramp) fdb += fdbRamp.step;
         }
-        blockIn->data[i] = wetSig;
+        AUDIO_PROFILE_LAP(profile, PROF_ALLPASS);
 
-        phaseAcc += phaseAdd;   
+        for (i = 0; i < pass; i++)
+        {
+            drySig = dry[i];
+            wetSig = 0.0f;
+            y1 = INFINITE_PHASER_PATHS;
+            while (y1)
+            {
+                y1--;
+                wetSig += ((drySig * (1.0f - mix) + outSig[i][y1] * mix)* ampl[i][y1])/2.0f;
+            }
+            dst[c + i] = wetSig;
+            if (ramp) mix += mixRamp.step;
+        }
+        AUDIO_PROFILE_LAP(profile, PROF_MIX);
+        fdbRamp.end();
+        mixRamp.end();
     }
     lfo_phase_acc = phaseAcc;
-    AudioStream_F32::transmit(blockIn);
-	AudioStream_F32::release(blockIn);
-#endif
+    allpass.snap();     // decayed states, see utility_denormal.h
 }
-
@@ -31,6 +31,10 @@
 #include "Audio.h"
 #include "AudioStream_F32.h"
 #include "arm_math.h"
+#include "filter_modallpass.h"
+#include "utility_profile.h"
+#include "utility_params.h"
+#include "utility_ramp.h"
 
 // ################ SHEPARD/BARBERPOLE INFINITE PHASER ################
 #define INFINITE_PHASER_STAGES	6
@@ -44,6 +48,18 @@ public:
     AudioEffectInfinitePhaser_F32();
     ~AudioEffectInfinitePhaser_F32();
     virtual void update();
+    /**
+     * @brief Processing core called by update(), can be used without the
+     *          audio library for any block length
+     * 
+     * @param in    in[0] audio
+     * @param out   out[0] audio, can be the same buffer as in[0]
+     * @param n     number of samples. The bus holds one AUDIO_BLOCK_SAMPLES cycle,
+     *              the read position is carried over to the next call: calls
+     *              shorter than a block step through the same cycle.
+     */
+    void process(const float32_t *const *in, float32_t *const *out, uint32_t n);
+    enum {PROC_IN = 1, PROC_OUT = 1};   // audio channels of process(), see effect_chain_F32.h
 /**
      * @brief Scale and offset the modulation signal. 
      *          LFO will oscillate between these two max and min values. 
@@ -53,27 +69,20 @@ public:
      */
     void depth(float32_t top, float32_t bottom)
     {
-        float32_t a, b;
-        a = constrain(top, 0.0f, 1.0f);
-        b = constrain(bottom, 0.0f, 1.0f);
-        __disable_irq();
-        lfo_top = a;
-        lfo_btm = b;
-        __enable_irq();
+        params_t &p = params.edit();
+        p.lfo_top = constrain(top, 0.0f, 1.0f);
+        p.lfo_btm = constrain(bottom, 0.0f, 1.0f);
+        params.publish();
     }
     void depth_top(float32_t top)
     {
-        float32_t a = constrain(top, 0.0f, 1.0f);
-        __disable_irq();
-        lfo_top = a;
-        __enable_irq();
+        params.edit().lfo_top = constrain(top, 0.0f, 1.0f);
+        params.publish();
     }
     void depth_btm(float32_t btm)
     {
-        float32_t a = constrain(btm, 0.0f, 1.0f);
-        __disable_irq();
-        lfo_btm = a;
-        __enable_irq();
+        params.edit().lfo_btm = constrain(btm, 0.0f, 1.0f);
+        params.publish();
     }
     /**
      * @brief Controls the internal LFO.
@@ -85,17 +94,13 @@ public:
      */
     void lfo(float32_t rate, float32_t top, float32_t btm)
     {
-        int32_t add;
+        params_t &p = params.edit();
         if (rate < 0.0f) rate = rate*rate*(-1.0f);
         else rate = rate*rate;
-        top = constrain(top, 0.0f, 1.0f);
-        btm = constrain(btm, 0.0f, 1.0f);
-        add = rate * (4294967296.0 / AUDIO_SAMPLE_RATE_EXACT);
-        __disable_irq();
-        lfo_top = top;
-        lfo_btm = btm;
-        lfo_add = add;
-        __enable_irq();
+        p.lfo_top = constrain(top, 0.0f, 1.0f);
+        p.lfo_btm = constrain(btm, 0.0f, 1.0f);
+        p.lfo_add = rate * (4294967296.0 / AUDIO_SAMPLE_RATE_EXACT);
+        params.publish();
     }
     /**
      * @brief Set the rate of the internal LFO
@@ -107,12 +112,9 @@ public:
     {
         if (rate < 0.0f) rate = rate*rate*(-1.0f);
         else rate = rate*rate;
-        int32_t add;
         rate = map(rate, -1.0f, 1.0f, -INFINITE_PHASER_MAX_LFO_HZ, INFINITE_PHASER_MAX_LFO_HZ);
-        add = rate * (4294967296.0f / AUDIO_SAMPLE_RATE_EXACT);
-        __disable_irq();
-        lfo_add = add;
-        __enable_irq();
+        params.edit().lfo_add = rate * (4294967296.0f / AUDIO_SAMPLE_RATE_EXACT);
+        params.publish();
     }
     /**
      * @brief Controls the feedback parameter
@@ -121,10 +123,8 @@ public:
      */
     void feedback(float32_t fdb)
     {
-        fdb = map(fdb, 0.0f, 1.0f, 0.5f, 0.999f);
-        __disable_irq();
-        feedb = fdb;
-        __enable_irq();
+        params.edit().feedb = map(fdb, 0.0f, 1.0f, 0.5f, 0.999f);
+        params.publish();
     }
     /**
      * @brief Dry / Wet mixer ratio. Classic Phaser sound uses 0.5f for 50% dry and 50%Wet
@@ -134,10 +134,8 @@ public:
      */
     void mix(float32_t ratio)
     {
-        ratio = constrain(ratio, 0.0f, 1.0f);
-        __disable_irq();
-        mix_ratio = ratio;
-        __enable_irq();
+        params.edit().mix_ratio = constrain(ratio, 0.0f, 1.0f);
+        params.publish();
     }
     /**
      * @brief Sets the number of stages used in the phaser
@@ -149,32 +147,62 @@ public:
     {
         if (st && st == ((st >> 1) << 1) && st <= INFINITE_PHASER_STAGES) // only 2, 4, 6, 8, 12 allowed
         {
-            __disable_irq();
-            stg = st;
-            __enable_irq();
+            params.edit().stg = st;
+            params.publish();
         }
     }
+    /**
+     * @brief Use a set of INFINITE_PHASER_PATHS modulation bus channels instead
+     *          of the internal LFO. The channels have to be rising ramps spaced 
+     *          by 360/INFINITE_PHASER_PATHS degrees, ie. for 6 paths:
+     *          bus.lfo(0, MODBUS_WAVE_RAMP, rate);
+     *          bus.link(n, 0, n * 60.0f, MODBUS_WAVE_RAMP); for n = 1..5
+     *          phaser.modulation(bus.buffers(0));
+     * 
+     * @param src buffers from AudioModulationBus::buffers(), NULL = internal LFO
+     */
+    void modulation(const float32_t * const *src) { params.edit().modBus = src; params.publish();}
     /**
      * @brief Use to bypass the effect (true)
      * 
      * @param state true = bypass on, false = phaser on
      */
-    void set_bypass(bool state) {bps = state;}
-    bool get_bypass(void) {return bps;}
-    bool tgl_bypass(void) {bps ^= 1; return bps;}
+    void set_bypass(bool state) { params.edit().bps = state; params.publish();}
+    bool get_bypass(void) {return params.get().bps;}
+    bool tgl_bypass(void) { set_bypass(!params.get().bps); return params.get().bps;}
+
+    /**
+     * @brief Sample accurate automation: the next setter call takes effect
+     *          at sample t of time(), see utility_params.h
+     */
+    bool at(uint32_t t) { return params.at(t);}
+    uint32_t time(void) { return params.time();}
+    void advance(uint32_t n) { params.advance(n);}  // clock of a bypassed chain stage
+
+    enum {PROF_MOD, PROF_ALLPASS, PROF_MIX, PROF_NUM};     // update() stages
+#if defined(AUDIO_PROFILE)
+    AudioProfile profile;           // cycles per update() stage, see utility_profile.h
+#endif
 private:
-    uint8_t stg;                             // number of stages
-    bool bps;                                // bypass
+    typedef struct
+    {
+        uint8_t stg;                         // number of stages
+        bool bps;                            // bypass
+        float32_t mix_ratio;                 // 0 = dry. 1.0 = wet
+        float32_t feedb;                     // feedback 
+        const float32_t * const *modBus;     // modulation bus channels
+        int32_t lfo_add;
+        float32_t lfo_top;
+        float32_t lfo_btm;
+    } params_t;
+    AudioParams<params_t> params;            // written by the setters
+    params_t prm;                            // in use by update(), see utility_params.h
+    AudioRamp fdbRamp, mixRamp;              // feedback and mix ramps, see utility_ramp.h
     audio_block_f32_t *inputQueueArray_f32[1];      
-    float32_t allpass_x[INFINITE_PHASER_PATHS][INFINITE_PHASER_STAGES];      // allpass inputs
-	float32_t allpass_y[INFINITE_PHASER_PATHS][INFINITE_PHASER_STAGES];      // allpass outputs
-	float32_t mix_ratio;                     // 0 = dry. 1.0 = wet
-    float32_t feedb;                         // feedback 
-    float32_t last_sample[INFINITE_PHASER_PATHS];
+    void process_segment(const float32_t *src, float32_t *dst, uint32_t pos, uint32_t len);
+    AudioFilterModAllpass<INFINITE_PHASER_STAGES, INFINITE_PHASER_PATHS> allpass;   // one lane per path
     uint32_t lfo_phase_acc;                  // interfnal lfo 
-    int32_t lfo_add;
-    float32_t lfo_top;
-    float32_t lfo_btm;
+    uint32_t busPos;                         // modulation bus read position, see process()
 };
 
 #endif // _EFFECT_INFPHASER_H
@@ -31,7 +31,12 @@
  */
 #include "effect_monoToStereo_F32.h"
 
-const float32_t allpass_k_table[ALLP_NETWORK_LEN] = 
+#if defined(AUDIO_PROFILE)
+static const char *const profNames[] = {"network", "mix"};
+#endif
+
+// 21 stage network, HIGH quality
+static constexpr float32_t allpass_k_table[ALLP_NETWORK_LEN] = 
 {
     -0.9823311567306519f, -0.9838343858718872f, -0.9838343858718872f, 
     -0.9843953251838684f, -0.9843953251838684f, -0.9850407838821411f, 
@@ -41,13 +46,172 @@ const float32_t allpass_k_table[ALLP_NETWORK_LEN] =
     -0.9911531209945679f, -0.9911531209945679f, -0.9911531209945679f, 
     -0.9911531209945679f, -0.9928167462348938f, -0.9928167462348938f
 };
+// Shorter networks: break frequencies fitted (least squares, 20Hz-20kHz, 
+// log spaced) to the phase curve of the 21 stage network scaled by N/21.
+// The bands are distributed the same way, there are just fewer of them.
+// Odd lengths keep the phase at Nyquist at -180deg, the same as the 21 stage one.
+// 7 stages, LOW quality, fc 114.4Hz...52.1Hz @ 44.1kHz
+static constexpr float32_t allpass_k_table_low[7] = 
+{
+    -0.9838377102f, -0.9844448586f, -0.9856585275f, -0.9868707855f, 
+    -0.9899939677f, -0.9911368338f, -0.9926029868f
+};
+// 13 stages, MID quality, fc 123.8Hz...46.0Hz @ 44.1kHz
+static constexpr float32_t allpass_k_table_mid[13] = 
+{
+    -0.9825136692f, -0.9840659013f, -0.9849032112f, -0.9854084340f, 
+    -0.9858441958f, -0.9859018624f, -0.9868635125f, -0.9893922945f, 
+    -0.9902291871f, -0.9905701399f, -0.9910024868f, -0.9911444561f, 
+    -0.9934617248f
+};
+
+/**
+ * @brief Pairs the adjacent stages of the 1st order table into sections
+ *      (c1 + z^-1)(c2 + z^-1) / ((1 + c1*z^-1)(1 + c2*z^-1))
+ *      Only pairing is done, the coefficients are not fused: the section
+ *      runs the two 1st order stages in one step in their factored form.
+ *      Expanded into biquad coefficients (a1 = c1 + c2, a2 = c1*c2) the
+ *      double poles near z = 1 move with the float rounding of a1, -73dB 
+ *      vs -117dB error of the 1st order chain against a double reference.
+ *      Entry 0 of the 1st order table is left as a single 1st order stage.
+ */
+typedef struct
+{
+    float32_t k0;                   // single 1st order stage
+    float32_t k1[ALLP_SECTIONS];    // 1st stage of the section
+    float32_t k2[ALLP_SECTIONS];    // 2nd stage
+    int32_t sections;
+} allp_sections_t;
+
+template<int N>
+static constexpr allp_sections_t allp_pair_sections(const float32_t (&table)[N])
+{
+    static_assert(N & 1, "1st order stage layout expects an odd network length");
+    static_assert(N <= ALLP_NETWORK_LEN, "network too long for the pipeline");
+    allp_sections_t t = {};
+    t.k0 = table[0];
+    t.sections = N / 2;
+    for (int i = 0; i < N / 2; i++)
+    {
+        // network runs from the last table entry down
+        float32_t c1 = table[N - 1 - 2*i];
+        float32_t c2 = table[N - 2 - 2*i];
+        t.k1[i] = c1;
+        t.k2[i] = c2;
+    }
+    return t;
+}
+static constexpr allp_sections_t allpass_sections[MONOTOSTEREO_QUALITY_NUM] = 
+{
+    allp_pair_sections(allpass_k_table_low),
+    allp_pair_sections(allpass_k_table_mid),
+    allp_pair_sections(allpass_k_table)
+};
+
+/**
+ * @brief Velvet noise decorrelator taps: one tap with a random position 
+ *      and random sign in each VELVET_LEN/VELVET_TAPS long grid cell.
+ *      Generated at compile time with a fixed seed, so every build
+ *      uses the same sequence. Taps of each segment are sorted by sign,
+ *      positive ones first, the filter loop only adds and subtracts.
+ */
+typedef struct
+{
+    uint16_t delay[VELVET_TAPS];
+    uint8_t posEnd[VELVET_SEGMENTS];    // end of the positive taps in each segment
+} velvet_taps_t;
+
+static constexpr velvet_taps_t velvet_gen_taps(uint32_t seed)
+{
+    velvet_taps_t t = {};
+    const uint32_t grid = VELVET_LEN / VELVET_TAPS;
+    const uint32_t tapsPerSeg = VELVET_TAPS / VELVET_SEGMENTS;
+    uint16_t neg[VELVET_TAPS / VELVET_SEGMENTS] = {};
+    uint32_t i = 0, seg = 0, p = 0, n = 0;
+    for (seg = 0; seg < VELVET_SEGMENTS; seg++)
+    {
+        p = seg * tapsPerSeg;
+        n = 0;
+        for (; i < (seg + 1) * tapsPerSeg; i++)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            uint16_t d = i * grid + 1 + (seed >> 16) % (grid - 1);  // no tap at 0, keeps the side uncorrelated with the dry signal
+            seed = seed * 1664525u + 1013904223u;
+            if (seed >> 31) t.delay[p++] = d;
+            else            neg[n++] = d;
+        }
+        t.posEnd[seg] = p;
+        for (uint32_t k = 0; k < n; k++) t.delay[p + k] = neg[k];
+    }
+    return t;
+}
+static constexpr velvet_taps_t velvet_taps = velvet_gen_taps(0x4845u);
+static_assert(VELVET_TAPS % VELVET_SEGMENTS == 0, "segments must hold the same number of taps");
+
+// segment gains, -4dB per segment, normalized to unity power gain
+static const float32_t velvet_seg_gain[VELVET_SEGMENTS] = {0.277804f, 0.175283f, 0.110596f, 0.069781f};
+
+/**
+ * @brief Polyphase IIR Hilbert transformer, Olli Niemitalo's coefficients
+ *      Two chains of 2nd order allpass stages in z^-2: 
+ *      H(z) = (a^2 - z^-2) / (1 - a^2*z^-2)
+ *      Path Q leads path I (delayed by 1 sample) by 90deg +-0.7deg 
+ *      from 20Hz to 22kHz @ 44.1kHz.
+ *      Table holds a^2, path I stages first.
+ */
+static constexpr float32_t hilbert_k(float64_t a) { return (float32_t)(a * a);}
+static constexpr float32_t hilbert_k_table[2 * HILBERT_STAGES] = 
+{
+    hilbert_k(0.6923878),     hilbert_k(0.9360654322959), hilbert_k(0.9882295226860), hilbert_k(0.9987488452737),
+    hilbert_k(0.4021921162426), hilbert_k(0.8561710882420), hilbert_k(0.9722909545651), hilbert_k(0.9952884791278)
+};
+
+/**
+ * @brief Default multi output matrix. Pairs of taps, chosen by a greedy search
+ *      for the lowest correlation between the outputs (white noise, HIGH quality): 
+ *      outputs 0/1 are the stereo pair (0.32), outputs 2..5 stay below that,
+ *      output 6 max 0.38, output 7 max 0.42. 
+ *      Differences of neighbour taps cancel at high frequencies, these
+ *      outputs carry mostly the low and mid range.
+ */
+#define M_G (0.70710678f)
+static const float32_t matrix_default[MONOTOSTEREO_OUT_MAX][MONOTOSTEREO_TAP_NUM] = 
+{
+//    DRY    N1Q1   N1Q2   N1Q3   NET1   N2Q1   N2Q2   N2Q3   NET2
+    { M_G,   0.0f,  0.0f,  0.0f,  M_G,   0.0f,  0.0f,  0.0f,  0.0f},
+    { 0.0f,  0.0f,  0.0f,  0.0f,  M_G,   0.0f,  0.0f,  0.0f, -M_G },
+    { 0.0f,  0.0f,  0.0f,  0.0f,  0.0f,  M_G,  -M_G,   0.0f,  0.0f},
+    { 0.0f,  0.0f,  0.0f,  0.0f,  0.0f,  0.0f,  0.0f,  M_G,   M_G },
+    { 0.0f,  0.0f,  0.0f,  0.0f,  M_G,  -M_G,   0.0f,  0.0f,  0.0f},
+    { 0.0f,  0.0f,  0.0f,  0.0f,  0.0f,  0.0f,  M_G,  -M_G,   0.0f},
+    { 0.0f,  M_G,  -M_G,   0.0f,  0.0f,  0.0f,  0.0f,  0.0f,  0.0f},
+    { 0.0f,  0.0f,  M_G,   0.0f,  0.0f,  0.0f,  0.0f,  0.0f,  M_G }
+};
+#undef M_G
 
 AudioEffectMonoToStereo_F32::AudioEffectMonoToStereo_F32() : AudioStream_F32(1, inputQueueArray_f32)
 {
-    pancos = 1.0f;
-    pansin= 0.0f;
-    width = 0.0f;
-    bypass = false;
+    params_t &p = params.edit();
+    p.pancos = 1.0f;
+    p.pansin= 0.0f;
+    p.width = 0.0f;
+    p.bypass = false;
+    p.quality = MONOTOSTEREO_QUALITY_HIGH;
+    p.engine = MONOTOSTEREO_ENGINE_ALLPASS;
+    p.multiOutputs = 0;
+    memcpy(p.matrix, matrix_default, sizeof(p.matrix));
+    params.publish();
+    params.fetch(prm);
+    allocFailCount = 0;
+    quality = p.quality;
+    pipelineIdx = 0;
+    xfadeLeft = 0;
+    allp_load(pipeline[0], quality);
+    memset(velvetBuf, 0, sizeof(velvetBuf));
+    memset(hilbert_st, 0, sizeof(hilbert_st));
+    hilbert_dly = 0.0f;
+    outputs = 0;
+    AUDIO_PROFILE_INIT(profile, profNames, PROF_NUM);
 }
 AudioEffectMonoToStereo_F32::~AudioEffectMonoToStereo_F32()
 {
@@ -55,77 +219,522 @@ AudioEffectMonoToStereo_F32::~AudioEffectMonoToStereo_F32()
 
 void AudioEffectMonoToStereo_F32::update()
 {
-#if defined(__ARM_ARCH_7EM__)
+#if defined(__ARM_ARCH_7EM__) || defined(HX_HOST_BUILD)
 
     audio_block_f32_t *blockIn;
     uint16_t i;
-    float32_t _width = width;
-    float32_t _pancos = pancos;
-    float32_t _pansin = pansin;
-    float32_t allp1Out, allp2Out, stereoL, stereoR;
 
-    blockIn = AudioStream_F32::receiveReadOnly_f32(0);
-    if (!blockIn) return;
-
-    audio_block_f32_t *blockOutL = AudioStream_F32::allocate_f32();
-    audio_block_f32_t *blockOutR = AudioStream_F32::allocate_f32();
-    if (!blockOutL || !blockOutR)
+    params.fetch(prm);
+    outputs = prm.multiOutputs;         // blocks are allocated for the outputs of this block
+    if (prm.bypass && params.due(AUDIO_BLOCK_SAMPLES) == AUDIO_BLOCK_SAMPLES)
     {
-        
-        if (blockOutL)
-            AudioStream_F32::release(blockOutL);
-        if (blockOutR)
-            AudioStream_F32::release(blockOutR);
+        // nothing allocated, input goes to all outputs
+        params.fetch(prm, AUDIO_BLOCK_SAMPLES);     // keeps the clock running
+        blockIn = AudioStream_F32::receiveReadOnly_f32(0);
+        if (!blockIn) return;
+        for (i = 0; i < (outputs ? outputs : 2); i++)
+            AudioStream_F32::transmit(blockIn, i);
+        AudioStream_F32::release(blockIn);
         return;
     }
-    if (bypass)
+    blockIn = AudioStream_F32::receiveWritable_f32(0);      // reused for the L output
+    if (!blockIn) return;
+    if (outputs)
     {
-        AudioStream_F32::transmit(blockIn, 0); // transmit input on both
-        AudioStream_F32::transmit(blockIn, 1); // out channels
-        AudioStream_F32::release(blockIn);
-        AudioStream_F32::release(blockOutL);
-        AudioStream_F32::release(blockOutR);
+        update_multi(blockIn);
         return;
     }
-    for (i = 0; i < blockIn->length; i++)
+    audio_block_f32_t *blockOutR = AudioStream_F32::allocate_f32();
+    if (!blockOutR)
     {
-        allp1Out = do_allp_netw(blockIn->data[i], allpass_netw_1x, allpass_netw_1y);
-        allp2Out = do_allp_netw(allp1Out, allpass_netw_2x, allpass_netw_2y);
-        stereoL = blockIn->data[i] * _width + allp1Out;
-        stereoR = allp1Out - (allp2Out * _width);
-        blockOutL->data[i] = (stereoL * _pancos) + (stereoR * _pansin);
-        blockOutR->data[i] = (stereoR * _pancos) - (stereoL * _pansin);
+        allocFailCount++;
+        AudioStream_F32::release(blockIn);
+        return;
     }
-    AudioStream_F32::transmit(blockOutL, 0);
+    blockOutR->length = blockIn->length;
+    float32_t *out[2] = {blockIn->data, blockOutR->data};
+    process_block(blockIn->data, out, blockIn->length);
+    AudioStream_F32::transmit(blockIn, 0);
     AudioStream_F32::transmit(blockOutR, 1);
-    AudioStream_F32::release(blockOutL);
-    AudioStream_F32::release(blockOutR);
     AudioStream_F32::release(blockIn);
+    AudioStream_F32::release(blockOutR);
 
 #endif
 }
 
 
+// Multi output mode, blockIn is writable, the last output is written in place
+void AudioEffectMonoToStereo_F32::update_multi(audio_block_f32_t *blockIn)
+{
+    audio_block_f32_t *blockOut[MONOTOSTEREO_OUT_MAX];
+    float32_t *out[MONOTOSTEREO_OUT_MAX];
+    const uint8_t nOut = outputs;
+    const uint8_t oLast = nOut - 1;
+    uint32_t o;
+
+    for (o = 0; o < oLast; o++)
+    {
+        blockOut[o] = AudioStream_F32::allocate_f32();
+        if (!blockOut[o])
+        {
+            allocFailCount++;
+            while (o) AudioStream_F32::release(blockOut[--o]);
+            AudioStream_F32::release(blockIn);
+            return;
+        }
+        blockOut[o]->length = blockIn->length;
+        out[o] = blockOut[o]->data;
+    }
+    blockOut[oLast] = blockIn;
+    out[oLast] = blockIn->data;
+    process_block(blockIn->data, out, blockIn->length);
+    for (o = 0; o < nOut; o++)
+    {
+        AudioStream_F32::transmit(blockOut[o], o);
+        AudioStream_F32::release(blockOut[o]);
+    }
+}
+
+void AudioEffectMonoToStereo_F32::process(const float32_t *const *in, float32_t *const *out, uint32_t n)
+{
+    params.fetch(prm);
+    outputs = prm.multiOutputs;
+    process_block(in[0], out, n);
+}
+
+// the outputs (mode) of the block are set by the caller, a change of 
+// prm.multiOutputs in the block takes effect in the next one
+void AudioEffectMonoToStereo_F32::process_block(const float32_t *src, float32_t *const *out, uint32_t n)
+{
+#if defined(__ARM_ARCH_7EM__) || defined(HX_HOST_BUILD)
+    const uint8_t nOut = outputs ? outputs : 2;
+    float32_t *dst[MONOTOSTEREO_OUT_MAX];
+    uint32_t len, seg, o;
+
+    seg = params.fetch(prm, n);         // samples up to the next scheduled change
+    if (prm.bypass && seg == n)
+    {
+        for (o = 0; o < nOut; o++)
+            if (out[o] != src) memcpy(out[o], src, n * sizeof(float32_t));
+        return;
+    }
+    AUDIO_PROFILE_START(profile);
+    for (o = 0; o < nOut; o++) dst[o] = out[o];
+    while (n)
+    {
+        for (n -= seg; seg; seg -= len)     // tap buffers are one block long
+        {
+            len = min(seg, (uint32_t)AUDIO_BLOCK_SAMPLES);
+            len = ramp_span(len);
+            if (prm.bypass)
+            {
+                for (o = 0; o < nOut; o++)
+                    if (dst[o] != src) memmove(dst[o], src, len * sizeof(float32_t));
+            }
+            else if (outputs) process_multi(src, dst, len);
+            else process_stereo(src, dst[0], dst[1], len);
+            src += len;
+            for (o = 0; o < nOut; o++) dst[o] += len;
+        }
+        if (n) seg = params.fetch(prm, n);
+    }
+    AUDIO_PROFILE_COMMIT(profile);
+#endif
+}
+
+// samples of len with one step of the ramps in use, see utility_ramp.h
+uint32_t AudioEffectMonoToStereo_F32::ramp_span(uint32_t len)
+{
+    uint32_t o, j;
+    if (outputs)
+    {
+        for (o = 0; o < outputs; o++)
+            for (j = 0; j < MONOTOSTEREO_TAP_NUM; j++) len = mtxRamp[o][j].span(prm.matrix[o][j], len);
+    }
+    else
+    {
+        len = widthRamp.span(prm.width, len);
+        len = pancosRamp.span(prm.pancos, len);
+        len = pansinRamp.span(prm.pansin, len);
+    }
+    return len;
+}
+
+// Stereo mode, len <= ramp_span() <= AUDIO_BLOCK_SAMPLES
+void AudioEffectMonoToStereo_F32::process_stereo(const float32_t *src, float32_t *outL, float32_t *outR, uint32_t len)
+{
+    bool ramp = widthRamp.begin(prm.width, len);   // parameter ramps, see utility_ramp.h
+    ramp |= pancosRamp.begin(prm.pancos, len);
+    ramp |= pansinRamp.begin(prm.pansin, len);
+    float32_t _width = widthRamp.value;
+    float32_t _pancos = pancosRamp.value;
+    float32_t _pansin = pansinRamp.value;
+    float32_t wOut, stereoL, stereoR;
+    const float32_t *mixA, *mixB, *mixC;
+    uint32_t i;
+
+    // L = a*width + b, R = b - c*width
+    if (prm.engine == MONOTOSTEREO_ENGINE_VELVET)
+    {
+        // a = c = side, b = dry: L + R = 2*dry
+        do_velvet(src, tapBuf[0], len);
+        mixA = tapBuf[0];
+        mixB = src;
+        mixC = tapBuf[0];
+    }
+    else if (prm.engine == MONOTOSTEREO_ENGINE_HILBERT)
+    {
+        // a = c = Q, b = I: L = I + w*Q, R = I - w*Q
+        do_hilbert(src, tapBuf[0], tapBuf[1], len);
+        mixA = tapBuf[1];
+        mixB = tapBuf[0];
+        mixC = tapBuf[1];
+    }
+    else
+    {
+        float32_t *taps[ALLP_TAPS] = {nullptr};
+        taps[MONOTOSTEREO_TAP_NET1 - 1] = tapBuf[MONOTOSTEREO_TAP_NET1 - 1];
+        taps[MONOTOSTEREO_TAP_NET2 - 1] = tapBuf[MONOTOSTEREO_TAP_NET2 - 1];
+        run_allp(src, taps, len);
+        // a = dry, b = network 1 out, c = network 2 out
+        mixA = src;
+        mixB = taps[MONOTOSTEREO_TAP_NET1 - 1];
+        mixC = taps[MONOTOSTEREO_TAP_NET2 - 1];
+    }
+    AUDIO_PROFILE_LAP(profile, PROF_NETWORK);
+    // in place: all inputs of sample i are read before L is written over the dry signal
+    for (i = 0; i < len; i++)
+    {
+        wOut = mixB[i];
+        stereoL = mixA[i] * _width + wOut;
+        stereoR = wOut - (mixC[i] * _width);
+        outL[i] = (stereoL * _pancos) + (stereoR * _pansin);
+        outR[i] = (stereoR * _pancos) - (stereoL * _pansin);
+        if (ramp)
+        {
+            _width += widthRamp.step;
+            _pancos += pancosRamp.step;
+            _pansin += pansinRamp.step;
+        }
+    }
+    widthRamp.end();
+    pancosRamp.end();
+    pansinRamp.end();
+    AUDIO_PROFILE_LAP(profile, PROF_MIX);
+}
+
+// Multi output mode, outputs mixed from the network taps, len <= ramp_span() <= AUDIO_BLOCK_SAMPLES
+// only the last output can be written over the input
+void AudioEffectMonoToStereo_F32::process_multi(const float32_t *src, float32_t * const *out, uint32_t len)
+{
+    float32_t g[MONOTOSTEREO_TAP_NUM], gStep[MONOTOSTEREO_TAP_NUM];
+    float32_t *taps[ALLP_TAPS];
+    const float32_t *tapSrc[MONOTOSTEREO_TAP_NUM];
+    const uint8_t nOut = outputs;
+    const uint8_t oLast = nOut - 1;
+    float32_t acc, *dst;
+    const float32_t *tap;
+    uint32_t o, j, i;
+    bool ramp = false;
+
+    // the gains ramp to the new matrix values, see utility_ramp.h
+    for (o = 0; o < nOut; o++)
+        for (j = 0; j < MONOTOSTEREO_TAP_NUM; j++) mtxRamp[o][j].begin(prm.matrix[o][j], len);
+    // only the taps used in the matrix are computed
+    tapSrc[MONOTOSTEREO_TAP_DRY] = src;
+    for (j = 0; j < ALLP_TAPS; j++)
+    {
+        taps[j] = nullptr;
+        for (o = 0; o < nOut; o++)
+            if (mtxRamp[o][j + 1].value != 0.0f || mtxRamp[o][j + 1].step != 0.0f) taps[j] = tapBuf[j];
+        tapSrc[j + 1] = tapBuf[j];
+    }
+    run_allp(src, taps, len);
+    AUDIO_PROFILE_LAP(profile, PROF_NETWORK);
+    for (o = 0; o < oLast; o++)
+    {
+        dst = out[o];
+        memset(dst, 0, len * sizeof(float32_t));
+        for (j = 0; j < MONOTOSTEREO_TAP_NUM; j++)
+        {
+            g[0] = mtxRamp[o][j].value;
+            gStep[0] = mtxRamp[o][j].step;
+            tap = tapSrc[j];
+            if (gStep[0] != 0.0f)
+            {
+                for (i = 0; i < len; i++) 
+                {
+                    dst[i] += g[0] * tap[i];
+                    g[0] += gStep[0];
+                }
+            }
+            else if (g[0] != 0.0f)
+            {
+                for (i = 0; i < len; i++) dst[i] += g[0] * tap[i];
+            }
+        }
+    }
+    // last output sample by sample, can be the dry signal buffer
+    for (j = 0; j < MONOTOSTEREO_TAP_NUM; j++)
+    {
+        g[j] = mtxRamp[oLast][j].value;
+        gStep[j] = mtxRamp[oLast][j].step;
+        if (gStep[j] != 0.0f) ramp = true;
+    }
+    dst = out[oLast];
+    for (i = 0; i < len; i++)
+    {
+        acc = 0.0f;
+        for (j = 0; j < MONOTOSTEREO_TAP_NUM; j++) acc += g[j] * tapSrc[j][i];
+        dst[i] = acc;
+        if (ramp)
+            for (j = 0; j < MONOTOSTEREO_TAP_NUM; j++) g[j] += gStep[j];
+    }
+    for (o = 0; o < nOut; o++)
+        for (j = 0; j < MONOTOSTEREO_TAP_NUM; j++) mtxRamp[o][j].end();
+    AUDIO_PROFILE_LAP(profile, PROF_MIX);
+}
+
+// Allpass networks with the quality switch crossfade, writes the
+// taps with a non null pointer
+void AudioEffectMonoToStereo_F32::run_allp(const float32_t *src, float32_t * const *taps, uint32_t len)
+{
+    monoToStereo_quality_e q = prm.quality;
+    float32_t *xfTaps[ALLP_TAPS];
+    uint32_t i, j;
+
+    if (q != quality && !xfadeLeft)                 // start a new crossfade
+    {
+        allp_load(pipeline[pipelineIdx ^ 1], q);
+        quality = q;
+        xfadeLeft = ALLP_XFADE_LEN;
+    }
+    do_allp_netw(pipeline[pipelineIdx], src, taps, len);
+    if (!xfadeLeft) return;
+    // equal gain (linear) crossfade: both networks approximate the same
+    // phase response, their outputs are correlated, an equal power fade 
+    // would be ~3dB louder halfway. The fade ends at sample seg, the rest
+    // of the block is the new network alone.
+    uint32_t seg = min(len, xfadeLeft);
+    const float32_t gStep = 1.0f / ALLP_XFADE_LEN;
+    float32_t g0 = (float32_t)(ALLP_XFADE_LEN - xfadeLeft) * gStep;
+    float32_t g, *dst, *xf;
+    for (j = 0; j < ALLP_TAPS; j++) xfTaps[j] = taps[j] ? xfadeBuf[j] : nullptr;
+    do_allp_netw(pipeline[pipelineIdx ^ 1], src, xfTaps, len);
+    for (j = 0; j < ALLP_TAPS; j++)
+    {
+        if (!taps[j]) continue;
+        dst = taps[j];
+        xf = xfTaps[j];
+        g = g0;
+        for (i = 0; i < seg; i++)
+        {
+            dst[i] += (xf[i] - dst[i]) * g;
+            g += gStep;
+        }
+        for (; i < len; i++) dst[i] = xf[i];
+    }
+    xfadeLeft -= seg;
+    if (!xfadeLeft) pipelineIdx ^= 1;           // new network takes over
+}
+
+// Loads the coefficients of the selected network length and clears the states.
+// Cascade order does not change the response, single 1st order stages
+// are moved to both ends of the pipeline, sections in between.
+void AudioEffectMonoToStereo_F32::allp_load(allp_pipeline_t &p, monoToStereo_quality_e q)
+{
+    const allp_sections_t &t = allpass_sections[q];
+    const int32_t last = 2 * t.sections + 1;
+    p.sections = t.sections;
+    p.k1[0] = p.k1[last] = t.k0;
+    p.k2[0] = p.k2[last] = 0.0f;
+    for (int i = 0; i < t.sections; i++)
+    {
+        p.k1[1 + i] = p.k1[1 + t.sections + i] = t.k1[i];
+        p.k2[1 + i] = p.k2[1 + t.sections + i] = t.k2[i];
+    }
+    for (int q = 0; q < 4; q++)                 // taps at the quarters of each network
+    {
+        p.tapStage[q] = (t.sections * (q + 1) + 2) / 4;
+        p.tapStage[4 + q] = t.sections + p.tapStage[q];
+    }
+    p.tapStage[ALLP_TAPS - 1] = last;           // network 2 output is the last 1st order stage
+    memset(p.x1, 0, sizeof(p.x1));
+    memset(p.u1, 0, sizeof(p.u1));
+    memset(p.out, 0, sizeof(p.out));
+}
+
+// 1st order stage:
 // y[n] = c*x[n] + x[n-1] - c*y[n-1]
 // y[n] = c*(x[n] - y[n-1]) + x[n-1]
 // c = (tan(pi*fc/fs)-1) / (tan(pi*fc/fs)+1)
-float32_t AudioEffectMonoToStereo_F32::do_allp_netw(float32_t inSig, float32_t *x, float32_t *y)
-{
-    uint32_t stg = ALLP_NETWORK_LEN;
-    while (stg)
-    {
-        stg--;
-        y[stg] = allpass_k_table[stg] * (inSig - y[stg]) + x[stg];
-        x[stg] = inSig;
-        inSig = y[stg];
-                stg--;
-        y[stg] = allpass_k_table[stg] * (inSig - y[stg]) + x[stg];
-        x[stg] = inSig;
-        inSig = y[stg];
-                stg--;
-        y[stg] = allpass_k_table[stg] * (inSig - y[stg]) + x[stg];
-        x[stg] = inSig;
-        inSig = y[stg];
-    }
-    return y[0];
-}
\ No newline at end of file
+// 2nd order section, two 1st order stages in one step:
+// u[n] = c1*(x[n] - u[n-1]) + x[n-1]
+// y[n] = c2*(u[n] - y[n-1]) + u[n-1]
+// Wavefront evaluation: in step t the stage k works on the sample t-k.
+// Stages are updated from the last one down, each reads the output its 
+// predecessor produced in the previous step, so there are no dependencies
+// between the stages within one step (fills the FPU pipeline, vectorizes).
+// The pipeline is filled at the block start and drained at the end, 
+// no latency is added.
+void AudioEffectMonoToStereo_F32::do_allp_netw(allp_pipeline_t &p, const float32_t *src, float32_t * const *taps, uint32_t len)
+{
+    const int32_t n = len;
+    const int32_t last = 2 * p.sections + 1;        // output 1st order stage
+    float32_t *tapOut[ALLP_TAPS];
+    int32_t tapStage[ALLP_TAPS];
+    float32_t inSig, mid;
+    int32_t t, k, kHi, kLo, j, st, nTaps = 0;
+
+    for (j = 0; j < ALLP_TAPS; j++)                 // active taps only
+    {
+        if (!taps[j]) continue;
+        tapOut[nTaps] = taps[j];
+        tapStage[nTaps++] = p.tapStage[j];
+    }
+    for (t = 0; t < n + last; t++)
+    {
+        kHi = t < last ? t : last;                  // last active stage
+        kLo = t < n ? 1 : t - n + 1;                // first active stage, stage 0 is done separately
+        if (kHi == last)
+        {
+            inSig = p.out[last - 1];
+            p.out[last] = p.k1[last] * (inSig - p.out[last]) + p.x1[last];
+            p.x1[last] = inSig;
+            kHi--;
+        }
+        for (k = kHi; k >= kLo; k--)
+        {
+            inSig = p.out[k - 1];
+            mid = p.k1[k] * (inSig - p.u1[k]) + p.x1[k];
+            p.out[k] = p.k2[k] * (mid - p.out[k]) + p.u1[k];
+            p.x1[k] = inSig;
+            p.u1[k] = mid;
+        }
+        if (t < n)
+        {
+            inSig = src[t];
+            p.out[0] = p.k1[0] * (inSig - p.out[0]) + p.x1[0];
+            p.x1[0] = inSig;
+        }
+        for (j = 0; j < nTaps; j++)
+        {
+            st = tapStage[j];
+            if (t >= st && t - st < n) tapOut[j][t - st] = p.out[st];
+        }
+    }
+    // decayed states, see utility_denormal.h
+    denormal_snap(p.x1, ALLP_PIPELINE_LEN);
+    denormal_snap(p.u1, ALLP_PIPELINE_LEN);
+    denormal_snap(p.out, ALLP_PIPELINE_LEN);
+}
+
+// Velvet noise decorrelator, sparse FIR with +-1 taps:
+// side[n] = sum(gain[seg] * sign[k] * x[n - delay[k]])
+// Taps are summed without multiplies, the gain is applied once per segment. 
+// The new block is appended to the history, the history is shifted 
+// after processing, so all taps read a linear buffer.
+// 4 output samples are computed in one pass: 4 independent add chains
+// keep the FPU pipeline busy.
+void AudioEffectMonoToStereo_F32::do_velvet(const float32_t *src, float32_t *side, uint32_t len)
+{
+    const uint32_t tapsPerSeg = VELVET_TAPS / VELVET_SEGMENTS;
+    const float32_t *xn = &velvetBuf[VELVET_LEN];
+    const float32_t *x;
+    float32_t out0, out1, out2, out3, sum0, sum1, sum2, sum3, g;
+    uint32_t n, seg, k;
+
+    memcpy(&velvetBuf[VELVET_LEN], src, len * sizeof(float32_t));
+    for (n = 0; n + 4 <= len; n += 4, xn += 4)
+    {
+        out0 = out1 = out2 = out3 = 0.0f;
+        k = 0;
+        for (seg = 0; seg < VELVET_SEGMENTS; seg++)
+        {
+            sum0 = sum1 = sum2 = sum3 = 0.0f;
+            for (; k < velvet_taps.posEnd[seg]; k++)
+            {
+                x = xn - velvet_taps.delay[k];
+                sum0 += x[0];
+                sum1 += x[1];
+                sum2 += x[2];
+                sum3 += x[3];
+            }
+            for (; k < (seg + 1) * tapsPerSeg; k++)
+            {
+                x = xn - velvet_taps.delay[k];
+                sum0 -= x[0];
+                sum1 -= x[1];
+                sum2 -= x[2];
+                sum3 -= x[3];
+            }
+            g = velvet_seg_gain[seg];
+            out0 += g * sum0;
+            out1 += g * sum1;
+            out2 += g * sum2;
+            out3 += g * sum3;
+        }
+        side[n] = out0;
+        side[n + 1] = out1;
+        side[n + 2] = out2;
+        side[n + 3] = out3;
+    }
+    for (; n < len; n++, xn++)                                  // odd block length tail
+    {
+        out0 = 0.0f;
+        k = 0;
+        for (seg = 0; seg < VELVET_SEGMENTS; seg++)
+        {
+            sum0 = 0.0f;
+            for (; k < velvet_taps.posEnd[seg]; k++) sum0 += xn[-velvet_taps.delay[k]];
+            for (; k < (seg + 1) * tapsPerSeg; k++) sum0 -= xn[-velvet_taps.delay[k]];
+            out0 += velvet_seg_gain[seg] * sum0;
+        }
+        side[n] = out0;
+    }
+    memmove(velvetBuf, &velvetBuf[len], VELVET_LEN * sizeof(float32_t));
+}
+
+// Polyphase IIR Hilbert transformer, each stage:
+// y[n] = a^2 * (x[n] + y[n-2]) - x[n-2]
+// The recursion only reaches 2 samples back: even and odd samples
+// form two independent half rate chains, which also keeps the FPU 
+// pipeline busy. Stages are run one after another over the whole block.
+// The 1 sample delay of path I is applied to its input.
+void AudioEffectMonoToStereo_F32::do_hilbert(const float32_t *src, float32_t *outI, float32_t *outQ, uint32_t len)
+{
+    float32_t k, x0, x1, x2, y0, y1, y2;
+    float32_t *buf;
+    uint32_t n, stg;
+
+    if (!len) return;
+    outI[0] = hilbert_dly;
+    memcpy(outI + 1, src, (len - 1) * sizeof(float32_t));
+    hilbert_dly = src[len - 1];
+    memcpy(outQ, src, len * sizeof(float32_t));
+
+    for (stg = 0; stg < 2 * HILBERT_STAGES; stg++)
+    {
+        buf = stg < HILBERT_STAGES ? outI : outQ;
+        k = hilbert_k_table[stg];
+        x1 = hilbert_st[stg][0];
+        x2 = hilbert_st[stg][1];
+        y1 = hilbert_st[stg][2];
+        y2 = hilbert_st[stg][3];
+        for (n = 0; n < len; n++)
+        {
+            x0 = buf[n];
+            y0 = k * (x0 + y2) - x2;
+            buf[n] = y0;
+            x2 = x1;
+            x1 = x0;
+            y2 = y1;
+            y1 = y0;
+        }
+        hilbert_st[stg][0] = x1;
+        hilbert_st[stg][1] = x2;
+        hilbert_st[stg][2] = y1;
+        hilbert_st[stg][3] = y2;
+    }
+    denormal_snap(&hilbert_st[0][0], 2 * HILBERT_STAGES * 4);  // decayed states, see utility_denormal.h
+}
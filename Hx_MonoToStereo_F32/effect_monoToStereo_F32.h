@@ -35,8 +35,54 @@
 #include <Arduino.h>
 #include "AudioStream_F32.h"
 #include "arm_math.h"
+#include "utility_profile.h"
+#include "utility_params.h"
+#include "utility_ramp.h"
+#include "utility_denormal.h"
 
-#define ALLP_NETWORK_LEN    21
+#define ALLP_NETWORK_LEN    21                          // max 1st order stages per network
+#define ALLP_SECTIONS       (ALLP_NETWORK_LEN/2)            // stage pairs run as 2nd order sections
+#define ALLP_PIPELINE_LEN   (2*ALLP_SECTIONS + 2)           // both networks chained + 2 single 1st order stages
+#define ALLP_XFADE_BLOCKS   16                              // quality switch crossfade time in blocks
+#define ALLP_XFADE_LEN      (ALLP_XFADE_BLOCKS * AUDIO_BLOCK_SAMPLES)   // same in samples
+#define ALLP_TAPS           8                               // outputs taken from the pipeline, see monoToStereo_tap_e
+#define MONOTOSTEREO_OUT_MAX 8                              // max outputs in the multi output mode
+
+#define VELVET_LEN          1024                            // velvet noise FIR length, ~23ms @ 44.1kHz
+#define VELVET_TAPS         32                              // one +-1 tap per VELVET_LEN/VELVET_TAPS samples
+#define VELVET_SEGMENTS     4                               // tap groups with decaying gain
+
+#define HILBERT_STAGES      4                               // 2nd order allpass stages per Hilbert path
+
+typedef enum
+{
+    MONOTOSTEREO_QUALITY_LOW,       // 7 stages per network
+    MONOTOSTEREO_QUALITY_MID,       // 13 stages per network
+    MONOTOSTEREO_QUALITY_HIGH,      // 21 stages per network
+    MONOTOSTEREO_QUALITY_NUM
+}monoToStereo_quality_e;
+
+typedef enum
+{
+    MONOTOSTEREO_ENGINE_ALLPASS,    // allpass networks, default
+    MONOTOSTEREO_ENGINE_VELVET,     // sparse velvet noise FIR
+    MONOTOSTEREO_ENGINE_HILBERT     // polyphase IIR Hilbert transformer
+}monoToStereo_engine_e;
+
+// multi output mode matrix inputs, quarters of both allpass networks
+typedef enum
+{
+    MONOTOSTEREO_TAP_DRY,           // input signal
+    MONOTOSTEREO_TAP_NET1_Q1,       // network 1, after 1/4 of the sections
+    MONOTOSTEREO_TAP_NET1_Q2,
+    MONOTOSTEREO_TAP_NET1_Q3,
+    MONOTOSTEREO_TAP_NET1,          // network 1 output
+    MONOTOSTEREO_TAP_NET2_Q1,       // network 2, after 1/4 of the sections
+    MONOTOSTEREO_TAP_NET2_Q2,
+    MONOTOSTEREO_TAP_NET2_Q3,
+    MONOTOSTEREO_TAP_NET2,          // network 2 output
+    MONOTOSTEREO_TAP_NUM
+}monoToStereo_tap_e;
 
 class AudioEffectMonoToStereo_F32 : public AudioStream_F32
 {
@@ -44,36 +90,165 @@ public:
     AudioEffectMonoToStereo_F32();
     ~AudioEffectMonoToStereo_F32();
     virtual void update();
+    /**
+     * @brief Processing core called by update(), can be used without the
+     *  audio library for any block length
+     * 
+     * @param in    in[0] mono input
+     * @param out   out[0], out[1] L/R or the multi outputs. out[0] (stereo)
+     *  or the last output (multi) can be the same buffer as in[0]
+     * @param n     number of samples
+     */
+    void process(const float32_t *const *in, float32_t *const *out, uint32_t n);
+    enum {PROC_IN = 1, PROC_OUT = 2};   // audio channels of process(), see effect_chain_F32.h
     void setSpread(float32_t val)
     { 
-        val = constrain(val, 0.0f, 1.0f);
-        __disable_irq();
-        width = val;
-        __enable_irq();
+        params.edit().width = constrain(val, 0.0f, 1.0f);
+        params.publish();
     }
     void setPan(float32_t val)
     {
-        float32_t a, b;
+        params_t &p = params.edit();
         val = constrain(val, -1.0f, 1.0f);
-        a = map(val, -1.0f, 1.0f, -0.707f, 0.707f);
-        b = 1.0f - abs(val*0.293f);
-        __disable_irq();
-        pansin = a;
-        pancos = b;
-        __enable_irq();
+        p.pansin = map(val, -1.0f, 1.0f, -0.707f, 0.707f);
+        p.pancos = 1.0f - abs(val*0.293f);
+        params.publish();
+    }
+    /**
+     * @brief selects the length of the allpass networks. Shorter networks 
+     *  spread the signal into fewer bands at a lower CPU cost. 
+     *  The change is crossfaded over ALLP_XFADE_BLOCKS blocks.
+     * 
+     * @param q quality tier
+     */
+    void setQuality(monoToStereo_quality_e q)
+    {
+        if (q >= MONOTOSTEREO_QUALITY_NUM) q = MONOTOSTEREO_QUALITY_HIGH;
+        params.edit().quality = q;
+        params.publish();
     }
-    void setBypass(bool state) {bypass = state;}
-    void tglBypass(void) {bypass ^= 1;}
-    bool getBypass(void) { return bypass;}
+    monoToStereo_quality_e getQuality(void) { return params.get().quality;}
+    /**
+     * @brief selects the decorrelator used to generate the side signal
+     *  ALLPASS - recursive allpass networks
+     *  VELVET - sparse velvet noise FIR, lower CPU load, L+R sums back 
+     *      to the dry signal (fully mono compatible)
+     *  HILBERT - 90deg phase shifted pair from two allpass chains, lowest
+     *      CPU load, L and R are 90deg apart at all frequencies
+     * 
+     * @param e engine
+     */
+    void setEngine(monoToStereo_engine_e e) { params.edit().engine = e; params.publish();}
+    monoToStereo_engine_e getEngine(void) { return params.get().engine;}
+    /**
+     * @brief Multi output mode: the allpass networks run once, outputs 
+     *  0..n-1 are mixed from the network taps by a matrix.
+     *  setSpread, setPan and setEngine have no effect in this mode.
+     *  The number of outputs changes at the start of a block (update() or
+     *  process() call), a change scheduled with at() in the first block
+     *  starting after t.
+     * 
+     * @param n number of outputs, 1..MONOTOSTEREO_OUT_MAX, 0 = stereo mode
+     */
+    void setMultiOutput(uint8_t n) { params.edit().multiOutputs = min(n, MONOTOSTEREO_OUT_MAX); params.publish();}
+    uint8_t getMultiOutput(void) { return params.get().multiOutputs;}
+    /**
+     * @brief sets one multi output matrix gain. Only the taps with
+     *  a non zero gain in any of the active outputs are computed.
+     * 
+     * @param out output 0..MONOTOSTEREO_OUT_MAX-1
+     * @param tap network tap
+     * @param gain 
+     */
+    void setMatrix(uint8_t out, monoToStereo_tap_e tap, float32_t gain)
+    {
+        if (out >= MONOTOSTEREO_OUT_MAX || tap >= MONOTOSTEREO_TAP_NUM) return;
+        params.edit().matrix[out][tap] = gain;
+        params.publish();
+    }
+    /**
+     * @brief sets all multi output matrix gains, published as one change
+     * 
+     * @param m gains [output][tap]
+     */
+    void setMatrix(const float32_t m[MONOTOSTEREO_OUT_MAX][MONOTOSTEREO_TAP_NUM])
+    {
+        memcpy(params.edit().matrix, m, sizeof(params_t::matrix));
+        params.publish();
+    }
+    float32_t getMatrix(uint8_t out, monoToStereo_tap_e tap)
+    {
+        if (out >= MONOTOSTEREO_OUT_MAX || tap >= MONOTOSTEREO_TAP_NUM) return 0.0f;
+        return params.get().matrix[out][tap];
+    }
+    void setBypass(bool state) { params.edit().bypass = state; params.publish();}
+    void tglBypass(void) { setBypass(!params.get().bypass);}
+    bool getBypass(void) { return params.get().bypass;}
+    /**
+     * @brief number of updates skipped because an output block
+     *  could not be allocated (AudioMemory_F32 too low)
+     */
+    uint32_t getAllocFailures(void) { return allocFailCount;}
+
+    /**
+     * @brief Sample accurate automation: the next setter call takes effect
+     *          at sample t of time(), see utility_params.h
+     */
+    bool at(uint32_t t) { return params.at(t);}
+    uint32_t time(void) { return params.time();}
+    void advance(uint32_t n) { params.advance(n);}  // clock of a bypassed chain stage
+
+    enum {PROF_NETWORK, PROF_MIX, PROF_NUM};   // update() stages
+#if defined(AUDIO_PROFILE)
+    AudioProfile profile;           // cycles per update() stage, see utility_profile.h
+#endif
 private:
-    bool bypass;
-    float32_t width;
-    float32_t pancos, pansin;
-    float32_t do_allp_netw(float32_t inSig, float32_t *x, float32_t *y);
-    float32_t allpass_netw_1x[ALLP_NETWORK_LEN];
-    float32_t allpass_netw_1y[ALLP_NETWORK_LEN];
-    float32_t allpass_netw_2x[ALLP_NETWORK_LEN];
-    float32_t allpass_netw_2y[ALLP_NETWORK_LEN];
+    typedef struct
+    {
+        bool bypass;
+        uint8_t multiOutputs;
+        monoToStereo_quality_e quality;
+        monoToStereo_engine_e engine;
+        float32_t width;
+        float32_t pancos, pansin;
+        float32_t matrix[MONOTOSTEREO_OUT_MAX][MONOTOSTEREO_TAP_NUM];
+    } params_t;
+    AudioParams<params_t> params;   // written by the setters
+    params_t prm;                   // in use by update(), see utility_params.h
+    AudioRamp widthRamp, pancosRamp, pansinRamp;    // stereo mode ramps, see utility_ramp.h
+    uint32_t allocFailCount;
+    // pipeline: 0 - 1st order, 1..S - network 1 sections, S+1..2S - network 2 sections, 2S+1 - 1st order
+    struct allp_pipeline_t
+    {
+        float32_t k1[ALLP_PIPELINE_LEN];    // coeffs in processing order
+        float32_t k2[ALLP_PIPELINE_LEN];
+        float32_t x1[ALLP_PIPELINE_LEN];    // previous input
+        float32_t u1[ALLP_PIPELINE_LEN];    // previous output of the 1st stage of a section
+        float32_t out[ALLP_PIPELINE_LEN];   // last output of each stage
+        int32_t sections;                   // S, sections per network
+        uint8_t tapStage[ALLP_TAPS];        // stage for each tap (monoToStereo_tap_e - 1)
+    };
+    void allp_load(allp_pipeline_t &p, monoToStereo_quality_e q);
+    void do_allp_netw(allp_pipeline_t &p, const float32_t *src, float32_t * const *taps, uint32_t len);
+    void run_allp(const float32_t *src, float32_t * const *taps, uint32_t len);
+    void update_multi(audio_block_f32_t *blockIn);
+    void process_block(const float32_t *src, float32_t *const *out, uint32_t n);
+    void process_stereo(const float32_t *src, float32_t *outL, float32_t *outR, uint32_t len);
+    void process_multi(const float32_t *src, float32_t * const *out, uint32_t len);
+    uint32_t ramp_span(uint32_t len);
+    allp_pipeline_t pipeline[2];                // running + crossfade target
+    uint8_t pipelineIdx;
+    uint32_t xfadeLeft;                         // crossfade samples to go
+    monoToStereo_quality_e quality;             // network in use, prm.quality after the crossfade
+    float32_t tapBuf[ALLP_TAPS][AUDIO_BLOCK_SAMPLES];   // network tap outputs
+    float32_t xfadeBuf[ALLP_TAPS][AUDIO_BLOCK_SAMPLES]; // new network tap outputs during crossfade
+    uint8_t outputs;                            // prm.multiOutputs at the start of the block
+    AudioRamp mtxRamp[MONOTOSTEREO_OUT_MAX][MONOTOSTEREO_TAP_NUM];  // matrix gains in use
+    void do_velvet(const float32_t *src, float32_t *side, uint32_t len);
+    float32_t velvetBuf[VELVET_LEN + AUDIO_BLOCK_SAMPLES];  // input history + current block
+    void do_hilbert(const float32_t *src, float32_t *outI, float32_t *outQ, uint32_t len);
+    float32_t hilbert_st[2 * HILBERT_STAGES][4];    // x[n-1], x[n-2], y[n-1], y[n-2] for each stage
+    float32_t hilbert_dly;                          // path I one sample delay
 
     audio_block_f32_t *inputQueueArray_f32[1];   
 };
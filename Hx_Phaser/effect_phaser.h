@@ -31,8 +31,19 @@
 #include "Audio.h"
 #include "AudioStream.h"
 #include "arm_math.h"
+#include "filter_modallpass.h"
+#include "utility_profile.h"
+#include "utility_params.h"
+#include "utility_ramp.h"
 
 #define PHASER_STEREO_STAGES	12
+#define PHASER_HO_STAGES        48      // high order mode, 2nd order allpass sections
+#define PHASER_HO_SUBBLOCK      8       // high order mode coefficient update period
+#define PHASER_LFO_MAX          (32767.0f / 32768.0f)   // top/bottom limit: allpass k < 1.0, fits the Q31 k of the fixed point kernel
+
+// Process the allpass chain in fixed point instead of float: Q31 states and
+// coefficients, no int16<->float conversions, saturating arithmetic on hot inputs
+//#define PHASER_USE_FIXEDPOINT
 
 class AudioEffectPhaser : public AudioStream
 {
@@ -40,24 +51,32 @@ class AudioEffectPhaser : public AudioStream
     AudioEffectPhaser();
     ~AudioEffectPhaser();
     virtual void update();
+    /**
+     * @brief Processing core called by update(), can be used without the
+     *          audio library for any block length
+     * 
+     * @param in    in[0] audio, in[1] bipolar modulation (NULL = LFO or bus)
+     * @param out   out[0] audio, can be the same buffer as in[0]
+     * @param n     number of samples. The bus holds one AUDIO_BLOCK_SAMPLES cycle,
+     *              the read position is carried over to the next call: calls
+     *              shorter than a block step through the same cycle.
+     */
+    void process(const int16_t *const *in, int16_t *const *out, uint32_t n);
 
     /**
      * @brief Scale and offset the modulation signal. It can be the internal LFO
      *          or the incomig routed modulation AudioSignal.
      *          LFO will oscillate between these two max and min values. 
      * 
-     * @param top       top level of the LFO
-     * @param bottom     bottom level of the LFO
+     * @param top       top level of the LFO, 0.0 to PHASER_LFO_MAX
+     * @param bottom     bottom level of the LFO, 0.0 to PHASER_LFO_MAX
      */
     void depth(float32_t top, float32_t bottom)
     {
-        float32_t a, b;
-        a = constrain(top, 0.0f, 1.0f);
-        b = constrain(bottom, 0.0f, 1.0f);
-        __disable_irq();
-        lfo_top = a;
-        lfo_btm = b;
-        __enable_irq();
+        params_t &p = params.edit();
+        p.lfo_top = constrain(top, 0.0f, PHASER_LFO_MAX);
+        p.lfo_btm = constrain(bottom, 0.0f, PHASER_LFO_MAX);
+        params.publish();
     }
     /**
      * @brief Controls the internal LFO, or if a control signal is used, scales it
@@ -69,17 +88,12 @@ class AudioEffectPhaser : public AudioStream
      */
     void lfo(float32_t f_Hz, float32_t top, float32_t btm)
     {
-        float32_t a, b, c;
-        uint32_t add;
-        a = constrain(top, 0.0f, 1.0f);
-        b = constrain(btm, 0.0f, 1.0f);
-        c = constrain(f_Hz, 0.0f, AUDIO_SAMPLE_RATE_EXACT/2);
-        add = c * (4294967296.0 / AUDIO_SAMPLE_RATE_EXACT);
-        __disable_irq();
-        lfo_top = a;
-        lfo_btm = b;
-        lfo_add = add;
-        __enable_irq();
+        params_t &p = params.edit();
+        f_Hz = constrain(f_Hz, 0.0f, AUDIO_SAMPLE_RATE_EXACT/2);
+        p.lfo_top = constrain(top, 0.0f, PHASER_LFO_MAX);
+        p.lfo_btm = constrain(btm, 0.0f, PHASER_LFO_MAX);
+        p.lfo_add = f_Hz * (4294967296.0 / AUDIO_SAMPLE_RATE_EXACT);
+        params.publish();
     }
     /**
      * @brief Set the rate of the internal LFO
@@ -88,13 +102,9 @@ class AudioEffectPhaser : public AudioStream
      */
     void lfo_rate(float32_t f_Hz)
     {
-        float32_t c;
-        uint32_t add;
-        c = constrain(f_Hz, 0.0f, AUDIO_SAMPLE_RATE_EXACT/2);
-        add = c * (4294967296.0 / AUDIO_SAMPLE_RATE_EXACT);
-        __disable_irq();
-        lfo_add = add;
-        __enable_irq();
+        f_Hz = constrain(f_Hz, 0.0f, AUDIO_SAMPLE_RATE_EXACT/2);
+        params.edit().lfo_add = f_Hz * (4294967296.0 / AUDIO_SAMPLE_RATE_EXACT);
+        params.publish();
     }
     /**
      * @brief Controls the feedback parameter
@@ -103,7 +113,8 @@ class AudioEffectPhaser : public AudioStream
      */
     void feedback(float32_t fdb)
     {
-        feedb = constrain(fdb, 0.0f, 1.0f);
+        params.edit().feedb = constrain(fdb, 0.0f, 1.0f);
+        params.publish();
     }
     /**
      * @brief Dry / Wet mixer ratio. Classic Phaser sound uses 0.5f for 50% dry and 50%Wet
@@ -113,42 +124,80 @@ class AudioEffectPhaser : public AudioStream
      */
     void mix(float32_t ratio)
     {
-        mix_ratio = constrain(ratio, 0.0f, 1.0f);
+        params.edit().mix_ratio = constrain(ratio, 0.0f, 1.0f);
+        params.publish();
     }
     /**
      * @brief Sets the number of stages used in the phaser
-     *        Allowed values are: 2, 4, 6, 8, 10, 12
+     *        Allowed values are: 2, 4, 6, 8, 10, 12 
+     *        and 14 to 48 for the high order mode using 2nd order
+     *        allpass sections (always float, coefficients updated every 
+     *        PHASER_HO_SUBBLOCK samples)
      * 
-     * @param st number of stages, even value <= 12
+     * @param st number of stages, even value <= 48
      */
     void stages(uint8_t st)
     {
-        if (st && st == ((st >> 1) << 1) && st <= PHASER_STEREO_STAGES) // only 2, 4, 6, 8, 12 allowed
+        if (st && st == ((st >> 1) << 1) && st <= PHASER_HO_STAGES) // only even values allowed
         {
-            stg = st;
+            params.edit().stg = st;
+            params.publish();
         }
     }
+    /**
+     * @brief Use a modulation bus channel instead of the internal LFO.
+     *          The modulation input [1] has priority if connected.
+     * 
+     * @param src buffer from AudioModulationBus::buffer(), NULL = internal LFO
+     */
+    void modulation(const float32_t *src) { params.edit().modBus = src; params.publish();}
     /**
      * @brief Use to bypass the effect (true)
      * 
      * @param state true = bypass on, false = phaser on
      */
-    void bypass(bool state) {bps = state;}
-    void tgl_bypass(void) {bps ^= 1;}
+    void bypass(bool state) { params.edit().bps = state; params.publish();}
+    void tgl_bypass(void) { bypass(!params.get().bps);}
+
+    /**
+     * @brief Sample accurate automation: the next setter call takes effect
+     *          at sample t of time(), see utility_params.h
+     */
+    bool at(uint32_t t) { return params.at(t);}
+    uint32_t time(void) { return params.time();}
+
+    enum {PROF_MOD, PROF_ALLPASS, PROF_NUM};   // update() stages
+#if defined(AUDIO_PROFILE)
+    AudioProfile profile;           // cycles per update() stage, see utility_profile.h
+#endif
 
 private:
-    uint8_t stg;                                    // number of stages
-    bool bps;                                       // bypass
-    audio_block_t *inputQueueArray[2];      
-    float32_t allpass_x[PHASER_STEREO_STAGES];      // allpass inputs
-	float32_t allpass_y[PHASER_STEREO_STAGES];      // allpass outputs
-	float32_t mix_ratio;                            // 0 = dry. 1.0 = wet
-    float32_t feedb;                                // feedback 
-    float32_t last_sample;
+    typedef struct
+    {
+        uint8_t stg;                                // number of stages
+        bool bps;                                   // bypass
+        float32_t mix_ratio;                        // 0 = dry. 1.0 = wet
+        float32_t feedb;                            // feedback 
+        const float32_t *modBus;                    // modulation bus channel
+        uint32_t lfo_add;
+        float32_t lfo_top;
+        float32_t lfo_btm;
+    } params_t;
+    AudioParams<params_t> params;                   // written by the setters
+    params_t prm;                                   // in use by update(), see utility_params.h
+    AudioRamp fdbRamp, mixRamp;                     // feedback and mix ramps, see utility_ramp.h
+    audio_block_t *inputQueueArray[2];
+    void process_ho(const int16_t *src, const int16_t *mod, const float32_t *bus, int16_t *dst, uint32_t len);
+    void process_block(const int16_t *src, const int16_t *mod, const float32_t *bus, int16_t *dst, uint32_t len);      
+#ifdef PHASER_USE_FIXEDPOINT
+    AudioFilterModAllpassQ31<PHASER_STEREO_STAGES> allpass; // allpass chain + feedback state
+#else
+    AudioFilterModAllpass<PHASER_STEREO_STAGES> allpass;    // allpass chain + feedback state
+#endif
+    AudioFilterModAllpass2<PHASER_HO_STAGES/2> allpassHO;  // high order mode allpass sections
+    bool hoActive;                                  // high order mode was used in the last update
     uint32_t lfo_phase_acc;                         // interfnal lfo 
-    uint32_t lfo_add;
-    float32_t lfo_top;
-    float32_t lfo_btm;
+    uint32_t busPos;                                // modulation bus read position, see process()
 };
 
 #endif // _EFFECT_PHASER_H
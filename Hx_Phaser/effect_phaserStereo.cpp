@@ -0,0 +1,224 @@
+/*  Stereo quadrature Phaser/Vibrato effect for Teensy Audio library
+ *
+ *  Author: Piotr Zapart
+ *          www.hexefx.com
+ *
+ * Copyright (c) 2021 by Piotr Zapart
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <Arduino.h>
+#include "effect_phaserStereo.h"
+
+#if defined(AUDIO_PROFILE)
+static const char *const profNames[] = {"mod", "allpass"};
+#endif
+
+AudioEffectPhaserStereo::AudioEffectPhaserStereo() : AudioStream(3, inputQueueArray)
+{
+    params_t &p = params.edit();
+    allpass.reset();
+    lfo_phase_acc = 0;
+    busPos = 0;
+    p.modBus[0] = p.modBus[1] = NULL;
+    p.bps = false;
+    p.lfo_add = 0;
+    p.lfo_offset = PHASER_STEREO_LFO_OFFSET;
+    p.lfo_top = 1.0f;
+    p.lfo_btm = 0.0f;
+    p.feedb = 0.0f;
+    p.mix_ratio = 0.5f;         // start with classic phaser sound 
+    p.stg = PHASER_STEREO_STAGES;
+    params.publish();
+    params.fetch(prm);
+    AUDIO_PROFILE_INIT(profile, profNames, PROF_NUM);
+}
+AudioEffectPhaserStereo::~AudioEffectPhaserStereo()
+{
+}
+
+void AudioEffectPhaserStereo::update()
+{
+#if defined(__ARM_ARCH_7EM__) || defined(HX_HOST_BUILD)
+    audio_block_t *blockL, *blockR; 
+    const audio_block_t *blockMod;    // inputs
+
+    blockL = receiveWritable(0);
+    blockR = receiveWritable(1);
+    blockMod = receiveReadOnly(2);      // bipolar/int16_t control input
+    
+    if (!blockL || !blockR)
+    {
+        if (blockL) release(blockL);
+        if (blockR) release(blockR);
+        if (blockMod) release((audio_block_t *)blockMod);
+        return;
+    }
+    const int16_t *in[3] = {blockL->data, blockR->data, blockMod ? blockMod->data : NULL};
+    int16_t *out[2] = {blockL->data, blockR->data};
+    process(in, out, AUDIO_BLOCK_SAMPLES);  // bypass: the input blocks are sent unchanged
+    if (blockMod) release((audio_block_t *)blockMod);
+    transmit(blockL, 0);
+    transmit(blockR, 1);
+	release(blockL);
+	release(blockR);
+#endif
+}
+
+void AudioEffectPhaserStereo::process(const int16_t *const *in, int16_t *const *out, uint32_t n)
+{
+#if defined(__ARM_ARCH_7EM__) || defined(HX_HOST_BUILD)
+    const int16_t *src[2] = {in[0], in[1]};
+    const int16_t *mod = in[2];
+    int16_t *dst[2] = {out[0], out[1]};
+    const float32_t *bus[2];
+    uint32_t len, seg, busIdx;
+    uint32_t pos = busPos;
+
+    seg = params.fetch(prm, n);         // samples up to the next scheduled change
+    if (prm.bps && seg == n)
+    {
+        if (dst[0] != src[0]) memcpy(dst[0], src[0], n * sizeof(int16_t));
+        if (dst[1] != src[1]) memcpy(dst[1], src[1], n * sizeof(int16_t));
+        busPos = (busPos + n) % AUDIO_BLOCK_SAMPLES;
+        return;
+    }
+    AUDIO_PROFILE_START(profile);
+    while (n)
+    {
+        for (n -= seg; seg; seg -= len)
+        {
+            busIdx = pos % AUDIO_BLOCK_SAMPLES;         // modulation buffers are one block long
+            len = min(seg, AUDIO_BLOCK_SAMPLES - busIdx);
+            len = fdbRamp.span(prm.feedb, len);         // parameter ramps, see utility_ramp.h
+            len = mixRamp.span(prm.mix_ratio, len);
+            if (prm.bps)
+            {
+                if (dst[0] != src[0]) memcpy(dst[0], src[0], len * sizeof(int16_t));
+                if (dst[1] != src[1]) memcpy(dst[1], src[1], len * sizeof(int16_t));
+            }
+            else
+            {
+                bus[0] = prm.modBus[0] ? prm.modBus[0] + busIdx : NULL;
+                bus[1] = prm.modBus[1] ? prm.modBus[1] + busIdx : bus[0];
+                process_block(src, mod, bus, dst, len);
+            }
+            src[0] += len; src[1] += len;
+            dst[0] += len; dst[1] += len;
+            if (mod) mod += len;
+            pos += len;
+        }
+        if (n) seg = params.fetch(prm, n);
+    }
+    busPos = pos % AUDIO_BLOCK_SAMPLES;
+    AUDIO_PROFILE_COMMIT(profile);
+#endif
+}
+
+// len <= AUDIO_BLOCK_SAMPLES
+void AudioEffectPhaserStereo::process_block(const int16_t *const *src, const int16_t *mod, const float32_t *const *bus, int16_t *const *dst, uint32_t len)
+{
+    uint32_t i;
+    uint32_t phaseAcc = lfo_phase_acc;
+    uint32_t phaseAdd = prm.lfo_add;
+    uint32_t offset = prm.lfo_offset;
+    float32_t top = prm.lfo_top;
+    float32_t btm = prm.lfo_btm;
+
+    fdbRamp.begin(prm.feedb, len);      // len <= span(), see process()
+    mixRamp.begin(prm.mix_ratio, len);
+#ifdef PHASER_USE_FIXEDPOINT
+    int32_t modSig[AUDIO_BLOCK_SAMPLES][2];
+    uint32_t lfo[2];
+    // Q31 k = (0 to 65535) * modScale + modOffset, as the float k, < 1.0 (PHASER_LFO_MAX)
+    uint32_t modScale = abs(top - btm) * (2147483648.0f / 65535.0f);
+    uint32_t modOffset = min(top, btm) * 2147483648.0f;
+    if (mod)            // modulation input provided
+    {
+        for (i=0; i < len; i++)
+        {
+            modSig[i][0] = (uint32_t)(mod[i] + 32768) * modScale + modOffset;  // mod signal is 0 to 65535
+            modSig[i][1] = modSig[i][0];
+        }
+    }
+    else if (bus[0])    // modulation bus channels, bus[1] = bus[0] if only one is used
+    {
+        float32_t busScale = abs(top - btm) * 2147483648.0f;
+        for (i=0; i < len; i++)
+        {
+            modSig[i][0] = (uint32_t)(bus[0][i] * busScale) + modOffset;
+            modSig[i][1] = (uint32_t)(bus[1][i] * busScale) + modOffset;
+        }
+    }
+    else                // no modulation input provided -> use internal LFO
+    {
+        for (i=0; i < len; i++)
+        {
+            modallp_lfo_hypertri2_q16(phaseAcc, offset, lfo);
+            modSig[i][0] = lfo[0] * modScale + modOffset;
+            modSig[i][1] = lfo[1] * modScale + modOffset;
+            phaseAcc += phaseAdd;
+        }
+        lfo_phase_acc = phaseAcc;
+    }
+    AUDIO_PROFILE_LAP(profile, PROF_MOD);
+    allpass.process(src, dst, modSig, len, prm.stg, 
+                    min(fdbRamp.value * 32768.0f, 32767.0f), min(mixRamp.value * 32768.0f, 32767.0f),
+                    lrintf(fdbRamp.step * 2147483648.0f), lrintf(mixRamp.step * 2147483648.0f));     // Q31 steps
+#else
+    float32_t modSig[AUDIO_BLOCK_SAMPLES][2];
+    float32_t modScale = abs(top - btm);
+    float32_t modOffset = min(top, btm);
+    if (mod)            // modulation input provided
+    {
+        for (i=0; i < len; i++)
+        {
+            modSig[i][0] = ((float32_t)mod[i] + 32768.0f) / 65535.0f;    // mod signal is 0.0 to 1.0
+            modSig[i][0] = modSig[i][0] * modScale + modOffset;   // apply scale/offset to the modulation wave
+            modSig[i][1] = modSig[i][0];
+        }
+    }
+    else if (bus[0])    // modulation bus channels, bus[1] = bus[0] if only one is used
+    {
+        for (i=0; i < len; i++)
+        {
+            modSig[i][0] = bus[0][i] * modScale + modOffset;
+            modSig[i][1] = bus[1][i] * modScale + modOffset;
+        }
+    }
+    else                // no modulation input provided -> use internal LFO
+    {
+        for (i=0; i < len; i++)
+        {
+            modallp_lfo_hypertri2(phaseAcc, offset, modSig[i]);
+            modSig[i][0] = modSig[i][0] * modScale + modOffset;
+            modSig[i][1] = modSig[i][1] * modScale + modOffset;
+            phaseAcc += phaseAdd;
+        }
+        lfo_phase_acc = phaseAcc;
+    }
+    AUDIO_PROFILE_LAP(profile, PROF_MOD);
+    // both channels run as two lanes of the same allpass kernel
+    allpass.process(src, dst, modSig, len, prm.stg, fdbRamp.value, mixRamp.value, fdbRamp.step, mixRamp.step);
+#endif
+    fdbRamp.end();
+    mixRamp.end();
+    AUDIO_PROFILE_LAP(profile, PROF_ALLPASS);
+}
@@ -0,0 +1,217 @@
+/*  Stereo quadrature Phaser/Vibrato effect for Teensy Audio library
+ *
+ *  Author: Piotr Zapart
+ *          www.hexefx.com
+ *
+ * Copyright (c) 2021 by Piotr Zapart
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _EFFECT_PHASERSTEREO_H
+#define _EFFECT_PHASERSTEREO_H
+
+#include <Arduino.h>
+#include "Audio.h"
+#include "AudioStream.h"
+#include "arm_math.h"
+#include "filter_modallpass.h"
+#include "effect_phaser.h"      // PHASER_STEREO_STAGES, PHASER_USE_FIXEDPOINT
+
+#define PHASER_STEREO_LFO_OFFSET    64      // default L/R LFO phase offset in LUT steps, 64 = 90deg
+
+/**
+ * @brief Stereo phaser, both channels share one LFO and run as two lanes
+ *          of the allpass kernel. Right channel LFO is phase shifted. 
+ *          Inputs: 0 - left, 1 - right, 2 - modulation (used for both channels)
+ *          Outputs: 0 - left, 1 - right
+ */
+class AudioEffectPhaserStereo : public AudioStream
+{
+    public:
+    AudioEffectPhaserStereo();
+    ~AudioEffectPhaserStereo();
+    virtual void update();
+    /**
+     * @brief Processing core called by update(), can be used without the
+     *          audio library for any block length
+     * 
+     * @param in    in[0], in[1] audio L/R, in[2] bipolar modulation (NULL = LFO or bus)
+     * @param out   out[0], out[1] audio L/R, can be the same buffers as in[0], in[1]
+     * @param n     number of samples. The bus holds one AUDIO_BLOCK_SAMPLES cycle,
+     *              the read position is carried over to the next call: calls
+     *              shorter than a block step through the same cycle.
+     */
+    void process(const int16_t *const *in, int16_t *const *out, uint32_t n);
+
+    /**
+     * @brief Scale and offset the modulation signal. It can be the internal LFO
+     *          or the incomig routed modulation AudioSignal.
+     *          LFO will oscillate between these two max and min values. 
+     * 
+     * @param top       top level of the LFO, 0.0 to PHASER_LFO_MAX
+     * @param bottom     bottom level of the LFO, 0.0 to PHASER_LFO_MAX
+     */
+    void depth(float32_t top, float32_t bottom)
+    {
+        params_t &p = params.edit();
+        p.lfo_top = constrain(top, 0.0f, PHASER_LFO_MAX);
+        p.lfo_btm = constrain(bottom, 0.0f, PHASER_LFO_MAX);
+        params.publish();
+    }
+    /**
+     * @brief Controls the internal LFO, or if a control signal is used, scales it
+     *          Use this function to update all lfo parameteres at once
+     * 
+     * @param f_Hz  lfo frequency, use 0.0f for manual phaser control
+     * @param top   lfo top level 
+     * @param btm   lfo bottm level
+     */
+    void lfo(float32_t f_Hz, float32_t top, float32_t btm)
+    {
+        params_t &p = params.edit();
+        f_Hz = constrain(f_Hz, 0.0f, AUDIO_SAMPLE_RATE_EXACT/2);
+        p.lfo_top = constrain(top, 0.0f, PHASER_LFO_MAX);
+        p.lfo_btm = constrain(btm, 0.0f, PHASER_LFO_MAX);
+        p.lfo_add = f_Hz * (4294967296.0 / AUDIO_SAMPLE_RATE_EXACT);
+        params.publish();
+    }
+    /**
+     * @brief Set the rate of the internal LFO
+     * 
+     * @param f_Hz lfo frequency, use 0.0f for manual phaser control
+     */
+    void lfo_rate(float32_t f_Hz)
+    {
+        f_Hz = constrain(f_Hz, 0.0f, AUDIO_SAMPLE_RATE_EXACT/2);
+        params.edit().lfo_add = f_Hz * (4294967296.0 / AUDIO_SAMPLE_RATE_EXACT);
+        params.publish();
+    }
+    /**
+     * @brief Controls the feedback parameter
+     * 
+     * @param fdb ffedback value in range 0.0f to 1.0f
+     */
+    void feedback(float32_t fdb)
+    {
+        params.edit().feedb = constrain(fdb, 0.0f, 1.0f);
+        params.publish();
+    }
+    /**
+     * @brief Dry / Wet mixer ratio. Classic Phaser sound uses 0.5f for 50% dry and 50%Wet
+     *        1.0f will produce 100% wet signal craeting a vibrato effect
+     * 
+     * @param ratio mixing ratio, range 0.0f (full dry) to 1.0f (full wet)
+     */
+    void mix(float32_t ratio)
+    {
+        params.edit().mix_ratio = constrain(ratio, 0.0f, 1.0f);
+        params.publish();
+    }
+    /**
+     * @brief Sets the number of stages used in the phaser
+     *        Allowed values are: 2, 4, 6, 8, 10, 12
+     * 
+     * @param st number of stages, even value <= 12
+     */
+    void stages(uint8_t st)
+    {
+        if (st && st == ((st >> 1) << 1) && st <= PHASER_STEREO_STAGES) // only 2, 4, 6, 8, 12 allowed
+        {
+            params.edit().stg = st;
+            params.publish();
+        }
+    }
+    /**
+     * @brief Sets the phase offset between the left and right channel LFO
+     *          Resolution is 360/256 deg. Has no effect if the external 
+     *          modulation input is used.
+     * 
+     * @param deg phase offset in degrees, 0.0f to 360.0f, default 90deg
+     */
+    void stereo_phase(float32_t deg)
+    {
+        deg = constrain(deg, 0.0f, 360.0f);
+        params.edit().lfo_offset = (uint32_t)(deg * (256.0f / 360.0f) + 0.5f) & 0xFF;
+        params.publish();
+    }
+    /**
+     * @brief Use modulation bus channels instead of the internal LFO.
+     *          The modulation input [2] has priority if connected.
+     *          stereo_phase() is not used, the R channel phase comes
+     *          from the bus (ie. a channel linked to the L one).
+     * 
+     * @param srcL  buffer from AudioModulationBus::buffer(), NULL = internal LFO
+     * @param srcR  R channel buffer, NULL = srcL for both channels
+     */
+    void modulation(const float32_t *srcL, const float32_t *srcR = NULL)
+    {
+        params_t &p = params.edit();
+        p.modBus[0] = srcL;
+        p.modBus[1] = srcR;
+        params.publish();
+    }
+    /**
+     * @brief Use to bypass the effect (true)
+     * 
+     * @param state true = bypass on, false = phaser on
+     */
+    void bypass(bool state) { params.edit().bps = state; params.publish();}
+    void tgl_bypass(void) { bypass(!params.get().bps);}
+
+    /**
+     * @brief Sample accurate automation: the next setter call takes effect
+     *          at sample t of time(), see utility_params.h
+     */
+    bool at(uint32_t t) { return params.at(t);}
+    uint32_t time(void) { return params.time();}
+
+    enum {PROF_MOD, PROF_ALLPASS, PROF_NUM};   // update() stages
+#if defined(AUDIO_PROFILE)
+    AudioProfile profile;           // cycles per update() stage, see utility_profile.h
+#endif
+
+private:
+    typedef struct
+    {
+        uint8_t stg;                                // number of stages
+        bool bps;                                   // bypass
+        float32_t mix_ratio;                        // 0 = dry. 1.0 = wet
+        float32_t feedb;                            // feedback 
+        uint32_t lfo_add;
+        uint32_t lfo_offset;                        // R channel lfo offset in LUT steps
+        float32_t lfo_top;
+        float32_t lfo_btm;
+        const float32_t *modBus[2];                 // modulation bus channels L, R
+    } params_t;
+    AudioParams<params_t> params;                   // written by the setters
+    params_t prm;                                   // in use by update(), see utility_params.h
+    AudioRamp fdbRamp, mixRamp;                     // feedback and mix ramps, see utility_ramp.h
+    audio_block_t *inputQueueArray[3];
+    void process_block(const int16_t *const *src, const int16_t *mod, const float32_t *const *bus, int16_t *const *dst, uint32_t len);      
+#ifdef PHASER_USE_FIXEDPOINT
+    AudioFilterModAllpassQ31<PHASER_STEREO_STAGES, 2> allpass; // L and R allpass chains
+#else
+    AudioFilterModAllpass<PHASER_STEREO_STAGES, 2> allpass;    // L and R allpass chains
+#endif
+    uint32_t lfo_phase_acc;                         // interfnal lfo 
+    uint32_t busPos;                                // modulation bus read position, see process()
+};
+
+#endif // _EFFECT_PHASERSTEREO_H
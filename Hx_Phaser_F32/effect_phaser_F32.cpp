@@ -0,0 +1,163 @@
+/*  Mono Phaser/Vibrato effect for Teensy Audio library
+ *  32bit float version for OpenAudio_ArduinoLibrary:
+ *  https://github.com/chipaudette/OpenAudio_ArduinoLibrary
+ *
+ *  Author: Piotr Zapart
+ *          www.hexefx.com
+ *
+ * Copyright (c) 2021 by Piotr Zapart
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <Arduino.h>
+#include "effect_phaser_F32.h"
+
+#if defined(AUDIO_PROFILE)
+static const char *const profNames[] = {"mod", "allpass"};
+#endif
+
+AudioEffectPhaser_F32::AudioEffectPhaser_F32() : AudioStream_F32(2, inputQueueArray_f32)
+{
+    params_t &p = params.edit();
+    allpass.reset();
+    lfo_phase_acc = 0;
+    busPos = 0;
+    p.modBus = NULL;
+    p.bps = false;
+    p.lfo_add = 0;
+    p.lfo_top = 1.0f;
+    p.lfo_btm = 0.0f;
+    p.feedb = 0.0f;
+    p.mix_ratio = 0.5f;         // start with classic phaser sound 
+    p.stg = PHASER_F32_STAGES;
+    params.publish();
+    params.fetch(prm);
+    AUDIO_PROFILE_INIT(profile, profNames, PROF_NUM);
+}
+AudioEffectPhaser_F32::~AudioEffectPhaser_F32()
+{
+}
+
+void AudioEffectPhaser_F32::update()
+{
+#if defined(__ARM_ARCH_7EM__) || defined(HX_HOST_BUILD)
+    audio_block_f32_t *blockIn; 
+    audio_block_f32_t *blockMod;        // inputs
+
+    blockIn = AudioStream_F32::receiveWritable_f32(0);      // audio data
+    blockMod = AudioStream_F32::receiveReadOnly_f32(1);     // bipolar -1.0f to 1.0f control input
+    
+    if (!blockIn)
+    {
+        if (blockMod) AudioStream_F32::release(blockMod);
+        return;
+    }
+    const float32_t *in[2] = {blockIn->data, blockMod ? blockMod->data : NULL};
+    float32_t *out[1] = {blockIn->data};
+    process(in, out, blockIn->length);      // bypass: the input block is sent unchanged
+    if (blockMod) AudioStream_F32::release(blockMod);
+    AudioStream_F32::transmit(blockIn);
+	AudioStream_F32::release(blockIn);
+#endif
+}
+
+void AudioEffectPhaser_F32::process(const float32_t *const *in, float32_t *const *out, uint32_t n)
+{
+#if defined(__ARM_ARCH_7EM__) || defined(HX_HOST_BUILD)
+    const float32_t *src = in[0];
+    const float32_t *mod = in[1];
+    float32_t *dst = out[0];
+    uint32_t i, len, seg, done, busIdx;
+    uint32_t pos = busPos;
+    float32_t modSig[AUDIO_BLOCK_SAMPLES];
+    uint32_t phaseAcc = lfo_phase_acc;
+    float32_t modScale, modOffset;
+    const float32_t *bus;
+
+    seg = params.fetch(prm, n);         // samples up to the next scheduled change
+    if (prm.bps && seg == n)
+    {
+        if (dst != src) memcpy(dst, src, n * sizeof(float32_t));
+        busPos = (busPos + n) % AUDIO_BLOCK_SAMPLES;
+        return;
+    }
+    AUDIO_PROFILE_START(profile);
+    while (n)
+    {
+        if (prm.bps)
+        {
+            if (dst != src) memcpy(dst, src, seg * sizeof(float32_t));
+        }
+        else
+        {
+            modScale = abs(prm.lfo_top - prm.lfo_btm);
+            modOffset = min(prm.lfo_top, prm.lfo_btm);
+            bus = prm.modBus;
+            for (done = 0; done < seg; done += len)
+            {
+                busIdx = (pos + done) % AUDIO_BLOCK_SAMPLES;    // the bus holds one audio cycle
+                len = min(seg - done, AUDIO_BLOCK_SAMPLES - busIdx);
+                len = fdbRamp.span(prm.feedb, len);         // parameter ramps, see utility_ramp.h
+                len = mixRamp.span(prm.mix_ratio, len);
+                if (mod)            // modulation input provided
+                {
+                    for (i=0; i < len; i++)
+                    {
+                        modSig[i] = constrain((mod[done + i] + 1.0f) * 0.5f, 0.0f, 1.0f);  // mod signal is 0.0 to 1.0
+                        modSig[i] = modSig[i] * modScale + modOffset;   // apply scale/offset to the modulation wave
+                    }
+                }
+                else if (bus)       // modulation bus channel
+                {
+                    for (i=0; i < len; i++)
+                    {
+                        modSig[i] = bus[busIdx + i] * modScale + modOffset;
+                    }
+                }
+                else                // no modulation input provided -> use internal LFO
+                {
+                    for (i=0; i < len; i++)
+                    {
+                        modSig[i] = modallp_lfo_hypertri(phaseAcc) * modScale + modOffset;
+                        phaseAcc += prm.lfo_add;
+                    }
+                }
+                AUDIO_PROFILE_LAP(profile, PROF_MOD);
+                fdbRamp.begin(prm.feedb, len);
+                mixRamp.begin(prm.mix_ratio, len);
+                allpass.process(src + done, dst + done, modSig, len, prm.stg, 
+                                fdbRamp.value, mixRamp.value, fdbRamp.step, mixRamp.step);
+                fdbRamp.end();
+                mixRamp.end();
+                AUDIO_PROFILE_LAP(profile, PROF_ALLPASS);
+            }
+        }
+        if (mod) mod += seg;
+        src += seg;
+        dst += seg;
+        pos += seg;
+        n -= seg;
+        if (n) seg = params.fetch(prm, n);
+    }
+    busPos = pos % AUDIO_BLOCK_SAMPLES;
+    lfo_phase_acc = phaseAcc;
+    AUDIO_PROFILE_COMMIT(profile);
+#endif
+}
@@ -0,0 +1,190 @@
+/*  Mono Phaser/Vibrato effect for Teensy Audio library
+ *  32bit float version for OpenAudio_ArduinoLibrary:
+ *  https://github.com/chipaudette/OpenAudio_ArduinoLibrary
+ *
+ *  Author: Piotr Zapart
+ *          www.hexefx.com
+ *
+ * Copyright (c) 2021 by Piotr Zapart
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _EFFECT_PHASER_F32_H
+#define _EFFECT_PHASER_F32_H
+
+#include <Arduino.h>
+#include "Audio.h"
+#include "AudioStream_F32.h"
+#include "arm_math.h"
+#include "filter_modallpass.h"
+#include "utility_profile.h"
+#include "utility_params.h"
+#include "utility_ramp.h"
+
+#define PHASER_F32_STAGES	12
+
+class AudioEffectPhaser_F32 : public AudioStream_F32
+{
+    public:
+    AudioEffectPhaser_F32();
+    ~AudioEffectPhaser_F32();
+    virtual void update();
+    /**
+     * @brief Processing core called by update(), can be used without the
+     *          audio library for any block length
+     * 
+     * @param in    in[0] audio, in[1] modulation -1.0f to 1.0f (NULL = LFO or bus)
+     * @param out   out[0] audio, can be the same buffer as in[0]
+     * @param n     number of samples. The bus holds one AUDIO_BLOCK_SAMPLES cycle,
+     *              the read position is carried over to the next call: calls
+     *              shorter than a block step through the same cycle.
+     */
+    void process(const float32_t *const *in, float32_t *const *out, uint32_t n);
+    enum {PROC_IN = 1, PROC_OUT = 1};   // audio channels of process(), see effect_chain_F32.h
+
+    /**
+     * @brief Scale and offset the modulation signal. It can be the internal LFO
+     *          or the incomig routed modulation AudioSignal.
+     *          LFO will oscillate between these two max and min values. 
+     * 
+     * @param top       top level of the LFO
+     * @param bottom     bottom level of the LFO
+     */
+    void depth(float32_t top, float32_t bottom)
+    {
+        params_t &p = params.edit();
+        p.lfo_top = constrain(top, 0.0f, 1.0f);
+        p.lfo_btm = constrain(bottom, 0.0f, 1.0f);
+        params.publish();
+    }
+    /**
+     * @brief Controls the internal LFO, or if a control signal is used, scales it
+     *          Use this function to update all lfo parameteres at once
+     * 
+     * @param f_Hz  lfo frequency, use 0.0f for manual phaser control
+     * @param top   lfo top level 
+     * @param btm   lfo bottm level
+     */
+    void lfo(float32_t f_Hz, float32_t top, float32_t btm)
+    {
+        params_t &p = params.edit();
+        f_Hz = constrain(f_Hz, 0.0f, AUDIO_SAMPLE_RATE_EXACT/2);
+        p.lfo_top = constrain(top, 0.0f, 1.0f);
+        p.lfo_btm = constrain(btm, 0.0f, 1.0f);
+        p.lfo_add = f_Hz * (4294967296.0 / AUDIO_SAMPLE_RATE_EXACT);
+        params.publish();
+    }
+    /**
+     * @brief Set the rate of the internal LFO
+     * 
+     * @param f_Hz lfo frequency, use 0.0f for manual phaser control
+     */
+    void lfo_rate(float32_t f_Hz)
+    {
+        f_Hz = constrain(f_Hz, 0.0f, AUDIO_SAMPLE_RATE_EXACT/2);
+        params.edit().lfo_add = f_Hz * (4294967296.0 / AUDIO_SAMPLE_RATE_EXACT);
+        params.publish();
+    }
+    /**
+     * @brief Controls the feedback parameter
+     * 
+     * @param fdb ffedback value in range 0.0f to 1.0f
+     */
+    void feedback(float32_t fdb)
+    {
+        params.edit().feedb = constrain(fdb, 0.0f, 1.0f);
+        params.publish();
+    }
+    /**
+     * @brief Dry / Wet mixer ratio. Classic Phaser sound uses 0.5f for 50% dry and 50%Wet
+     *        1.0f will produce 100% wet signal craeting a vibrato effect
+     * 
+     * @param ratio mixing ratio, range 0.0f (full dry) to 1.0f (full wet)
+     */
+    void mix(float32_t ratio)
+    {
+        params.edit().mix_ratio = constrain(ratio, 0.0f, 1.0f);
+        params.publish();
+    }
+    /**
+     * @brief Sets the number of stages used in the phaser
+     *        Allowed values are: 2, 4, 6, 8, 10, 12
+     * 
+     * @param st number of stages, even value <= 12
+     */
+    void stages(uint8_t st)
+    {
+        if (st && st == ((st >> 1) << 1) && st <= PHASER_F32_STAGES) // only 2, 4, 6, 8, 12 allowed
+        {
+            params.edit().stg = st;
+            params.publish();
+        }
+    }
+    /**
+     * @brief Use a modulation bus channel instead of the internal LFO.
+     *          The modulation input [1] has priority if connected.
+     * 
+     * @param src buffer from AudioModulationBus::buffer(), NULL = internal LFO
+     */
+    void modulation(const float32_t *src) { params.edit().modBus = src; params.publish();}
+    /**
+     * @brief Use to bypass the effect (true)
+     * 
+     * @param state true = bypass on, false = phaser on
+     */
+    void set_bypass(bool state) { params.edit().bps = state; params.publish();}
+    bool get_bypass(void) {return params.get().bps;}
+    bool tgl_bypass(void) { set_bypass(!params.get().bps); return params.get().bps;}
+
+    /**
+     * @brief Sample accurate automation: the next setter call takes effect
+     *          at sample t of time(), see utility_params.h
+     */
+    bool at(uint32_t t) { return params.at(t);}
+    uint32_t time(void) { return params.time();}
+    void advance(uint32_t n) { params.advance(n);}  // clock of a bypassed chain stage
+
+    enum {PROF_MOD, PROF_ALLPASS, PROF_NUM};   // update() stages
+#if defined(AUDIO_PROFILE)
+    AudioProfile profile;           // cycles per update() stage, see utility_profile.h
+#endif
+
+private:
+    typedef struct
+    {
+        uint8_t stg;                                // number of stages
+        bool bps;                                   // bypass
+        float32_t mix_ratio;                        // 0 = dry. 1.0 = wet
+        float32_t feedb;                            // feedback 
+        const float32_t *modBus;                    // modulation bus channel
+        uint32_t lfo_add;
+        float32_t lfo_top;
+        float32_t lfo_btm;
+    } params_t;
+    AudioParams<params_t> params;                   // written by the setters
+    params_t prm;                                   // in use by update(), see utility_params.h
+    AudioRamp fdbRamp, mixRamp;                     // feedback and mix ramps, see utility_ramp.h
+    audio_block_f32_t *inputQueueArray_f32[2];      
+    AudioFilterModAllpass<PHASER_F32_STAGES> allpass;    // allpass chain + feedback state
+    uint32_t lfo_phase_acc;                         // interfnal lfo 
+    uint32_t busPos;                                // modulation bus read position, see process()
+};
+
+#endif // _EFFECT_PHASER_F32_H
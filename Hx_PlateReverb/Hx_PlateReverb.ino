@@ -96,6 +96,15 @@ void loop()
   {
     Serial.print("Reverb CPU load = ");
     Serial.println(reverb.processorUsageMax());
+#ifdef AUDIO_PROFILE
+    // cycles per block of each update() stage, enable AUDIO_PROFILE in utility_profile.h
+    for (uint8_t s = 0; s < reverb.profile.stages(); s++)
+    {
+      Serial.printf("  %-6s mean %6.0f  min %6u  max %6u\r\n", reverb.profile.name(s),
+                    reverb.profile.cyclesMean(s), (unsigned)reverb.profile.cyclesMin(s), (unsigned)reverb.profile.cyclesMax(s));
+    }
+    reverb.profile.reset();
+#endif
     timeLast = timeNow;
   }
 
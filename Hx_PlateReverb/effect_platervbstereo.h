@@ -47,85 +47,128 @@
 #include "Audio.h"
 #include "AudioStream.h"
 #include "arm_math.h"
+#include "utility_profile.h"
+#include "utility_params.h"
+#include "utility_ramp.h"
+#include "utility_denormal.h"
 
 
 // if uncommented will place all the buffers in the DMAMEM section ofd the memory
 // works with single instance of the reverb only
+#if !defined(HX_HOST_BUILD)         // host build: buffers are members, many instances run in parallel
 #define REVERB_USE_DMAMEM
+#endif
 
 /***
  * Loop delay modulation: comment/uncomment to switch sin/cos 
  * modulation for the 1st or 2nd tap, 3rd tap is always modulated
  * more modulation means more chorus type sounding reverb tail
  */
+#if !defined(REVERB_TAP_CONFIG)     // the taps can also be selected by the build, ie. -DREVERB_TAP_CONFIG -DTAP1_MODULATED
 //#define TAP1_MODULATED
 #define TAP2_MODULATED
+#endif
 
 class AudioEffectPlateReverb : public AudioStream
 {
 public:
     AudioEffectPlateReverb();
     virtual void update();
+    /**
+     * @brief Processing core called by update(), can be used without the
+     *  audio library for any block length
+     * 
+     * @param in    in[0], in[1] audio L/R
+     * @param out   out[0], out[1] reverb L/R, can be the same buffers as in[0], in[1]
+     * @param n     number of samples
+     */
+    void process(const int16_t *const *in, int16_t *const *out, uint32_t n);
 
     void size(float n)
     {
         n = constrain(n, 0.0f, 1.0f);
         n = map (n, 0.0f, 1.0f, 0.2f, rv_time_k_max);
-        float32_t attn = map(n, 0.0f, rv_time_k_max, 0.5f, 0.25f);
-        __disable_irq();
-        rv_time_k = n;
-        input_attn = attn;
-         __enable_irq();
+        params_t &p = params.edit();
+        p.rv_time_k = n;
+        p.input_attn = map(n, 0.0f, rv_time_k_max, 0.5f, 0.25f);
+        params.publish();
     }
 
     void hidamp(float n)
     {
         n = constrain(n, 0.0f, 1.0f);
-        __disable_irq();
-        lp_hidamp_k = 1.0f - n;
-         __enable_irq();
+        params.edit().lp_hidamp_k = 1.0f - n;
+        params.publish();
     }
     
     void lodamp(float n)
     {
         n = constrain(n, 0.0f, 1.0f);
-        __disable_irq();
-        lp_lodamp_k = -n;
-        rv_time_scaler = 1.0f - n * 0.12f;        // limit the max reverb time, otherwise it will clip
-         __enable_irq();
+        params_t &p = params.edit();
+        p.lp_lodamp_k = -n;
+        p.rv_time_scaler = 1.0f - n * 0.12f;        // limit the max reverb time, otherwise it will clip
+        params.publish();
     }
 
     void lowpass(float n)
     {
         n = constrain(n, 0.0f, 1.0f);
         n = map(n*n*n, 0.0f, 1.0f, 0.05f, 1.0f);
-        master_lowpass_f = n;
+        params.edit().master_lowpass_f = n;
+        params.publish();
     }
     
     void diffusion(float n)
     {
         n = constrain(n, 0.0f, 1.0f);
         n = map(n, 0.0f, 1.0f, 0.005f, 0.65f);
-        __disable_irq();
-        in_allp_k = n;
-        loop_allp_k = n;
-         __enable_irq();
+        params_t &p = params.edit();
+        p.in_allp_k = n;
+        p.loop_allp_k = n;
+        params.publish();
     }
 
-    float32_t get_size(void) {return rv_time_k;}
-    bool get_bypass(void) {return bypass;}
-    void set_bypass(bool state) {bypass = state;};
-    void tgl_bypass(void) {bypass ^=1;}
+    float32_t get_size(void) {return params.get().rv_time_k;}
+    bool get_bypass(void) {return params.get().bypass;}
+    void set_bypass(bool state) { params.edit().bypass = state; params.publish();};
+    void tgl_bypass(void) { set_bypass(!params.get().bypass);}
+
+    /**
+     * @brief Sample accurate automation: the next setter call takes effect
+     *          at sample t of time(), see utility_params.h
+     */
+    bool at(uint32_t t) { return params.at(t);}
+    uint32_t time(void) { return params.time();}
+
+    enum {PROF_IO, PROF_LFO, PROF_INPUT, PROF_TANK, PROF_TAPS, PROF_NUM};  // update() stages
+#if defined(AUDIO_PROFILE)
+    AudioProfile profile;           // cycles per update() stage, see utility_profile.h
+#endif
 private:
-    bool bypass = false;
+    typedef struct
+    {
+        bool bypass;
+        float32_t input_attn;
+        float32_t in_allp_k;            // input allpass coeff 
+        float32_t loop_allp_k;          // loop allpass coeff
+        float32_t lp_hidamp_k;          // loop high band damping coeff
+        float32_t lp_lodamp_k;          // loop low baand damping coeff
+        float32_t master_lowpass_f;
+        float32_t rv_time_k;            // reverb time coeff
+        float32_t rv_time_scaler;       // with high lodamp settings lower the max reverb time to avoid clipping
+    } params_t;
+    AudioParams<params_t> params;       // written by the setters
+    params_t prm;                       // in use by update(), see utility_params.h
+    AudioRamp sizeRamp, attnRamp;       // rv_time_k and input_attn in use, see utility_ramp.h
+    AudioDenormalNoise dnNoise;         // see utility_denormal.h
+    bool cleanup_done = false;      // buffers cleared after entering bypass
+    void cleanup();
+    void process_block(const int16_t *srcL, const int16_t *srcR, int16_t *dstL, int16_t *dstR, uint32_t len);
     audio_block_t *inputQueueArray[2];
 #ifndef REVERB_USE_DMAMEM
     float32_t input_blockL[AUDIO_BLOCK_SAMPLES];
     float32_t input_blockR[AUDIO_BLOCK_SAMPLES];
 #endif
-    float32_t input_attn;
-
-    float32_t in_allp_k;            // input allpass coeff 
 #ifndef REVERB_USE_DMAMEM
     float32_t in_allp1_bufL[224];   // input allpass buffers
     float32_t in_allp2_bufL[420];
@@ -136,7 +179,6 @@ private:
     uint16_t in_allp2_idxL;
     uint16_t in_allp3_idxL;
     uint16_t in_allp4_idxL;
-    float32_t in_allp_out_L;    // L allpass chain output
 #ifndef REVERB_USE_DMAMEM
     float32_t in_allp1_bufR[156]; // input allpass buffers
     float32_t in_allp2_bufR[520];
@@ -147,7 +189,6 @@ private:
     uint16_t in_allp2_idxR;
     uint16_t in_allp3_idxR;
     uint16_t in_allp4_idxR;
-    float32_t in_allp_out_R;    // R allpass chain output
 #ifndef REVERB_USE_DMAMEM
     float32_t lp_allp1_buf[2303]; // loop allpass buffers
     float32_t lp_allp2_buf[2905];
@@ -158,7 +199,6 @@ private:
     uint16_t lp_allp2_idx;
     uint16_t lp_allp3_idx;
     uint16_t lp_allp4_idx;
-    float32_t loop_allp_k;         // loop allpass coeff
     float32_t lp_allp_out;
 #ifndef REVERB_USE_DMAMEM
     float32_t lp_dly1_buf[3423];
@@ -181,9 +221,6 @@ private:
     const uint16_t lp_dly3_offset_R = 487;
     const uint16_t lp_dly4_offset_R = 780;  
 
-    float32_t lp_hidamp_k;       // loop high band damping coeff
-    float32_t lp_lodamp_k;       // loop low baand damping coeff
-
     float32_t lpf1;             // lowpass filters
     float32_t lpf2;
     float32_t lpf3;
@@ -197,13 +234,10 @@ private:
     float32_t lp_lowpass_f;      // loop lowpass scaled frequency
     float32_t lp_hipass_f;       // loop highpass scaled frequency 
 
-    float32_t master_lowpass_f;
     float32_t master_lowpass_l;
     float32_t master_lowpass_r;
 
     const float32_t rv_time_k_max = 0.95f;
-    float32_t rv_time_k;         // reverb time coeff
-    float32_t rv_time_scaler;    // with high lodamp settings lower the max reverb time to avoid clipping
 
     uint32_t lfo1_phase_acc;     // LFO 1
     uint32_t lfo1_adder;
@@ -49,8 +49,18 @@
 #define LFO1_FREQ_HZ        (1.37f)                          // LFO1 frequency in Hz
 #define LFO2_FREQ_HZ        (1.52f)                          // LFO2 frequency in Hz
 
+// samples per stage pass, the taps pass runs after the tank pass: at most the shortest
+// tap offset minus the LFO excursion (145 - 16), the taps then read the same samples
+#define REVERB_PASS_LEN     (128)
+
 #define RV_MASTER_LOWPASS_F (0.6f)                           // master lowpass scaled frequency coeff. 
 
+#if defined(AUDIO_PROFILE)
+static const char *const profNames[] = {"lfo", "input", "tank", "taps"};
+#endif
+
+static const float32_t zeroData[AUDIO_BLOCK_SAMPLES] = {0};   // not connected input
+
 extern "C" {
 extern const int16_t AudioWaveformSine[257];
 }
@@ -80,7 +90,10 @@ float32_t DMAMEM lp_dly4_buf[3698];
 
 AudioEffectPlateReverb_F32::AudioEffectPlateReverb_F32() : AudioStream_F32(2, inputQueueArray_f32)
 {
-    in_allp_k = INP_ALLP_COEFF;
+    params_t &p = params.edit();
+    p.bypass = false;
+    p.freeze = false;
+    p.in_allp_k = INP_ALLP_COEFF;
 
     memset(in_allp1_bufL, 0, sizeof(in_allp1_bufL));
 	memset(in_allp2_bufL, 0, sizeof(in_allp2_bufL));
@@ -100,7 +113,6 @@ AudioEffectPlateReverb_F32::AudioEffectPlateReverb_F32() : AudioStream_F32(2, in
     in_allp3_idxR = 0;
     in_allp4_idxR = 0;
 
-    in_allp_out_R = 0.0f;
 
     memset(lp_allp1_buf, 0, sizeof(lp_allp1_buf));
     memset(lp_allp2_buf, 0, sizeof(lp_allp2_buf));
@@ -110,7 +122,7 @@ AudioEffectPlateReverb_F32::AudioEffectPlateReverb_F32() : AudioStream_F32(2, in
     lp_allp2_idx = 0;
     lp_allp3_idx = 0;
     lp_allp4_idx = 0;
-    loop_allp_k = LOOP_ALLOP_COEFF;
+    p.loop_allp_k = LOOP_ALLOP_COEFF;
     lp_allp_out = 0.0f;
 
     memset(lp_dly1_buf, 0, sizeof(lp_dly1_buf));
@@ -122,8 +134,9 @@ AudioEffectPlateReverb_F32::AudioEffectPlateReverb_F32() : AudioStream_F32(2, in
     lp_dly3_idx = 0;
     lp_dly4_idx = 0;
 
-    lp_hidamp_k = 1.0f;
-    lp_lodamp_k = 0.0f;
+    p.lp_hidamp_k = 1.0f;
+    p.lp_lodamp_k = 0.0f;
+    p.rv_time_scaler = 1.0f;    // lodamp = 0
 
     lp_lowpass_f = HI_LOSS_FREQ;
     lp_hipass_f = LO_LOSS_FREQ;
@@ -138,7 +151,7 @@ AudioEffectPlateReverb_F32::AudioEffectPlateReverb_F32() : AudioStream_F32(2, in
     hpf3 = 0.0f;
     hpf4 = 0.0f;
 
-    master_lowpass_f = RV_MASTER_LOWPASS_F;
+    p.master_lowpass_f = RV_MASTER_LOWPASS_F;
     master_lowpass_l = 0.0f;
     master_lowpass_r = 0.0f;
 
@@ -151,61 +164,33 @@ AudioEffectPlateReverb_F32::AudioEffectPlateReverb_F32() : AudioStream_F32(2, in
     hidamp(0.0f);
     lodamp(0.0f);
     lowpass(0.0f);
-    diffusion(1.0f);
-    flags.bypass = 0;
-    flags.freeze = 0;
+    diffusion(1.0f);                // the setters publish the set
+    params.fetch(prm);
+    flags.shimmer = 0;
+    flags.cleanup_done = 0;
+    AUDIO_PROFILE_INIT(profile, profNames, PROF_NUM);
 }
 
 void AudioEffectPlateReverb_F32::update()
 {
-#if defined(__ARM_ARCH_7EM__)
-
-    const audio_block_f32_t *blockL = NULL, *blockR = NULL;
-
+#if defined(__ARM_ARCH_7EM__) || defined(HX_HOST_BUILD)
+    const audio_block_f32_t *blockL, *blockR;
     audio_block_f32_t *outblockL;
 	audio_block_f32_t *outblockR;
-	int i;
-	float32_t input, acc, temp1, temp2;
-    uint16_t temp16;
-    float32_t rv_time;
-
-    // for LFOs:
-    int16_t lfo1_out_sin, lfo1_out_cos, lfo2_out_sin, lfo2_out_cos;
-    int32_t y0, y1;
-    int64_t y;
-    uint32_t idx;
+    uint32_t n;
 
-    // handle disable, 1st call will clean the buffers to avoid continuing the previous reverb tail
     // when disabled, reverb does not procude any output signal. There is no dry/wet mixer (done externally).
-    if (flags.bypass)
+    blockL = AudioStream_F32::receiveReadOnly_f32(0);
+    blockR = AudioStream_F32::receiveReadOnly_f32(1);
+    params.fetch(prm);
+    if (prm.bypass && params.due(AUDIO_BLOCK_SAMPLES) == AUDIO_BLOCK_SAMPLES)    // inputs are dropped, not left queued until the bypass is off
     {
-        if (!flags.cleanup_done)
-        {
-            memset(in_allp1_bufL, 0, sizeof(in_allp1_bufL));
-            memset(in_allp2_bufL, 0, sizeof(in_allp2_bufL));
-            memset(in_allp3_bufL, 0, sizeof(in_allp3_bufL));
-            memset(in_allp4_bufL, 0, sizeof(in_allp4_bufL));
-            memset(in_allp1_bufR, 0, sizeof(in_allp1_bufR));
-            memset(in_allp2_bufR, 0, sizeof(in_allp2_bufR));
-            memset(in_allp3_bufR, 0, sizeof(in_allp3_bufR));
-            memset(in_allp4_bufR, 0, sizeof(in_allp4_bufR));
-            memset(lp_allp1_buf, 0, sizeof(lp_allp1_buf));
-            memset(lp_allp2_buf, 0, sizeof(lp_allp2_buf));
-            memset(lp_allp3_buf, 0, sizeof(lp_allp3_buf));
-            memset(lp_allp4_buf, 0, sizeof(lp_allp4_buf));
-            memset(lp_dly1_buf, 0, sizeof(lp_dly1_buf));
-            memset(lp_dly2_buf, 0, sizeof(lp_dly2_buf));
-            memset(lp_dly3_buf, 0, sizeof(lp_dly3_buf));
-            memset(lp_dly4_buf, 0, sizeof(lp_dly4_buf));
-
-            flags.cleanup_done = true;
-        }
+        params.fetch(prm, AUDIO_BLOCK_SAMPLES);     // keeps the clock running
+        if (blockL) AudioStream_F32::release((audio_block_f32_t *)blockL);
+        if (blockR) AudioStream_F32::release((audio_block_f32_t *)blockR);
+        cleanup();
         return;
     }
-    flags.cleanup_done = false;
-
-    blockL = AudioStream_F32::receiveReadOnly_f32(0);
-    blockR = AudioStream_F32::receiveReadOnly_f32(1);
 	outblockL = AudioStream_F32::allocate_f32();
 	outblockR = AudioStream_F32::allocate_f32();
 	if (!outblockL || !outblockR) {
@@ -215,266 +200,427 @@ void AudioEffectPlateReverb_F32::update()
         if (blockR) release((audio_block_f32_t *)blockR);
 		return;
 	}
+    // a missing input is silence, the tail keeps ringing
+    n = AUDIO_BLOCK_SAMPLES;
+    if (blockL) n = blockL->length;
+    if (blockR) n = min(n, (uint32_t)blockR->length);
+    outblockL->length = n;
+    outblockR->length = n;
+    const float32_t *in[2] = {blockL ? blockL->data : zeroData, blockR ? blockR->data : zeroData};
+    float32_t *out[2] = {outblockL->data, outblockR->data};
+    process(in, out, n);
+    AudioStream_F32::transmit(outblockL, 0);
+	AudioStream_F32::transmit(outblockR, 1);
+	AudioStream_F32::release(outblockL);
+    AudioStream_F32::release(outblockR);
+	if (blockL) AudioStream_F32::release((audio_block_f32_t *)blockL);
+    if (blockR) AudioStream_F32::release((audio_block_f32_t *)blockR);
+#endif
+}
+
+// 1st call in bypass mode clears the buffers to avoid continuing the previous reverb tail
+void AudioEffectPlateReverb_F32::cleanup()
+{
+    if (flags.cleanup_done) return;
+    memset(in_allp1_bufL, 0, sizeof(in_allp1_bufL));
+    memset(in_allp2_bufL, 0, sizeof(in_allp2_bufL));
+    memset(in_allp3_bufL, 0, sizeof(in_allp3_bufL));
+    memset(in_allp4_bufL, 0, sizeof(in_allp4_bufL));
+    memset(in_allp1_bufR, 0, sizeof(in_allp1_bufR));
+    memset(in_allp2_bufR, 0, sizeof(in_allp2_bufR));
+    memset(in_allp3_bufR, 0, sizeof(in_allp3_bufR));
+    memset(in_allp4_bufR, 0, sizeof(in_allp4_bufR));
+    memset(lp_allp1_buf, 0, sizeof(lp_allp1_buf));
+    memset(lp_allp2_buf, 0, sizeof(lp_allp2_buf));
+    memset(lp_allp3_buf, 0, sizeof(lp_allp3_buf));
+    memset(lp_allp4_buf, 0, sizeof(lp_allp4_buf));
+    memset(lp_dly1_buf, 0, sizeof(lp_dly1_buf));
+    memset(lp_dly2_buf, 0, sizeof(lp_dly2_buf));
+    memset(lp_dly3_buf, 0, sizeof(lp_dly3_buf));
+    memset(lp_dly4_buf, 0, sizeof(lp_dly4_buf));
+    flags.cleanup_done = true;
+}
+
+void AudioEffectPlateReverb_F32::process(const float32_t *const *in, float32_t *const *out, uint32_t n)
+{
+#if defined(__ARM_ARCH_7EM__) || defined(HX_HOST_BUILD)
+    const float32_t *srcL = in[0];
+    const float32_t *srcR = in[1];
+    float32_t *dstL = out[0];
+    float32_t *dstR = out[1];
+    uint32_t seg;
+
+    seg = params.fetch(prm, n);         // samples up to the next scheduled change
+    if (prm.bypass && seg == n)
+    {
+        cleanup();
+        memset(dstL, 0, n * sizeof(float32_t));
+        memset(dstR, 0, n * sizeof(float32_t));
+        return;
+    }
+    AUDIO_PROFILE_START(profile);
+    while (n)
+    {
+        if (prm.bypass)
+        {
+            cleanup();
+            memset(dstL, 0, seg * sizeof(float32_t));
+            memset(dstR, 0, seg * sizeof(float32_t));
+        }
+        else
+        {
+            flags.cleanup_done = false;
+            process_segment(srcL, srcR, dstL, dstR, seg);
+        }
+        srcL += seg;
+        srcR += seg;
+        dstL += seg;
+        dstR += seg;
+        n -= seg;
+        if (n) seg = params.fetch(prm, n);
+    }
+    AUDIO_PROFILE_COMMIT(profile);
+#endif
+}
+
+// one parameter set for all n samples
+void AudioEffectPlateReverb_F32::process_segment(const float32_t *srcL, const float32_t *srcR, float32_t *dstL, float32_t *dstR, uint32_t n)
+{
+#if defined(__ARM_ARCH_7EM__) || defined(HX_HOST_BUILD)
+	uint32_t i;
+	float32_t input, acc, temp1, temp2;
+    uint16_t temp16;
+    float32_t rv_time, in_attn;
+    bool ramp;
 
-    if (!blockL || !blockR) return;
-    
-    rv_time = rv_time_k;
+    // for LFOs:
+    int16_t lfo2_out_sin, lfo2_out_cos;
+#if defined(TAP2_MODULATED)
+    int16_t lfo1_out_sin;                   // LFO 1 drives the modulated output taps only
+#endif
+#if defined(TAP1_MODULATED) || defined(TAP2_MODULATED)
+    int16_t lfo1_out_cos;
+#endif
+    int32_t y0, y1;
+    int64_t y;
+    uint32_t idx;
+    // stage passes:
+    uint32_t c, pass;
+    int16_t lfo2Sin[REVERB_PASS_LEN], lfo2Cos[REVERB_PASS_LEN];
+#if defined(TAP2_MODULATED)
+    int16_t lfo1Sin[REVERB_PASS_LEN];
+#endif
+#if defined(TAP1_MODULATED) || defined(TAP2_MODULATED)
+    int16_t lfo1Cos[REVERB_PASS_LEN];
+#endif
+    float32_t inL[REVERB_PASS_LEN], inR[REVERB_PASS_LEN];     // input allpass chain outputs
+    uint16_t tap1, tap2, tap3, tap4;                            // delay indexes seen by the taps
 
-	for (i=0; i < AUDIO_BLOCK_SAMPLES; i++) 
+    // the stages run as passes over up to REVERB_PASS_LEN samples: the 
+    // profiler times each stage once per pass, not per sample
+	for (c = 0; c < n; c += pass)
     {
-        // do the LFOs
-        lfo1_phase_acc += lfo1_adder;
-        idx = lfo1_phase_acc >> 24;     // 8bit lookup table address
-        y0 =  AudioWaveformSine[idx];
-        y1 = AudioWaveformSine[idx+1];
-        idx = lfo1_phase_acc & 0x00FFFFFF;   // lower 24 bit = fractional part
-        y = (int64_t)y0 * (0x00FFFFFF - idx);
-        y += (int64_t)y1 * idx;
-        lfo1_out_sin = (int32_t) (y >> (32-8)); // 16bit output
-        idx = ((lfo1_phase_acc >> 24)+64) & 0xFF;
-        y0 = AudioWaveformSine[idx];
-        y1 = AudioWaveformSine[idx + 1];
-        y = (int64_t)y0 * (0x00FFFFFF - idx);
-        y += (int64_t)y1 * idx;
-        lfo1_out_cos = (int32_t) (y >> (32-8)); // 16bit output        
-
-        lfo2_phase_acc += lfo2_adder;
-        idx = lfo2_phase_acc >> 24;     // 8bit lookup table address
-        y0 =  AudioWaveformSine[idx];
-        y1 = AudioWaveformSine[idx+1];
-        idx = lfo2_phase_acc & 0x00FFFFFF;   // lower 24 bit = fractional part
-        y = (int64_t)y0 * (0x00FFFFFF - idx);
-        y += (int64_t)y1 * idx;
-        lfo2_out_sin = (int32_t) (y >> (32-8)); //32-8->output 16bit,
-        idx = ((lfo2_phase_acc >> 24)+64) & 0xFF;
-        y0 = AudioWaveformSine[idx];
-        y1 = AudioWaveformSine[idx + 1];
-        y = (int64_t)y0 * (0x00FFFFFF - idx);
-        y += (int64_t)y1 * idx;
-        lfo2_out_cos = (int32_t) (y >> (32-8)); // 16bit output   
-
-		input = blockL->data[i] * input_attn;
-        // chained input allpasses, channel L
-        acc = in_allp1_bufL[in_allp1_idxL]  + input * in_allp_k;  
-        in_allp1_bufL[in_allp1_idxL] = input - in_allp_k * acc;
-        input = acc;
-        if (++in_allp1_idxL >= sizeof(in_allp1_bufL)/sizeof(float32_t)) in_allp1_idxL = 0;
-
-        acc = in_allp2_bufL[in_allp2_idxL]  + input * in_allp_k;  
-        in_allp2_bufL[in_allp2_idxL] = input - in_allp_k * acc;
-        input = acc;
-        if (++in_allp2_idxL >= sizeof(in_allp2_bufL)/sizeof(float32_t)) in_allp2_idxL = 0;
-
-        acc = in_allp3_bufL[in_allp3_idxL]  + input * in_allp_k;  
-        in_allp3_bufL[in_allp3_idxL] = input - in_allp_k * acc;
-        input = acc;
-        if (++in_allp3_idxL >= sizeof(in_allp3_bufL)/sizeof(float32_t)) in_allp3_idxL = 0;
-
-        acc = in_allp4_bufL[in_allp4_idxL]  + input * in_allp_k;  
-        in_allp4_bufL[in_allp4_idxL] = input - in_allp_k * acc;
-        in_allp_out_L = acc;
-        if (++in_allp4_idxL >= sizeof(in_allp4_bufL)/sizeof(float32_t)) in_allp4_idxL = 0;
-
-        input = blockR->data[i] * input_attn;
-
-        // chained input allpasses, channel R
-        acc = in_allp1_bufR[in_allp1_idxR]  + input * in_allp_k;  
-        in_allp1_bufR[in_allp1_idxR] = input - in_allp_k * acc;
-        input = acc;
-        if (++in_allp1_idxR >= sizeof(in_allp1_bufR)/sizeof(float32_t)) in_allp1_idxR = 0;
-
-        acc = in_allp2_bufR[in_allp2_idxR]  + input * in_allp_k;  
-        in_allp2_bufR[in_allp2_idxR] = input - in_allp_k * acc;
-        input = acc;
-        if (++in_allp2_idxR >= sizeof(in_allp2_bufR)/sizeof(float32_t)) in_allp2_idxR = 0;
-
-        acc = in_allp3_bufR[in_allp3_idxR]  + input * in_allp_k;  
-        in_allp3_bufR[in_allp3_idxR] = input - in_allp_k * acc;
-        input = acc;
-        if (++in_allp3_idxR >= sizeof(in_allp3_bufR)/sizeof(float32_t)) in_allp3_idxR = 0;
-
-        acc = in_allp4_bufR[in_allp4_idxR]  + input * in_allp_k;  
-        in_allp4_bufR[in_allp4_idxR] = input - in_allp_k * acc;
-        in_allp_out_R = acc;
-        if (++in_allp4_idxR >= sizeof(in_allp4_bufR)/sizeof(float32_t)) in_allp4_idxR = 0;
-
-        // shimmer: add octave up for lp_allp_out - TODO someday
-        
-        // input allpases done, start loop allpases
-        input = lp_allp_out + in_allp_out_R; 
-        acc = lp_allp1_buf[lp_allp1_idx] + input * loop_allp_k;                  // input is the lp allpass chain output
-        lp_allp1_buf[lp_allp1_idx] = input - loop_allp_k * acc;
-        input = acc;
-        if (++lp_allp1_idx >= sizeof(lp_allp1_buf)/sizeof(float32_t)) lp_allp1_idx = 0;
-        
-        acc = lp_dly1_buf[lp_dly1_idx];                                                   // read the end of the delay
-        lp_dly1_buf[lp_dly1_idx] = input;                                                 // write new sample
-        input = acc;
-        if (++lp_dly1_idx >= sizeof(lp_dly1_buf)/sizeof(float32_t)) lp_dly1_idx = 0;     // update index
-
-        // hi/lo shelving filter
-        temp1 = input - lpf1;
-        lpf1 += temp1 * lp_lowpass_f;
-        temp2 = input - lpf1;
-        temp1 = lpf1 - hpf1;
-        hpf1 += temp1 * lp_hipass_f;
-        acc = lpf1 + temp2*lp_hidamp_k + hpf1*lp_lodamp_k;
-        acc = acc * rv_time * rv_time_scaler;                                                                // scale by the reveb time
-        
-        input = acc + in_allp_out_L;
-
-        acc = lp_allp2_buf[lp_allp2_idx] + input * loop_allp_k;                  
-        lp_allp2_buf[lp_allp2_idx] = input - loop_allp_k * acc;
-        input = acc;
-        if (++lp_allp2_idx >= sizeof(lp_allp2_buf)/sizeof(float32_t)) lp_allp2_idx = 0;
-        acc = lp_dly2_buf[lp_dly2_idx];                                                   // read the end of the delay
-        lp_dly2_buf[lp_dly2_idx] = input;                                                 // write new sample
-        input = acc;
-        if (++lp_dly2_idx >= sizeof(lp_dly2_buf)/sizeof(float32_t)) lp_dly2_idx = 0;     // update index
-        // hi/lo shelving filter
-        temp1 = input - lpf2;
-        lpf2 += temp1 * lp_lowpass_f;
-        temp2 = input - lpf2;
-        temp1 = lpf2 - hpf2;
-        hpf2 += temp1 * lp_hipass_f;
-        acc = lpf2 + temp2*lp_hidamp_k + hpf2*lp_lodamp_k;
-        acc = acc * rv_time * rv_time_scaler;             
-
-        input = acc + in_allp_out_R;
-
-        acc = lp_allp3_buf[lp_allp3_idx] + input * loop_allp_k;                  
-        lp_allp3_buf[lp_allp3_idx] = input - loop_allp_k * acc;
-        input = acc;
-        if (++lp_allp3_idx >= sizeof(lp_allp3_buf)/sizeof(float32_t)) lp_allp3_idx = 0;
-        acc = lp_dly3_buf[lp_dly3_idx];                                                   // read the end of the delay
-        lp_dly3_buf[lp_dly3_idx] = input;                                                 // write new sample
-        input = acc;
-        if (++lp_dly3_idx >= sizeof(lp_dly3_buf)/sizeof(float32_t)) lp_dly3_idx = 0;     // update index
-        // hi/lo shelving filter
-        temp1 = input - lpf3;
-        lpf3 += temp1 * lp_lowpass_f;
-        temp2 = input - lpf3;
-        temp1 = lpf3 - hpf3;
-        hpf3 += temp1 * lp_hipass_f;
-        acc = lpf3 + temp2*lp_hidamp_k + hpf3*lp_lodamp_k;
-        acc = acc * rv_time * rv_time_scaler;              
-
-        input = acc + in_allp_out_L;       
-
-        acc = lp_allp4_buf[lp_allp4_idx] + input * loop_allp_k;                  
-        lp_allp4_buf[lp_allp4_idx] = input - loop_allp_k * acc;
-        input = acc;
-        if (++lp_allp4_idx >= sizeof(lp_allp4_buf)/sizeof(float32_t)) lp_allp4_idx = 0;
-        acc = lp_dly4_buf[lp_dly4_idx];                                                   // read the end of the delay
-        lp_dly4_buf[lp_dly4_idx] = input;                                                 // write new sample
-        input = acc;
-        if (++lp_dly4_idx >= sizeof(lp_dly4_buf)/sizeof(float32_t)) lp_dly4_idx= 0;     // update index
-        // hi/lo shelving filter
-        temp1 = input - lpf4;
-        lpf4 += temp1 * lp_lowpass_f;
-        temp2 = input - lpf4;
-        temp1 = lpf4 - hpf4;
-        hpf4 += temp1 * lp_hipass_f;
-        acc = lpf4 + temp2*lp_hidamp_k + hpf4*lp_lodamp_k;
-        acc = acc * rv_time * rv_time_scaler;              
-
-        lp_allp_out = acc;
-
-        // channel L:
+        pass = min(n - c, (uint32_t)REVERB_PASS_LEN);
+        pass = sizeRamp.span(prm.rv_time_k, pass);     // parameter ramps, see utility_ramp.h
+        pass = attnRamp.span(prm.input_attn, pass);
+        ramp = sizeRamp.begin(prm.rv_time_k, pass);
+        ramp |= attnRamp.begin(prm.input_attn, pass);
+        rv_time = sizeRamp.value;
+        in_attn = attnRamp.value;
+        for (i = 0; i < pass; i++)
+        {
+            lfo1_phase_acc += lfo1_adder;
+#if defined(TAP2_MODULATED)
+            idx = lfo1_phase_acc >> 24;     // 8bit lookup table address
+            y0 =  AudioWaveformSine[idx];
+            y1 = AudioWaveformSine[idx+1];
+            idx = lfo1_phase_acc & 0x00FFFFFF;   // lower 24 bit = fractional part
+            y = (int64_t)y0 * (0x00FFFFFF - idx);
+            y += (int64_t)y1 * idx;
+            lfo1_out_sin = (int32_t) (y >> (32-8)); // 16bit output
+#endif
+#if defined(TAP1_MODULATED) || defined(TAP2_MODULATED)
+            idx = ((lfo1_phase_acc >> 24)+64) & 0xFF;
+            y0 = AudioWaveformSine[idx];
+            y1 = AudioWaveformSine[idx + 1];
+            y = (int64_t)y0 * (0x00FFFFFF - idx);
+            y += (int64_t)y1 * idx;
+            lfo1_out_cos = (int32_t) (y >> (32-8)); // 16bit output        
+#endif
+
+            lfo2_phase_acc += lfo2_adder;
+            idx = lfo2_phase_acc >> 24;     // 8bit lookup table address
+            y0 =  AudioWaveformSine[idx];
+            y1 = AudioWaveformSine[idx+1];
+            idx = lfo2_phase_acc & 0x00FFFFFF;   // lower 24 bit = fractional part
+            y = (int64_t)y0 * (0x00FFFFFF - idx);
+            y += (int64_t)y1 * idx;
+            lfo2_out_sin = (int32_t) (y >> (32-8)); //32-8->output 16bit,
+            idx = ((lfo2_phase_acc >> 24)+64) & 0xFF;
+            y0 = AudioWaveformSine[idx];
+            y1 = AudioWaveformSine[idx + 1];
+            y = (int64_t)y0 * (0x00FFFFFF - idx);
+            y += (int64_t)y1 * idx;
+            lfo2_out_cos = (int32_t) (y >> (32-8)); // 16bit output
+#if defined(TAP2_MODULATED)
+            lfo1Sin[i] = lfo1_out_sin;
+#endif
+#if defined(TAP1_MODULATED) || defined(TAP2_MODULATED)
+            lfo1Cos[i] = lfo1_out_cos;
+#endif
+            lfo2Sin[i] = lfo2_out_sin;
+            lfo2Cos[i] = lfo2_out_cos;
+        }
+        AUDIO_PROFILE_LAP(profile, PROF_LFO);
+
+        for (i = 0; i < pass; i++)
+        {
+            input = srcL[c + i] * in_attn + dnNoise.next();   // keeps the tank out of denormals
+            // chained input allpasses, channel L
+            acc = in_allp1_bufL[in_allp1_idxL]  + input * prm.in_allp_k;  
+            in_allp1_bufL[in_allp1_idxL] = input - prm.in_allp_k * acc;
+            input = acc;
+            if (++in_allp1_idxL >= sizeof(in_allp1_bufL)/sizeof(float32_t)) in_allp1_idxL = 0;
+
+            acc = in_allp2_bufL[in_allp2_idxL]  + input * prm.in_allp_k;  
+            in_allp2_bufL[in_allp2_idxL] = input - prm.in_allp_k * acc;
+            input = acc;
+            if (++in_allp2_idxL >= sizeof(in_allp2_bufL)/sizeof(float32_t)) in_allp2_idxL = 0;
+
+            acc = in_allp3_bufL[in_allp3_idxL]  + input * prm.in_allp_k;  
+            in_allp3_bufL[in_allp3_idxL] = input - prm.in_allp_k * acc;
+            input = acc;
+            if (++in_allp3_idxL >= sizeof(in_allp3_bufL)/sizeof(float32_t)) in_allp3_idxL = 0;
+
+            acc = in_allp4_bufL[in_allp4_idxL]  + input * prm.in_allp_k;  
+            in_allp4_bufL[in_allp4_idxL] = input - prm.in_allp_k * acc;
+            inL[i] = acc;
+            if (++in_allp4_idxL >= sizeof(in_allp4_bufL)/sizeof(float32_t)) in_allp4_idxL = 0;
+
+            input = srcR[c + i] * in_attn + dnNoise.next();
+
+            // chained input allpasses, channel R
+            acc = in_allp1_bufR[in_allp1_idxR]  + input * prm.in_allp_k;  
+            in_allp1_bufR[in_allp1_idxR] = input - prm.in_allp_k * acc;
+            input = acc;
+            if (++in_allp1_idxR >= sizeof(in_allp1_bufR)/sizeof(float32_t)) in_allp1_idxR = 0;
+
+            acc = in_allp2_bufR[in_allp2_idxR]  + input * prm.in_allp_k;  
+            in_allp2_bufR[in_allp2_idxR] = input - prm.in_allp_k * acc;
+            input = acc;
+            if (++in_allp2_idxR >= sizeof(in_allp2_bufR)/sizeof(float32_t)) in_allp2_idxR = 0;
+
+            acc = in_allp3_bufR[in_allp3_idxR]  + input * prm.in_allp_k;  
+            in_allp3_bufR[in_allp3_idxR] = input - prm.in_allp_k * acc;
+            input = acc;
+            if (++in_allp3_idxR >= sizeof(in_allp3_bufR)/sizeof(float32_t)) in_allp3_idxR = 0;
+
+            acc = in_allp4_bufR[in_allp4_idxR]  + input * prm.in_allp_k;  
+            in_allp4_bufR[in_allp4_idxR] = input - prm.in_allp_k * acc;
+            inR[i] = acc;
+            if (++in_allp4_idxR >= sizeof(in_allp4_bufR)/sizeof(float32_t)) in_allp4_idxR = 0;
+            if (ramp) in_attn += attnRamp.step;
+        }
+        AUDIO_PROFILE_LAP(profile, PROF_INPUT);
+
+        tap1 = lp_dly1_idx;     // the taps read the delays as they were after each sample
+        tap2 = lp_dly2_idx;
+        tap3 = lp_dly3_idx;
+        tap4 = lp_dly4_idx;
+        for (i = 0; i < pass; i++)
+        {
+            // shimmer: add octave up for lp_allp_out - TODO someday
+
+            // input allpases done, start loop allpases
+            input = lp_allp_out + inR[i]; 
+            acc = lp_allp1_buf[lp_allp1_idx] + input * prm.loop_allp_k;                  // input is the lp allpass chain output
+            lp_allp1_buf[lp_allp1_idx] = input - prm.loop_allp_k * acc;
+            input = acc;
+            if (++lp_allp1_idx >= sizeof(lp_allp1_buf)/sizeof(float32_t)) lp_allp1_idx = 0;
+
+            acc = lp_dly1_buf[lp_dly1_idx];                                                   // read the end of the delay
+            lp_dly1_buf[lp_dly1_idx] = input;                                                 // write new sample
+            input = acc;
+            if (++lp_dly1_idx >= sizeof(lp_dly1_buf)/sizeof(float32_t)) lp_dly1_idx = 0;     // update index
+
+            // hi/lo shelving filter
+            temp1 = input - lpf1;
+            lpf1 += temp1 * lp_lowpass_f;
+            temp2 = input - lpf1;
+            temp1 = lpf1 - hpf1;
+            hpf1 += temp1 * lp_hipass_f;
+            acc = lpf1 + temp2*prm.lp_hidamp_k + hpf1*prm.lp_lodamp_k;
+            acc = acc * rv_time * prm.rv_time_scaler;                                                                // scale by the reveb time
+
+            input = acc + inL[i];
+
+            acc = lp_allp2_buf[lp_allp2_idx] + input * prm.loop_allp_k;                  
+            lp_allp2_buf[lp_allp2_idx] = input - prm.loop_allp_k * acc;
+            input = acc;
+            if (++lp_allp2_idx >= sizeof(lp_allp2_buf)/sizeof(float32_t)) lp_allp2_idx = 0;
+            acc = lp_dly2_buf[lp_dly2_idx];                                                   // read the end of the delay
+            lp_dly2_buf[lp_dly2_idx] = input;                                                 // write new sample
+            input = acc;
+            if (++lp_dly2_idx >= sizeof(lp_dly2_buf)/sizeof(float32_t)) lp_dly2_idx = 0;     // update index
+            // hi/lo shelving filter
+            temp1 = input - lpf2;
+            lpf2 += temp1 * lp_lowpass_f;
+            temp2 = input - lpf2;
+            temp1 = lpf2 - hpf2;
+            hpf2 += temp1 * lp_hipass_f;
+            acc = lpf2 + temp2*prm.lp_hidamp_k + hpf2*prm.lp_lodamp_k;
+            acc = acc * rv_time * prm.rv_time_scaler;             
+
+            input = acc + inR[i];
+
+            acc = lp_allp3_buf[lp_allp3_idx] + input * prm.loop_allp_k;                  
+            lp_allp3_buf[lp_allp3_idx] = input - prm.loop_allp_k * acc;
+            input = acc;
+            if (++lp_allp3_idx >= sizeof(lp_allp3_buf)/sizeof(float32_t)) lp_allp3_idx = 0;
+            acc = lp_dly3_buf[lp_dly3_idx];                                                   // read the end of the delay
+            lp_dly3_buf[lp_dly3_idx] = input;                                                 // write new sample
+            input = acc;
+            if (++lp_dly3_idx >= sizeof(lp_dly3_buf)/sizeof(float32_t)) lp_dly3_idx = 0;     // update index
+            // hi/lo shelving filter
+            temp1 = input - lpf3;
+            lpf3 += temp1 * lp_lowpass_f;
+            temp2 = input - lpf3;
+            temp1 = lpf3 - hpf3;
+            hpf3 += temp1 * lp_hipass_f;
+            acc = lpf3 + temp2*prm.lp_hidamp_k + hpf3*prm.lp_lodamp_k;
+            acc = acc * rv_time * prm.rv_time_scaler;              
+
+            input = acc + inL[i];       
+
+            acc = lp_allp4_buf[lp_allp4_idx] + input * prm.loop_allp_k;                  
+            lp_allp4_buf[lp_allp4_idx] = input - prm.loop_allp_k * acc;
+            input = acc;
+            if (++lp_allp4_idx >= sizeof(lp_allp4_buf)/sizeof(float32_t)) lp_allp4_idx = 0;
+            acc = lp_dly4_buf[lp_dly4_idx];                                                   // read the end of the delay
+            lp_dly4_buf[lp_dly4_idx] = input;                                                 // write new sample
+            input = acc;
+            if (++lp_dly4_idx >= sizeof(lp_dly4_buf)/sizeof(float32_t)) lp_dly4_idx= 0;     // update index
+            // hi/lo shelving filter
+            temp1 = input - lpf4;
+            lpf4 += temp1 * lp_lowpass_f;
+            temp2 = input - lpf4;
+            temp1 = lpf4 - hpf4;
+            hpf4 += temp1 * lp_hipass_f;
+            acc = lpf4 + temp2*prm.lp_hidamp_k + hpf4*prm.lp_lodamp_k;
+            acc = acc * rv_time * prm.rv_time_scaler;              
+
+            lp_allp_out = acc;
+            if (ramp) rv_time += sizeRamp.step;
+        }
+        AUDIO_PROFILE_LAP(profile, PROF_TANK);
+
+        for (i = 0; i < pass; i++)
+        {
+#if defined(TAP2_MODULATED)
+            lfo1_out_sin = lfo1Sin[i];
+#endif
+#if defined(TAP1_MODULATED) || defined(TAP2_MODULATED)
+            lfo1_out_cos = lfo1Cos[i];
+#endif
+            lfo2_out_sin = lfo2Sin[i];
+            lfo2_out_cos = lfo2Cos[i];
+            if (++tap1 >= sizeof(lp_dly1_buf)/sizeof(float32_t)) tap1 = 0;
+            if (++tap2 >= sizeof(lp_dly2_buf)/sizeof(float32_t)) tap2 = 0;
+            if (++tap3 >= sizeof(lp_dly3_buf)/sizeof(float32_t)) tap3 = 0;
+            if (++tap4 >= sizeof(lp_dly4_buf)/sizeof(float32_t)) tap4 = 0;
+
+            // channel L:
 #ifdef TAP1_MODULATED
-        temp16 = (lp_dly1_idx + lp_dly1_offset_L + (lfo1_out_cos>>LFO_FRAC_BITS)) %  (sizeof(lp_dly1_buf)/sizeof(float32_t));
-        temp1 = lp_dly1_buf[temp16++];    // sample now
-        if (temp16  >= sizeof(lp_dly1_buf)/sizeof(float32_t)) temp16 = 0;
-        temp2 = lp_dly1_buf[temp16];    // sample next
-        input = (float32_t)(lfo1_out_cos & LFO_FRAC_MASK) / ((float32_t)LFO_FRAC_MASK); // interp. k
-        acc = (temp1*(1.0f-input) + temp2*input)* 0.8f;
+            temp16 = (tap1 + lp_dly1_offset_L + (lfo1_out_cos>>LFO_FRAC_BITS)) %  (sizeof(lp_dly1_buf)/sizeof(float32_t));
+            temp1 = lp_dly1_buf[temp16++];    // sample now
+            if (temp16  >= sizeof(lp_dly1_buf)/sizeof(float32_t)) temp16 = 0;
+            temp2 = lp_dly1_buf[temp16];    // sample next
+            input = (float32_t)(lfo1_out_cos & LFO_FRAC_MASK) / ((float32_t)LFO_FRAC_MASK); // interp. k
+            acc = (temp1*(1.0f-input) + temp2*input)* 0.8f;
 #else
-        temp16 = (lp_dly1_idx + lp_dly1_offset_L) %  (sizeof(lp_dly1_buf)/sizeof(float32_t));
-        acc = lp_dly1_buf[temp16]* 0.8f;
+            temp16 = (tap1 + lp_dly1_offset_L) %  (sizeof(lp_dly1_buf)/sizeof(float32_t));
+            acc = lp_dly1_buf[temp16]* 0.8f;
 #endif
 
 
 #ifdef TAP2_MODULATED
-        temp16 = (lp_dly2_idx + lp_dly2_offset_L + (lfo1_out_sin>>LFO_FRAC_BITS)) % (sizeof(lp_dly2_buf)/sizeof(float32_t));
-        temp1 = lp_dly2_buf[temp16++];
-        if (temp16  >= sizeof(lp_dly2_buf)/sizeof(float32_t)) temp16 = 0;
-        temp2 = lp_dly2_buf[temp16]; 
-        input = (float32_t)(lfo1_out_sin & LFO_FRAC_MASK) / ((float32_t)LFO_FRAC_MASK); // interp. k
-        acc += (temp1*(1.0f-input) + temp2*input)* 0.7f;
+            temp16 = (tap2 + lp_dly2_offset_L + (lfo1_out_sin>>LFO_FRAC_BITS)) % (sizeof(lp_dly2_buf)/sizeof(float32_t));
+            temp1 = lp_dly2_buf[temp16++];
+            if (temp16  >= sizeof(lp_dly2_buf)/sizeof(float32_t)) temp16 = 0;
+            temp2 = lp_dly2_buf[temp16]; 
+            input = (float32_t)(lfo1_out_sin & LFO_FRAC_MASK) / ((float32_t)LFO_FRAC_MASK); // interp. k
+            acc += (temp1*(1.0f-input) + temp2*input)* 0.7f;
 #else
-        temp16 = (lp_dly2_idx + lp_dly2_offset_L) % (sizeof(lp_dly2_buf)/sizeof(float32_t));
-        acc += (temp1*(1.0f-input) + temp2*input)* 0.6f;
+            temp16 = (tap2 + lp_dly2_offset_L) % (sizeof(lp_dly2_buf)/sizeof(float32_t));
+            acc += lp_dly2_buf[temp16] * 0.6f;
 #endif
 
-        temp16 = (lp_dly3_idx + lp_dly3_offset_L + (lfo2_out_cos>>LFO_FRAC_BITS)) % (sizeof(lp_dly3_buf)/sizeof(float32_t));
-        temp1 = lp_dly3_buf[temp16++];
-        if (temp16  >= sizeof(lp_dly3_buf)/sizeof(float32_t)) temp16 = 0;
-        temp2 = lp_dly3_buf[temp16]; 
-        input = (float32_t)(lfo2_out_cos & LFO_FRAC_MASK) / ((float32_t)LFO_FRAC_MASK); // interp. k
-        acc += (temp1*(1.0f-input) + temp2*input)* 0.6f;
-
-        temp16 = (lp_dly4_idx + lp_dly4_offset_L + (lfo2_out_sin>>LFO_FRAC_BITS)) % (sizeof(lp_dly4_buf)/sizeof(float32_t));
-        temp1 = lp_dly4_buf[temp16++];
-        if (temp16  >= sizeof(lp_dly4_buf)/sizeof(float32_t)) temp16 = 0;
-        temp2 = lp_dly4_buf[temp16]; 
-        input = (float32_t)(lfo2_out_sin & LFO_FRAC_MASK) / ((float32_t)LFO_FRAC_MASK); // interp. k
-        acc += (temp1*(1.0f-input) + temp2*input)* 0.5f;
-
-        // Master lowpass filter
-        temp1 = acc - master_lowpass_l;
-        master_lowpass_l += temp1 * master_lowpass_f;
-
-        outblockL->data[i] = master_lowpass_l; //sat16(output * 30, 0);
-
-        // Channel R
-        #ifdef TAP1_MODULATED
-        temp16 = (lp_dly1_idx + lp_dly1_offset_R + (lfo2_out_cos>>LFO_FRAC_BITS)) % (sizeof(lp_dly1_buf)/sizeof(float32_t));
-        temp1 = lp_dly1_buf[temp16++];    // sample now
-        if (temp16  >= sizeof(lp_dly1_buf)/sizeof(float32_t)) temp16 = 0;
-        temp2 = lp_dly1_buf[temp16];    // sample next
-        input = (float32_t)(lfo2_out_cos & LFO_FRAC_MASK) / ((float32_t)LFO_FRAC_MASK); // interp. k
-
-        acc = (temp1*(1.0f-input) + temp2*input)* 0.8f;
-        #else
-        temp16 = (lp_dly1_idx + lp_dly1_offset_R) % (sizeof(lp_dly1_buf)/sizeof(float32_t));
-        acc = lp_dly1_buf[temp16] * 0.8f;
-        #endif
+            temp16 = (tap3 + lp_dly3_offset_L + (lfo2_out_cos>>LFO_FRAC_BITS)) % (sizeof(lp_dly3_buf)/sizeof(float32_t));
+            temp1 = lp_dly3_buf[temp16++];
+            if (temp16  >= sizeof(lp_dly3_buf)/sizeof(float32_t)) temp16 = 0;
+            temp2 = lp_dly3_buf[temp16]; 
+            input = (float32_t)(lfo2_out_cos & LFO_FRAC_MASK) / ((float32_t)LFO_FRAC_MASK); // interp. k
+            acc += (temp1*(1.0f-input) + temp2*input)* 0.6f;
+
+            temp16 = (tap4 + lp_dly4_offset_L + (lfo2_out_sin>>LFO_FRAC_BITS)) % (sizeof(lp_dly4_buf)/sizeof(float32_t));
+            temp1 = lp_dly4_buf[temp16++];
+            if (temp16  >= sizeof(lp_dly4_buf)/sizeof(float32_t)) temp16 = 0;
+            temp2 = lp_dly4_buf[temp16]; 
+            input = (float32_t)(lfo2_out_sin & LFO_FRAC_MASK) / ((float32_t)LFO_FRAC_MASK); // interp. k
+            acc += (temp1*(1.0f-input) + temp2*input)* 0.5f;
+
+            // Master lowpass filter
+            temp1 = acc - master_lowpass_l;
+            master_lowpass_l += temp1 * prm.master_lowpass_f;
+
+            dstL[c + i] = master_lowpass_l; //sat16(output * 30, 0);
+
+            // Channel R
+            #ifdef TAP1_MODULATED
+            temp16 = (tap1 + lp_dly1_offset_R + (lfo2_out_cos>>LFO_FRAC_BITS)) % (sizeof(lp_dly1_buf)/sizeof(float32_t));
+            temp1 = lp_dly1_buf[temp16++];    // sample now
+            if (temp16  >= sizeof(lp_dly1_buf)/sizeof(float32_t)) temp16 = 0;
+            temp2 = lp_dly1_buf[temp16];    // sample next
+            input = (float32_t)(lfo2_out_cos & LFO_FRAC_MASK) / ((float32_t)LFO_FRAC_MASK); // interp. k
+
+            acc = (temp1*(1.0f-input) + temp2*input)* 0.8f;
+            #else
+            temp16 = (tap1 + lp_dly1_offset_R) % (sizeof(lp_dly1_buf)/sizeof(float32_t));
+            acc = lp_dly1_buf[temp16] * 0.8f;
+            #endif
 #ifdef TAP2_MODULATED
-        temp16 = (lp_dly2_idx + lp_dly2_offset_R + (lfo1_out_cos>>LFO_FRAC_BITS)) % (sizeof(lp_dly2_buf)/sizeof(float32_t));
-        temp1 = lp_dly2_buf[temp16++];
-        if (temp16  >= sizeof(lp_dly2_buf)/sizeof(float32_t)) temp16 = 0;
-        temp2 = lp_dly2_buf[temp16]; 
-        input = (float32_t)(lfo1_out_cos & LFO_FRAC_MASK) / ((float32_t)LFO_FRAC_MASK); // interp. k
-        acc += (temp1*(1.0f-input) + temp2*input)* 0.7f;
+            temp16 = (tap2 + lp_dly2_offset_R + (lfo1_out_cos>>LFO_FRAC_BITS)) % (sizeof(lp_dly2_buf)/sizeof(float32_t));
+            temp1 = lp_dly2_buf[temp16++];
+            if (temp16  >= sizeof(lp_dly2_buf)/sizeof(float32_t)) temp16 = 0;
+            temp2 = lp_dly2_buf[temp16]; 
+            input = (float32_t)(lfo1_out_cos & LFO_FRAC_MASK) / ((float32_t)LFO_FRAC_MASK); // interp. k
+            acc += (temp1*(1.0f-input) + temp2*input)* 0.7f;
 #else
-        temp16 = (lp_dly2_idx + lp_dly2_offset_R) % (sizeof(lp_dly2_buf)/sizeof(float32_t));
-        acc += (temp1*(1.0f-input) + temp2*input)* 0.7f;
+            temp16 = (tap2 + lp_dly2_offset_R) % (sizeof(lp_dly2_buf)/sizeof(float32_t));
+            acc += lp_dly2_buf[temp16] * 0.7f;
 #endif
-        temp16 = (lp_dly3_idx + lp_dly3_offset_R + (lfo2_out_sin>>LFO_FRAC_BITS)) % (sizeof(lp_dly3_buf)/sizeof(float32_t));
-        temp1 = lp_dly3_buf[temp16++];
-        if (temp16  >= sizeof(lp_dly3_buf)/sizeof(float32_t)) temp16 = 0;
-        temp2 = lp_dly3_buf[temp16]; 
-        input = (float32_t)(lfo2_out_sin & LFO_FRAC_MASK) / ((float32_t)LFO_FRAC_MASK); // interp. k
-        acc += (temp1*(1.0f-input) + temp2*input)* 0.6f;
-
-        temp16 = (lp_dly4_idx + lp_dly4_offset_R + (lfo2_out_cos>>LFO_FRAC_BITS)) % (sizeof(lp_dly4_buf)/sizeof(float32_t));
-        temp1 = lp_dly4_buf[temp16++];
-        if (temp16  >= sizeof(lp_dly4_buf)/sizeof(float32_t)) temp16 = 0;
-        temp2 = lp_dly4_buf[temp16]; 
-        input = (float32_t)(lfo2_out_cos & LFO_FRAC_MASK) / ((float32_t)LFO_FRAC_MASK); // interp. k
-        acc += (temp1*(1.0f-input) + temp2*input)* 0.5f;
-
-        // Master lowpass filter
-        temp1 = acc - master_lowpass_r;
-        master_lowpass_r += temp1 * master_lowpass_f;
-        outblockR->data[i] = master_lowpass_r;
-		
+            temp16 = (tap3 + lp_dly3_offset_R + (lfo2_out_sin>>LFO_FRAC_BITS)) % (sizeof(lp_dly3_buf)/sizeof(float32_t));
+            temp1 = lp_dly3_buf[temp16++];
+            if (temp16  >= sizeof(lp_dly3_buf)/sizeof(float32_t)) temp16 = 0;
+            temp2 = lp_dly3_buf[temp16]; 
+            input = (float32_t)(lfo2_out_sin & LFO_FRAC_MASK) / ((float32_t)LFO_FRAC_MASK); // interp. k
+            acc += (temp1*(1.0f-input) + temp2*input)* 0.6f;
+
+            temp16 = (tap4 + lp_dly4_offset_R + (lfo2_out_cos>>LFO_FRAC_BITS)) % (sizeof(lp_dly4_buf)/sizeof(float32_t));
+            temp1 = lp_dly4_buf[temp16++];
+            if (temp16  >= sizeof(lp_dly4_buf)/sizeof(float32_t)) temp16 = 0;
+            temp2 = lp_dly4_buf[temp16]; 
+            input = (float32_t)(lfo2_out_cos & LFO_FRAC_MASK) / ((float32_t)LFO_FRAC_MASK); // interp. k
+            acc += (temp1*(1.0f-input) + temp2*input)* 0.5f;
+
+            // Master lowpass filter
+            temp1 = acc - master_lowpass_r;
+            master_lowpass_r += temp1 * prm.master_lowpass_f;
+            dstR[c + i] = master_lowpass_r;
+        }
+        AUDIO_PROFILE_LAP(profile, PROF_TAPS);
+        sizeRamp.end();
+        attnRamp.end();
 	}
-    AudioStream_F32::transmit(outblockL, 0);
-	AudioStream_F32::transmit(outblockR, 1);
-	AudioStream_F32::release(outblockL);
-    AudioStream_F32::release(outblockR);
-	AudioStream_F32::release((audio_block_f32_t *)blockL);
-    AudioStream_F32::release((audio_block_f32_t *)blockR);
 #endif
 }
@@ -47,24 +47,42 @@
 #include "Audio.h"
 #include "AudioStream_F32.h"
 #include "arm_math.h"
+#include "utility_profile.h"
+#include "utility_params.h"
+#include "utility_ramp.h"
+#include "utility_denormal.h"
 
 // if uncommented will place all the buffers in the DMAMEM section ofd the memory
 // works with single instance of the reverb only
+#if !defined(HX_HOST_BUILD)         // host build: buffers are members, many instances run in parallel
 #define REVERB_F32_USE_DMAMEM
+#endif
 
 /***
  * Loop delay modulation: comment/uncomment to switch sin/cos 
  * modulation for the 1st or 2nd tap, 3rd tap is always modulated
  * more modulation means more chorus type sounding reverb tail
  */
+#if !defined(REVERB_TAP_CONFIG)     // the taps can also be selected by the build, ie. -DREVERB_TAP_CONFIG -DTAP1_MODULATED
 //#define TAP1_MODULATED
 #define TAP2_MODULATED
+#endif
 
 class AudioEffectPlateReverb_F32 : public AudioStream_F32
 {
 public:
     AudioEffectPlateReverb_F32();
     virtual void update();
+    /**
+     * @brief Processing core called by update(), can be used without the
+     *  audio library for any block length. Bypassed, the output is silent.
+     * 
+     * @param in    in[0], in[1] audio L/R
+     * @param out   out[0], out[1] reverb L/R, can be the same buffers as in[0], in[1]
+     * @param n     number of samples
+     */
+    void process(const float32_t *const *in, float32_t *const *out, uint32_t n);
+    enum {PROC_IN = 2, PROC_OUT = 2};   // audio channels of process(), see effect_chain_F32.h
 
     /**
      * @brief reverb time. Please not the hidamp/lodamp params also control how
@@ -76,11 +94,10 @@ public:
     {
         n = constrain(n, 0.0f, 1.0f);
         n = map (n, 0.0f, 1.0f, 0.2f, rv_time_k_max);
-        float32_t attn = map(n, 0.0f, rv_time_k_max, 0.5f, 0.25f);
-        __disable_irq();
-        rv_time_k = n;
-        input_attn = attn;
-        __enable_irq();
+        params_t &p = params.edit();
+        p.rv_time_k = n;
+        p.input_attn = map(n, 0.0f, rv_time_k_max, 0.5f, 0.25f);
+        params.publish();
     }
     /**
      * @brief amount treble loss in the reverb tail
@@ -90,9 +107,8 @@ public:
     void hidamp(float n)
     {
         n = constrain(n, 0.0f, 1.0f);
-        __disable_irq();
-        lp_hidamp_k = 1.0f - n;
-        __enable_irq();
+        params.edit().lp_hidamp_k = 1.0f - n;
+        params.publish();
     }
     /**
      * @brief amount og bass lost in the reverb tail
@@ -102,10 +118,10 @@ public:
     void lodamp(float n)
     {
         n = constrain(n, 0.0f, 1.0f);
-        __disable_irq();
-        lp_lodamp_k = -n;
-        rv_time_scaler = 1.0f - n * 0.12f;        // limit the max reverb time, otherwise it will clip
-        __enable_irq();
+        params_t &p = params.edit();
+        p.lp_lodamp_k = -n;
+        p.rv_time_scaler = 1.0f - n * 0.12f;        // limit the max reverb time, otherwise it will clip
+        params.publish();
     }
     /**
      * @brief lowpass filter applied to the reverb output 
@@ -117,7 +133,8 @@ public:
     {
         n = constrain(n, 0.0f, 1.0f);
         n = map(n*n*n, 0.0f, 1.0f, 1.0f, 0.05f);
-        master_lowpass_f = n;
+        params.edit().master_lowpass_f = n;
+        params.publish();
     }
     /**
      * @brief "echoiness" of the reverb sound. Lower values produce more 
@@ -132,10 +149,10 @@ public:
     {
         n = constrain(n, 0.0f, 1.0f);
         n = map(n, 0.0f, 1.0f, 0.005f, 0.65f);
-        __disable_irq();
-        in_allp_k = n;
-        loop_allp_k = n;
-         __enable_irq();
+        params_t &p = params.edit();
+        p.in_allp_k = n;
+        p.loop_allp_k = n;
+        params.publish();
     }
     /**
      * @brief Freezes the reverb tank by cutting off the input signal
@@ -146,34 +163,8 @@ public:
      */
     void freeze(bool state)
     {
-        flags.freeze = state;
-        if (state)
-        {
-            rv_time_k_tmp = rv_time_k;      // store the settings
-            lp_lodamp_k_tmp = lp_lodamp_k;
-            lp_hidamp_k_tmp = lp_hidamp_k;
-            
-            __disable_irq();
-            rv_time_k = freeze_rvtime_k;                                      
-            input_attn = freeze_ingain;
-            rv_time_scaler = 1.0f;
-            lp_lodamp_k = freeze_lodamp_k;
-            lp_hidamp_k = freeze_hidamp_k;
-
-            __enable_irq();
-        }
-        else
-        {
-            float32_t attn = map(rv_time_k_tmp, 0.0f, rv_time_k_max, 0.5f, 0.25f);    // recalc the in attenuation
-            float32_t sc = 1.0f + lp_lodamp_k_tmp * 0.12f;
-            __disable_irq();
-            rv_time_k = rv_time_k_tmp;                                      // restore the value
-            input_attn = attn;
-            rv_time_scaler = sc;
-            lp_hidamp_k = lp_hidamp_k_tmp;
-            lp_lodamp_k = lp_lodamp_k_tmp;
-            __enable_irq();
-        }
+        freeze_set(params.edit(), state);
+        params.publish();
     }
     /**
      * @brief Toggles the freeze function and returns the current state
@@ -181,37 +172,94 @@ public:
      * @return true     toggle resulted in freeze on
      * @return false    toggle resulted in freeze off
      */
-    bool freeze_tgl() {flags.freeze ^= 1; freeze(flags.freeze); return flags.freeze;}
+    bool freeze_tgl() {freeze(!params.get().freeze); return params.get().freeze;}
     
-    bool freeze_get() {return flags.freeze;}
+    bool freeze_get() {return params.get().freeze;}
 
-    float32_t size_get(void) {return rv_time_k;}
+    float32_t size_get(void) {return params.get().rv_time_k;}
 
-    bool bypass_get(void) {return flags.bypass;}
+    bool bypass_get(void) {return params.get().bypass;}
     void bypass_set(bool state) 
     {
-        flags.bypass = state;
-        if (state) freeze(false);       // disable freeze in bypass mode
+        params_t &p = params.edit();
+        p.bypass = state;
+        if (state) freeze_set(p, false);    // disable freeze in bypass mode
+        params.publish();
     }
     bool bypass_tgl(void) 
     {
-        flags.bypass ^= 1; 
-        if (flags.bypass) freeze(false);       // disable freeze in bypass mode
-        return flags.bypass;
+        bypass_set(!params.get().bypass);
+        return params.get().bypass;
     }
 
+    /**
+     * @brief Sample accurate automation: the next setter call takes effect
+     *          at sample t of time(), see utility_params.h
+     */
+    bool at(uint32_t t) { return params.at(t);}
+    uint32_t time(void) { return params.time();}
+    void advance(uint32_t n) { params.advance(n);}  // clock of a bypassed chain stage
+
+    enum {PROF_LFO, PROF_INPUT, PROF_TANK, PROF_TAPS, PROF_NUM};  // update() stages
+#if defined(AUDIO_PROFILE)
+    AudioProfile profile;           // cycles per update() stage, see utility_profile.h
+#endif
 private:
+    typedef struct
+    {
+        bool bypass;
+        bool freeze;
+        float32_t input_attn;           
+        float32_t in_allp_k;            // input allpass coeff 
+        float32_t loop_allp_k;          // loop allpass coeff
+        float32_t lp_hidamp_k;          // loop high band damping coeff
+        float32_t lp_lodamp_k;          // loop low baand damping coeff
+        float32_t master_lowpass_f;
+        float32_t rv_time_k;            // reverb time coeff
+        float32_t rv_time_scaler;       // with high lodamp settings lower the max reverb time to avoid clipping
+    } params_t;
+    AudioParams<params_t> params;       // written by the setters
+    params_t prm;                       // in use by update(), see utility_params.h
+    AudioRamp sizeRamp, attnRamp;       // rv_time_k and input_attn in use, see utility_ramp.h
+    AudioDenormalNoise dnNoise;         // see utility_denormal.h
     struct flags_t
     {
-        unsigned bypass:           1;
-        unsigned freeze:            1;
         unsigned shimmer:           1; // maybe will be added at some point
         unsigned cleanup_done:      1;
     }flags;
+    void cleanup();
+    void process_segment(const float32_t *srcL, const float32_t *srcR, float32_t *dstL, float32_t *dstR, uint32_t n);
+    /**
+     * @brief Freeze on/off in the edited set, the settings are stored 
+     *  in the writer side _tmp members and restored when the freeze is off
+     */
+    void freeze_set(params_t &p, bool state)
+    {
+        if (state == p.freeze) return;  // the stored settings are valid only while frozen
+        p.freeze = state;
+        if (state)
+        {
+            rv_time_k_tmp = p.rv_time_k;      // store the settings
+            lp_lodamp_k_tmp = p.lp_lodamp_k;
+            lp_hidamp_k_tmp = p.lp_hidamp_k;
+            
+            p.rv_time_k = freeze_rvtime_k;                                      
+            p.input_attn = freeze_ingain;
+            p.rv_time_scaler = 1.0f;
+            p.lp_lodamp_k = freeze_lodamp_k;
+            p.lp_hidamp_k = freeze_hidamp_k;
+        }
+        else
+        {
+            p.rv_time_k = rv_time_k_tmp;                                      // restore the value
+            p.input_attn = map(rv_time_k_tmp, 0.0f, rv_time_k_max, 0.5f, 0.25f);    // recalc the in attenuation
+            p.rv_time_scaler = 1.0f + lp_lodamp_k_tmp * 0.12f;
+            p.lp_hidamp_k = lp_hidamp_k_tmp;
+            p.lp_lodamp_k = lp_lodamp_k_tmp;
+        }
+    }
 
     audio_block_f32_t *inputQueueArray_f32[2];
-    float32_t input_attn;           
-    float32_t in_allp_k;            // input allpass coeff 
 #ifndef REVERB_F32_USE_DMAMEM
     float32_t in_allp1_bufL[224];   // input allpass buffers
     float32_t in_allp2_bufL[420];
@@ -222,7 +270,6 @@ private:
     uint16_t in_allp2_idxL;
     uint16_t in_allp3_idxL;
     uint16_t in_allp4_idxL;
-    float32_t in_allp_out_L;    // L allpass chain output
 #ifndef REVERB_F32_USE_DMAMEM
     float32_t in_allp1_bufR[156]; // input allpass buffers
     float32_t in_allp2_bufR[520];
@@ -233,7 +280,6 @@ private:
     uint16_t in_allp2_idxR;
     uint16_t in_allp3_idxR;
     uint16_t in_allp4_idxR;
-    float32_t in_allp_out_R;    // R allpass chain output
 #ifndef REVERB_F32_USE_DMAMEM
     float32_t lp_allp1_buf[2303]; // loop allpass buffers
     float32_t lp_allp2_buf[2905];
@@ -244,7 +290,6 @@ private:
     uint16_t lp_allp2_idx;
     uint16_t lp_allp3_idx;
     uint16_t lp_allp4_idx;
-    float32_t loop_allp_k;         // loop allpass coeff
     float32_t lp_allp_out;
 #ifndef REVERB_F32_USE_DMAMEM
     float32_t lp_dly1_buf[3423];
@@ -267,9 +312,7 @@ private:
     const uint16_t lp_dly3_offset_R = 487;
     const uint16_t lp_dly4_offset_R = 780;  
 
-    float32_t lp_hidamp_k;       // loop high band damping coeff
     float32_t lp_hidamp_k_tmp;  
-    float32_t lp_lodamp_k;       // loop low baand damping coeff
     float32_t lp_lodamp_k_tmp;
 
     float32_t lpf1;             // lowpass filters
@@ -285,14 +328,11 @@ private:
     float32_t lp_lowpass_f;      // loop lowpass scaled frequency
     float32_t lp_hipass_f;       // loop highpass scaled frequency 
 
-    float32_t master_lowpass_f;
     float32_t master_lowpass_l;
     float32_t master_lowpass_r;
 
     const float32_t rv_time_k_max = 0.95f;
-    float32_t rv_time_k;         // reverb time coeff
     float32_t rv_time_k_tmp;     // temp for restoring original value after freeze_off
-    float32_t rv_time_scaler;    // with high lodamp settings lower the max reverb time to avoid clipping
 
     uint32_t lfo1_phase_acc;     // LFO 1
     uint32_t lfo1_adder;